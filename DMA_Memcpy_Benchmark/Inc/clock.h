@@ -0,0 +1,20 @@
+/*
+ * clock.h
+ *
+ *  Created on: 17 Oct 2026
+ *  Author: George Calin
+ *  Target Development Board: STM32 Nucleo F429ZI
+ */
+
+#ifndef CLOCK_H_
+#define CLOCK_H_
+
+#include <stm32f429xx.h>
+#include <stdint.h>
+
+#define CLOCK_PLL_FREQ (180000000U)	// HSE 8 MHz / PLLM 4 * PLLN 180 / PLLP 2
+
+int clock_pll_180mhz_init(void);
+void clock_hsi_init(void);
+
+#endif /* CLOCK_H_ */
@@ -0,0 +1,153 @@
+/*
+ * clock.c
+ *
+ *  Created on: 17 Oct 2026
+ *  Author: George Calin
+ *  Target Development Board: STM32 Nucleo F429ZI
+ */
+
+#include "clock.h"
+
+#define RCC_CR__HSEON (1UL<<16)
+#define RCC_CR__HSERDY (1UL<<17)
+#define RCC_CR__HSEBYP (1UL<<18)
+#define RCC_CR__PLLON (1UL<<24)
+#define RCC_CR__PLLRDY (1UL<<25)
+
+#define RCC_PLLCFGR__PLLM (4UL<<0)
+#define RCC_PLLCFGR__PLLN (180UL<<6)
+#define RCC_PLLCFGR__PLLP_2 (0UL<<16)
+#define RCC_PLLCFGR__PLLSRC_HSE (1UL<<22)
+#define RCC_PLLCFGR__PLLQ (8UL<<24)
+
+#define RCC_CFGR__SW_MASK (3UL<<0)
+#define RCC_CFGR__SW_HSI (0UL<<0)
+#define RCC_CFGR__SW_PLL (2UL<<0)
+#define RCC_CFGR__SWS_MASK (3UL<<2)
+#define RCC_CFGR__SWS_HSI (0UL<<2)
+#define RCC_CFGR__SWS_PLL (2UL<<2)
+#define RCC_CFGR__HPRE_MASK (0xFUL<<4)
+#define RCC_CFGR__PPRE1_MASK (7UL<<10)
+#define RCC_CFGR__PPRE1_DIV4 (5UL<<10)
+#define RCC_CFGR__PPRE2_MASK (7UL<<13)
+#define RCC_CFGR__PPRE2_DIV2 (4UL<<13)
+
+#define RCC_APB1ENR__PWREN (1UL<<28)
+
+#define PWR_CR__VOS_SCALE1 (3UL<<14)
+#define PWR_CR__ODEN (1UL<<16)
+#define PWR_CR__ODSWEN (1UL<<17)
+#define PWR_CSR__ODRDY (1UL<<16)
+#define PWR_CSR__ODSWRDY (1UL<<17)
+
+#define FLASH_ACR__LATENCY_MASK (0xFUL<<0)
+#define FLASH_ACR__LATENCY_5WS (5UL<<0)
+#define FLASH_ACR__PRFTEN (1UL<<8)
+#define FLASH_ACR__ICEN (1UL<<9)
+#define FLASH_ACR__DCEN (1UL<<10)
+
+#define CLOCK_TIMEOUT (1000000U)	// turns of the wait loops, far longer than any start-up time of the datasheet
+
+static int clock_wait(volatile uint32_t *reg, uint32_t mask, uint32_t value);
+
+/* ******************************************************************************************************************************************************************
+ * Explanation: Info taken from RM0090: RCC clock control register (RCC_CR), RCC PLL configuration register (RCC_PLLCFGR), PWR power control register (PWR_CR)
+ * and Flash access control register (FLASH_ACR). 180 MHz is the top speed of the F429 and needs, in this order:
+ * 		1. the regulator in scale 1 (VOS = 11) and the HSE: on the Nucleo 144 the 8 MHz MCO of the ST-LINK drives OSC_IN, hence the bypass (HSEBYP);
+ * 		2. the PLL: VCO input 8 MHz / PLLM 4 = 2 MHz, VCO 2 MHz * PLLN 180 = 360 MHz, SYSCLK 360 MHz / PLLP 2 = 180 MHz;
+ * 		3. the over-drive (ODEN, wait ODRDY, then ODSWEN, wait ODSWRDY), without it the limit is 168 MHz;
+ * 		4. 5 wait states of the flash at 2.7-3.6 V, with the prefetch and the instruction and data caches of the ART accelerator;
+ * 		5. APB1 at most 45 MHz (/4) and APB2 at most 90 MHz (/2), set before the switch;
+ * 		6. the switch to the PLL (SW = 10), done once SWS reads 10.
+ * Returns -1 if the HSE, the PLL or the over-drive do not get ready: the clock stays on the HSI.
+ * The baud rates (baudrate.c) are computed from the clock tree, the USART has to be set again after the switch.
+ * ******************************************************************************************************************************************************************
+ */
+int clock_pll_180mhz_init(void)
+{
+	/* The PLL cannot be configured while it feeds the system clock */
+	clock_hsi_init();
+
+	RCC->APB1ENR |= RCC_APB1ENR__PWREN;
+	PWR->CR |= PWR_CR__VOS_SCALE1;
+
+	RCC->CR |= (RCC_CR__HSEBYP | RCC_CR__HSEON);
+
+	if(clock_wait(&RCC->CR, RCC_CR__HSERDY, RCC_CR__HSERDY) != 0)
+	{
+		return -1;
+	}
+
+	RCC->PLLCFGR = (RCC_PLLCFGR__PLLM | RCC_PLLCFGR__PLLN | RCC_PLLCFGR__PLLP_2 | RCC_PLLCFGR__PLLSRC_HSE | RCC_PLLCFGR__PLLQ);
+	RCC->CR |= RCC_CR__PLLON;
+
+	if(clock_wait(&RCC->CR, RCC_CR__PLLRDY, RCC_CR__PLLRDY) != 0)
+	{
+		return -1;
+	}
+
+	PWR->CR |= PWR_CR__ODEN;
+
+	if(clock_wait(&PWR->CSR, PWR_CSR__ODRDY, PWR_CSR__ODRDY) != 0)
+	{
+		return -1;
+	}
+
+	PWR->CR |= PWR_CR__ODSWEN;
+
+	if(clock_wait(&PWR->CSR, PWR_CSR__ODSWRDY, PWR_CSR__ODSWRDY) != 0)
+	{
+		return -1;
+	}
+
+	/* More wait states first, then the faster clock */
+	FLASH->ACR = (FLASH_ACR__LATENCY_5WS | FLASH_ACR__PRFTEN | FLASH_ACR__ICEN | FLASH_ACR__DCEN);
+
+	if(clock_wait(&FLASH->ACR, FLASH_ACR__LATENCY_MASK, FLASH_ACR__LATENCY_5WS) != 0)
+	{
+		return -1;
+	}
+
+	RCC->CFGR = (RCC->CFGR & ~(RCC_CFGR__HPRE_MASK | RCC_CFGR__PPRE1_MASK | RCC_CFGR__PPRE2_MASK)) | RCC_CFGR__PPRE1_DIV4 | RCC_CFGR__PPRE2_DIV2;
+
+	RCC->CFGR = (RCC->CFGR & ~RCC_CFGR__SW_MASK) | RCC_CFGR__SW_PLL;
+
+	return clock_wait(&RCC->CFGR, RCC_CFGR__SWS_MASK, RCC_CFGR__SWS_PLL);
+}
+
+/* Back to the reset clock: HSI 16 MHz, no prescaler, no wait state. The steps of clock_pll_180mhz_init() are undone in the opposite order */
+void clock_hsi_init(void)
+{
+	RCC->CFGR = (RCC->CFGR & ~RCC_CFGR__SW_MASK) | RCC_CFGR__SW_HSI;
+	clock_wait(&RCC->CFGR, RCC_CFGR__SWS_MASK, RCC_CFGR__SWS_HSI);
+
+	RCC->CFGR &=~(RCC_CFGR__HPRE_MASK | RCC_CFGR__PPRE1_MASK | RCC_CFGR__PPRE2_MASK);
+
+	/* Slower clock first, then fewer wait states */
+	FLASH->ACR = (FLASH->ACR & ~FLASH_ACR__LATENCY_MASK) | FLASH_ACR__PRFTEN | FLASH_ACR__ICEN | FLASH_ACR__DCEN;
+
+	RCC->CR &=~RCC_CR__PLLON;
+
+	if(RCC->APB1ENR & RCC_APB1ENR__PWREN)
+	{
+		PWR->CR &=~PWR_CR__ODSWEN;
+		PWR->CR &=~PWR_CR__ODEN;
+	}
+
+	RCC->CR &=~RCC_CR__HSEON;
+	RCC->CR &=~RCC_CR__HSEBYP;
+}
+
+/* Returns 0 once (*reg & mask) == value, -1 after CLOCK_TIMEOUT turns */
+static int clock_wait(volatile uint32_t *reg, uint32_t mask, uint32_t value)
+{
+	for(uint32_t i = 0; i < CLOCK_TIMEOUT; i++)
+	{
+		if((*reg & mask) == value)
+		{
+			return 0;
+		}
+	}
+
+	return -1;
+}
@@ -0,0 +1,352 @@
+/**
+ ******************************************************************************
+ * @file           : main.c
+ * @author         : George Calin
+ * @brief          : Main program body
+ * Target board: Nucleo 144 family
+ *
+ * Notes: finds the size from which dma_memcpy()/dma_memset() (dma_memory.c, DMA2) are faster than memcpy()/memset() of the C library,
+ * at 16 MHz (HSI, reset clock) and at 180 MHz (PLL, see clock.c). The table is printed on USART3 at 115200 baud.
+ * User LD2: a blue user LED is connected to PB7, it is lit once the table has been printed.
+ * User LD3: a red user LED is connected to PB14, it is lit if a DMA copy came out wrong or the PLL did not start.
+ * Only clock.c and this file belong to the project: dma.c, dma_memory.c, the USART3 drivers, the startup file and the linker scripts are those of
+ * DMA_UART_Tx_Driver, linked in the Drivers folder (.project).
+ ******************************************************************************
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "uart.h"
+#include "dwt.h"
+#include "dma_memory.h"
+#include "clock.h"
+
+#define GPIOB_ENABLE (1UL<<1)
+#define PIN7	(1UL<<7)
+#define PIN14	(1UL<<14)
+#define LED_PIN	PIN7
+#define ERROR_LED_PIN PIN14
+
+#define BENCHMARK_MAX_SIZE (8192U)
+#define BENCHMARK_REPEATS (8U)				// every measure is the best of this many, the first one pays for the caches of the ART accelerator
+#define BENCHMARK_MISALIGNMENT (1U)			// source and destination apart by one byte: the DMA has to move bytes
+#define BENCHMARK_REPORT_BAUDRATE (115200U)
+#define BENCHMARK_VERSION (1U)				// bump it when the columns or the workload change, the results are not comparable anymore
+
+typedef enum
+{
+	BENCHMARK_MEMCPY_ALIGNED = 0,	// both buffers on 16 bytes: bursts of 4 words
+	BENCHMARK_MEMCPY_UNALIGNED,		// source one byte further: byte transfers
+	BENCHMARK_MEMSET,
+	BENCHMARK_OPERATION_COUNT
+} benchmark_operation_t;
+
+typedef struct
+{
+	uint32_t hclk;
+	benchmark_operation_t operation;
+	uint32_t size;
+	uint32_t cpuCycles;
+	uint32_t dmaCycles;		// from the call until the completion callback
+	uint32_t errors;		// bytes the DMA wrote wrong
+} benchmark_result_t;
+
+static const uint32_t benchmarkSizes[] = {4U, 8U, 16U, 32U, 64U, 128U, 256U, 512U, 1024U, 2048U, 4096U, 8192U};
+
+#define BENCHMARK_SIZE_COUNT (sizeof(benchmarkSizes) / sizeof(benchmarkSizes[0]))
+#define BENCHMARK_CLOCK_COUNT (2U)
+#define BENCHMARK_RESULT_COUNT (BENCHMARK_CLOCK_COUNT * BENCHMARK_OPERATION_COUNT * BENCHMARK_SIZE_COUNT)
+
+/* In SRAM1, which the DMA reaches: the CCM RAM would send every copy to the CPU */
+static uint8_t benchmarkSource[BENCHMARK_MAX_SIZE + 16U] __attribute__((aligned(16)));
+static uint8_t benchmarkDestination[BENCHMARK_MAX_SIZE + 16U] __attribute__((aligned(16)));
+
+static benchmark_result_t benchmarkResults[BENCHMARK_RESULT_COUNT];
+
+static uint32_t benchmark_run_clock(benchmark_result_t *results);
+static void benchmark_measure(benchmark_operation_t operation, uint32_t size, benchmark_result_t *result);
+static uint32_t benchmark_cpu(benchmark_operation_t operation, uint32_t size);
+static uint32_t benchmark_dma(benchmark_operation_t operation, uint32_t size);
+static uint32_t benchmark_check(benchmark_operation_t operation, uint32_t size);
+static void benchmark_report_init(void);
+static void benchmark_print_table(const benchmark_result_t *results, uint32_t count);
+static uint32_t benchmark_crossover(const benchmark_result_t *results, uint32_t count, uint32_t hclk, benchmark_operation_t operation);
+static const char *benchmark_operation_name(benchmark_operation_t operation);
+
+int main(void)
+{
+	uint32_t failed = 0;
+	uint32_t count = 0;
+
+	/* Enable the clock access via AHB1 to GPIO B */
+	RCC->AHB1ENR|=GPIOB_ENABLE;
+
+	/* Set the mode in the MODER registry to output for ports B7 and B14 */
+	GPIOB->MODER &=~((1UL<<15) | (1UL<<29)); //'0'
+	GPIOB->MODER |=((1UL<<14) | (1UL<<28)); //'1'
+
+	dwt_cycle_counter_init();
+
+	if(dma_memory_init() != 0)
+	{
+		failed = 1;
+	}
+
+	/* Every copy goes to the DMA, whatever its size */
+	dma_memory_set_threshold(0);
+
+	for(uint32_t i = 0; i < sizeof(benchmarkSource); i++)
+	{
+		benchmarkSource[i] = (uint8_t) (i * 7U + 1U);
+	}
+
+	clock_hsi_init();
+	count += benchmark_run_clock(&benchmarkResults[count]);
+
+	if(clock_pll_180mhz_init() == 0)
+	{
+		count += benchmark_run_clock(&benchmarkResults[count]);
+	}
+	else
+	{
+		failed = 1;
+	}
+
+	/* Printed at the clock of the last run, the baud rate follows the clock tree */
+	benchmark_report_init();
+	benchmark_print_table(benchmarkResults, count);
+
+	for(uint32_t i = 0; i < count; i++)
+	{
+		if(benchmarkResults[i].errors != 0)
+		{
+			failed = 1;
+		}
+	}
+
+	if(failed)
+	{
+		GPIOB->ODR |=ERROR_LED_PIN;
+	}
+
+	/* Light the user LED */
+	GPIOB->ODR |=LED_PIN;
+
+	for(;;)
+	{
+
+
+	}
+
+}
+
+/* Every operation at every size at the current clock. Returns the number of results written */
+static uint32_t benchmark_run_clock(benchmark_result_t *results)
+{
+	uint32_t index = 0;
+
+	for(uint32_t operation = 0; operation < BENCHMARK_OPERATION_COUNT; operation++)
+	{
+		for(uint32_t i = 0; i < BENCHMARK_SIZE_COUNT; i++)
+		{
+			benchmark_measure((benchmark_operation_t) operation, benchmarkSizes[i], &results[index]);
+			index++;
+		}
+	}
+
+	return index;
+}
+
+/* ******************************************************************************************************************************************************************
+ * Explanation: the DWT cycle counter (dwt.c) measures both sides from the call until the buffer is written. For the DMA this is the call of
+ * dma_memcpy()/dma_memset(), which writes the head and the tail with the CPU and programs the stream, the copy itself, the TC interrupt and the
+ * completion, seen here as dma_memory_busy() going back to 0. While the DMA copies, the CPU could do something else, the table does not count that:
+ * it answers the question of the threshold, from which size handing the copy over is not slower even for a caller that waits for it.
+ * ******************************************************************************************************************************************************************
+ */
+static void benchmark_measure(benchmark_operation_t operation, uint32_t size, benchmark_result_t *result)
+{
+	result->hclk = rcc_get_hclk_freq();
+	result->operation = operation;
+	result->size = size;
+	result->cpuCycles = 0xFFFFFFFFU;
+	result->dmaCycles = 0xFFFFFFFFU;
+
+	for(uint32_t i = 0; i < BENCHMARK_REPEATS; i++)
+	{
+		uint32_t cycles = benchmark_cpu(operation, size);
+
+		if(cycles < result->cpuCycles)
+		{
+			result->cpuCycles = cycles;
+		}
+	}
+
+	result->errors = 0;
+
+	for(uint32_t i = 0; i < BENCHMARK_REPEATS; i++)
+	{
+		memset(benchmarkDestination, 0, sizeof(benchmarkDestination));
+
+		uint32_t cycles = benchmark_dma(operation, size);
+
+		if(cycles < result->dmaCycles)
+		{
+			result->dmaCycles = cycles;
+		}
+
+		result->errors += benchmark_check(operation, size);
+	}
+}
+
+static uint32_t benchmark_cpu(benchmark_operation_t operation, uint32_t size)
+{
+	uint32_t start = dwt_get_cycles();
+
+	if(operation == BENCHMARK_MEMSET)
+	{
+		memset(benchmarkDestination, 0xA5, size);
+	}
+	else if(operation == BENCHMARK_MEMCPY_UNALIGNED)
+	{
+		memcpy(benchmarkDestination, &benchmarkSource[BENCHMARK_MISALIGNMENT], size);
+	}
+	else
+	{
+		memcpy(benchmarkDestination, benchmarkSource, size);
+	}
+
+	return dwt_get_cycles() - start;
+}
+
+static uint32_t benchmark_dma(benchmark_operation_t operation, uint32_t size)
+{
+	uint32_t start = dwt_get_cycles();
+
+	if(operation == BENCHMARK_MEMSET)
+	{
+		dma_memset(benchmarkDestination, 0xA5, size, 0, 0);
+	}
+	else if(operation == BENCHMARK_MEMCPY_UNALIGNED)
+	{
+		dma_memcpy(benchmarkDestination, &benchmarkSource[BENCHMARK_MISALIGNMENT], size, 0, 0);
+	}
+	else
+	{
+		dma_memcpy(benchmarkDestination, benchmarkSource, size, 0, 0);
+	}
+
+	while(dma_memory_busy());
+
+	return dwt_get_cycles() - start;
+}
+
+/* Returns the number of bytes written wrong, the bytes right after the buffer included: the DMA must not write past the end */
+static uint32_t benchmark_check(benchmark_operation_t operation, uint32_t size)
+{
+	uint32_t errors = 0;
+
+	for(uint32_t i = 0; i < size; i++)
+	{
+		uint8_t expected = (operation == BENCHMARK_MEMSET) ? 0xA5U
+				: (operation == BENCHMARK_MEMCPY_UNALIGNED) ? benchmarkSource[i + BENCHMARK_MISALIGNMENT] : benchmarkSource[i];
+
+		if(benchmarkDestination[i] != expected)
+		{
+			errors++;
+		}
+	}
+
+	for(uint32_t i = size; i < sizeof(benchmarkDestination); i++)
+	{
+		if(benchmarkDestination[i] != 0)
+		{
+			errors++;
+		}
+	}
+
+	return errors;
+}
+
+/* USART3 again at the report baud rate, BRR is computed from the clock that is running now */
+static void benchmark_report_init(void)
+{
+	uart3_tx_init();
+	uart3_set_baudrate(BENCHMARK_REPORT_BAUDRATE, USART_OVERSAMPLING_AUTO, 0);
+}
+
+/* ******************************************************************************************************************************************************************
+ * Explanation: the table is CSV between the "#begin" and "#end" lines, like the one of UART_Benchmark, so it can be cut out of a capture of the serial port.
+ * 		cpu_cycles, dma_cycles	the best of BENCHMARK_REPEATS runs, the ns columns are the same at the clock of the run
+ * 		winner					the faster of the two
+ * Then one "#crossover" line for every clock and operation: the smallest size from which the DMA wins at every bigger size as well,
+ * the value to give dma_memory_set_threshold() at that clock. 0 if the DMA never wins up to BENCHMARK_MAX_SIZE.
+ * ******************************************************************************************************************************************************************
+ */
+static void benchmark_print_table(const benchmark_result_t *results, uint32_t count)
+{
+	printf("\r\n#begin dma_memcpy_benchmark version=%u repeats=%u\r\n", BENCHMARK_VERSION, BENCHMARK_REPEATS);
+	printf("hclk,operation,size,cpu_cycles,cpu_ns,dma_cycles,dma_ns,winner,errors\r\n");
+
+	for(uint32_t i = 0; i < count; i++)
+	{
+		const benchmark_result_t *result = &results[i];
+		uint32_t cpuNs = (uint32_t) (((uint64_t) result->cpuCycles * 1000000000U) / result->hclk);
+		uint32_t dmaNs = (uint32_t) (((uint64_t) result->dmaCycles * 1000000000U) / result->hclk);
+
+		printf("%lu,%s,%lu,%lu,%lu,%lu,%lu,%s,%lu\r\n",
+				result->hclk, benchmark_operation_name(result->operation), result->size, result->cpuCycles, cpuNs,
+				result->dmaCycles, dmaNs, (result->dmaCycles < result->cpuCycles) ? "dma" : "cpu", result->errors);
+	}
+
+	for(uint32_t i = 0; i < count; i += (BENCHMARK_OPERATION_COUNT * BENCHMARK_SIZE_COUNT))
+	{
+		for(uint32_t operation = 0; operation < BENCHMARK_OPERATION_COUNT; operation++)
+		{
+			printf("#crossover hclk=%lu operation=%s size=%lu\r\n", results[i].hclk, benchmark_operation_name((benchmark_operation_t) operation),
+					benchmark_crossover(results, count, results[i].hclk, (benchmark_operation_t) operation));
+		}
+	}
+
+	printf("#end\r\n");
+}
+
+/* The results of one clock and operation are in increasing size: walk back from the biggest as long as the DMA wins */
+static uint32_t benchmark_crossover(const benchmark_result_t *results, uint32_t count, uint32_t hclk, benchmark_operation_t operation)
+{
+	uint32_t crossover = 0;
+
+	for(uint32_t i = count; i > 0; i--)
+	{
+		const benchmark_result_t *result = &results[i - 1U];
+
+		if((result->hclk != hclk) || (result->operation != operation))
+		{
+			continue;
+		}
+
+		if(result->dmaCycles >= result->cpuCycles)
+		{
+			break;
+		}
+
+		crossover = result->size;
+	}
+
+	return crossover;
+}
+
+static const char *benchmark_operation_name(benchmark_operation_t operation)
+{
+	if(operation == BENCHMARK_MEMSET)
+	{
+		return "memset";
+	}
+
+	if(operation == BENCHMARK_MEMCPY_UNALIGNED)
+	{
+		return "memcpy_unaligned";
+	}
+
+	return "memcpy_aligned";
+}
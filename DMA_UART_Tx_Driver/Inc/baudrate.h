@@ -0,0 +1,41 @@
+/*
+ * baudrate.h
+ *
+ *  Created on: 17 Oct 2026
+ *  Author: George Calin
+ *  Target Development Board: STM32 Nucleo F429ZI
+ */
+
+#ifndef BAUDRATE_H_
+#define BAUDRATE_H_
+
+#include <stm32f429xx.h>
+#include <stdint.h>
+
+#define HSI_FREQ (16000000U)
+#define HSE_FREQ (8000000U) // on the Nucleo 144 the HSE is the 8 MHz MCO output of the ST-LINK
+
+#define USART_OVERSAMPLING_AUTO (0U) // pick the oversampling with the smaller error, 16 when they are equal because it tolerates more clock deviation
+#define USART_OVERSAMPLING_8 (8U)
+#define USART_OVERSAMPLING_16 (16U)
+
+typedef struct
+{
+	uint32_t peripheralClock;	// the APB clock of the USART in Hz
+	uint32_t requested;			// the baud rate that was asked for
+	uint32_t actual;			// the baud rate the generator really produces
+	int32_t errorPpm;			// (actual - requested) / requested, in parts per million
+	uint16_t brr;				// DIV_Mantissa[11:0] << 4 | DIV_Fraction[3:0]
+	uint8_t oversampling;		// 16 or 8
+} usart_baudrate_t;
+
+uint32_t rcc_get_sysclk_freq(void);
+uint32_t rcc_get_hclk_freq(void);
+uint32_t rcc_get_pclk1_freq(void);
+uint32_t rcc_get_pclk2_freq(void);
+
+uint32_t usart_get_clock(USART_TypeDef *USARTx);
+int usart_compute_baudrate(uint32_t peripheralClock, uint32_t baudRate, uint32_t oversampling, usart_baudrate_t *result);
+int usart_set_baudrate(USART_TypeDef *USARTx, uint32_t baudRate, uint32_t oversampling, usart_baudrate_t *result);
+
+#endif /* BAUDRATE_H_ */
@@ -0,0 +1,57 @@
+/*
+ * dlog.h
+ *
+ *  Created on: 17 Oct 2026
+ *  Author: George Calin
+ *  Target Development Board: STM32 Nucleo F429ZI
+ */
+
+#ifndef DLOG_H_
+#define DLOG_H_
+
+#include <stdint.h>
+
+/* ******************************************************************************************************************************************************************
+ * Deferred logging: DLOG("A second just passed......\n\r") does not format anything on the MCU.
+ * The format string is placed in the section .logstr, which the linker script keeps out of the flash (it only exists in the ELF file),
+ * and at runtime only the address of the string (its ID, 2 bytes) and the raw arguments (4 bytes each) are sent, as a COBS frame ending in 0x00.
+ * Tools/dlog_decode.py reads the strings from the ELF file and prints the messages on the host.
+ * The arguments are sent as 32 bit integers: %d, %i, %u, %x, %X, %c and %p are supported, %s and floating point are not (the string is not in the MCU memory).
+ * Every argument goes through (uint32_t) (uintptr_t), so a pointer for %p needs no cast at the call site. Up to DLOG_MAX_ARGUMENTS arguments.
+ * ******************************************************************************************************************************************************************
+ */
+
+#define DLOG_MAX_ARGUMENTS (8U)
+
+/* DLOG_ARGUMENTS(a, b) expands to ", DLOG_ARGUMENT(a), DLOG_ARGUMENT(b)", the number of arguments picks the DLOG_ARGUMENTS_n to use */
+#define DLOG_ARGUMENT(argument) ((uint32_t) (uintptr_t) (argument))
+#define DLOG_ARGUMENTS_0()
+#define DLOG_ARGUMENTS_1(a) , DLOG_ARGUMENT(a)
+#define DLOG_ARGUMENTS_2(a, b) DLOG_ARGUMENTS_1(a) , DLOG_ARGUMENT(b)
+#define DLOG_ARGUMENTS_3(a, b, c) DLOG_ARGUMENTS_2(a, b) , DLOG_ARGUMENT(c)
+#define DLOG_ARGUMENTS_4(a, b, c, d) DLOG_ARGUMENTS_3(a, b, c) , DLOG_ARGUMENT(d)
+#define DLOG_ARGUMENTS_5(a, b, c, d, e) DLOG_ARGUMENTS_4(a, b, c, d) , DLOG_ARGUMENT(e)
+#define DLOG_ARGUMENTS_6(a, b, c, d, e, f) DLOG_ARGUMENTS_5(a, b, c, d, e) , DLOG_ARGUMENT(f)
+#define DLOG_ARGUMENTS_7(a, b, c, d, e, f, g) DLOG_ARGUMENTS_6(a, b, c, d, e, f) , DLOG_ARGUMENT(g)
+#define DLOG_ARGUMENTS_8(a, b, c, d, e, f, g, h) DLOG_ARGUMENTS_7(a, b, c, d, e, f, g) , DLOG_ARGUMENT(h)
+#define DLOG_COUNT(...) DLOG_COUNT_(0, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define DLOG_COUNT_(zero, a, b, c, d, e, f, g, h, count, ...) count
+#define DLOG_SELECT(count) DLOG_SELECT_(count)
+#define DLOG_SELECT_(count) DLOG_ARGUMENTS_##count
+#define DLOG_ARGUMENTS(...) DLOG_SELECT(DLOG_COUNT(__VA_ARGS__))(__VA_ARGS__)
+
+/* The function the frames are handed to, for example uart3_dma_write or the _write of uart.c */
+typedef int (*dlog_sink_t)(const char *ptr, int len);
+
+#define DLOG(format, ...) \
+	do \
+	{ \
+		static const char dlogFormat[] __attribute__((section(".logstr"))) = format; \
+		const uint32_t dlogArguments[] = {0 DLOG_ARGUMENTS(__VA_ARGS__)}; \
+		dlog_emit(DLOG_ARGUMENT(dlogFormat), &dlogArguments[1], (sizeof(dlogArguments) / sizeof(uint32_t)) - 1U); \
+	} while(0)
+
+void dlog_init(dlog_sink_t sink);
+void dlog_emit(uint32_t id, const uint32_t *arguments, uint32_t count);
+
+#endif /* DLOG_H_ */
@@ -0,0 +1,257 @@
+/*
+ * dma.h
+ *
+ *  Created on: 17 Oct 2026
+ *  Author: George Calin
+ *  Target Development Board: STM32 Nucleo F429ZI
+ */
+
+#ifndef DMA_H_
+#define DMA_H_
+
+#include <stm32f429xx.h>
+#include <stdint.h>
+
+#define DMA_STREAM_COUNT (8U) // streams of every controller
+#define DMA_QUEUE_SIZE (8U) // transfers queued on one stream, the running one included, has to be a power of 2
+#define DMA_MAX_ITEMS (65535U) // DMA_SxNDTR is 16 bits wide
+#define DMA_RECOVERY_LIMIT (3U) // restarts of a circular stream in a row, without a HT or TC in between, before it is given up
+
+/* The peripheral requests of RM0090: DMA1 request mapping and DMA2 request mapping */
+typedef enum
+{
+	DMA_REQUEST_USART1_RX = 0,
+	DMA_REQUEST_USART1_TX,
+	DMA_REQUEST_USART2_RX,
+	DMA_REQUEST_USART2_TX,
+	DMA_REQUEST_USART3_RX,
+	DMA_REQUEST_USART3_TX,
+	DMA_REQUEST_UART4_RX,
+	DMA_REQUEST_UART4_TX,
+	DMA_REQUEST_UART5_RX,
+	DMA_REQUEST_UART5_TX,
+	DMA_REQUEST_USART6_RX,
+	DMA_REQUEST_USART6_TX,
+	DMA_REQUEST_UART7_RX,
+	DMA_REQUEST_UART7_TX,
+	DMA_REQUEST_UART8_RX,
+	DMA_REQUEST_UART8_TX,
+	DMA_REQUEST_SPI1_RX,
+	DMA_REQUEST_SPI1_TX,
+	DMA_REQUEST_SPI2_RX,
+	DMA_REQUEST_SPI2_TX,
+	DMA_REQUEST_SPI3_RX,
+	DMA_REQUEST_SPI3_TX,
+	DMA_REQUEST_SPI4_RX,
+	DMA_REQUEST_SPI4_TX,
+	DMA_REQUEST_SPI5_RX,
+	DMA_REQUEST_SPI5_TX,
+	DMA_REQUEST_SPI6_RX,
+	DMA_REQUEST_SPI6_TX,
+	DMA_REQUEST_I2C1_RX,
+	DMA_REQUEST_I2C1_TX,
+	DMA_REQUEST_I2C2_RX,
+	DMA_REQUEST_I2C2_TX,
+	DMA_REQUEST_I2C3_RX,
+	DMA_REQUEST_I2C3_TX,
+	DMA_REQUEST_ADC1,
+	DMA_REQUEST_ADC2,
+	DMA_REQUEST_ADC3,
+	DMA_REQUEST_DAC1,
+	DMA_REQUEST_DAC2,
+	DMA_REQUEST_TIM2_UP,
+	DMA_REQUEST_SDIO,
+	DMA_REQUEST_MEMORY,		// no peripheral: memory to memory on any stream of DMA2
+	DMA_REQUEST_COUNT
+} dma_request_t;
+
+/* DMA_SxCR bits 7:6 DIR */
+typedef enum
+{
+	DMA_PERIPHERAL_TO_MEMORY = 0,
+	DMA_MEMORY_TO_PERIPHERAL = 1,
+	DMA_MEMORY_TO_MEMORY = 2		// DMA2 only
+} dma_direction_t;
+
+/* DMA_SxCR bits 12:11 PSIZE and 14:13 MSIZE */
+typedef enum
+{
+	DMA_WIDTH_BYTE = 0,
+	DMA_WIDTH_HALF_WORD = 1,
+	DMA_WIDTH_WORD = 2
+} dma_width_t;
+
+/* DMA_SxCR bits 17:16 PL: when two streams of the same controller ask at the same time, the higher priority wins, then the lower stream number */
+typedef enum
+{
+	DMA_PRIORITY_LOW = 0,
+	DMA_PRIORITY_MEDIUM = 1,
+	DMA_PRIORITY_HIGH = 2,
+	DMA_PRIORITY_VERY_HIGH = 3
+} dma_priority_t;
+
+/* DMA_SxCR bits 24:23 MBURST and 22:21 PBURST. Bursts need the FIFO (DMDIS = 1), in direct mode the hardware forces single transfers */
+typedef enum
+{
+	DMA_BURST_SINGLE = 0,
+	DMA_BURST_INCR4 = 1,
+	DMA_BURST_INCR8 = 2,
+	DMA_BURST_INCR16 = 3
+} dma_burst_t;
+
+/* DMA_SxFCR bits 1:0 FTH: how full the FIFO of 4 words gets before it is drained to memory (peripheral to memory) or after which it is filled again */
+typedef enum
+{
+	DMA_FIFO_THRESHOLD_QUARTER = 0,		// 1 word
+	DMA_FIFO_THRESHOLD_HALF = 1,		// 2 words
+	DMA_FIFO_THRESHOLD_3_QUARTERS = 2,	// 3 words
+	DMA_FIFO_THRESHOLD_FULL = 3			// 4 words
+} dma_fifo_threshold_t;
+
+/* Interrupts, at the positions of their enable bits in DMA_SxCR, FE excepted */
+#define DMA_INTERRUPT_DME (1U<<1)	// direct mode error
+#define DMA_INTERRUPT_TE (1U<<2)	// transfer error
+#define DMA_INTERRUPT_HT (1U<<3)	// half transfer
+#define DMA_INTERRUPT_TC (1U<<4)	// transfer complete
+#define DMA_INTERRUPT_FE (1U<<7)	// FIFO error, bit 7 FEIE of DMA_SxFCR
+#define DMA_INTERRUPT_ALL (DMA_INTERRUPT_DME | DMA_INTERRUPT_TE | DMA_INTERRUPT_HT | DMA_INTERRUPT_TC | DMA_INTERRUPT_FE)
+
+/* Status flags of one stream, always at the positions of stream 0 in DMA_LISR, whatever the stream, see dma_stream_get_flags() */
+#define DMA_FLAG_FE (1U<<0)		// FIFO error
+#define DMA_FLAG_DME (1U<<2)	// direct mode error
+#define DMA_FLAG_TE (1U<<3)		// transfer error
+#define DMA_FLAG_HT (1U<<4)		// half transfer
+#define DMA_FLAG_TC (1U<<5)		// transfer complete
+#define DMA_FLAG_ALL (DMA_FLAG_FE | DMA_FLAG_DME | DMA_FLAG_TE | DMA_FLAG_HT | DMA_FLAG_TC)
+#define DMA_FLAG_ERRORS (DMA_FLAG_FE | DMA_FLAG_DME | DMA_FLAG_TE)
+
+/* Not in the hardware: added by dma_stream_handle_errors() to the flags of the error callback */
+#define DMA_EVENT_RECOVERED (1U<<8)	// the stream had stopped and was started again from the beginning of its buffer
+#define DMA_EVENT_ABANDONED (1U<<9)	// it stopped again after DMA_RECOVERY_LIMIT restarts and stays stopped
+
+typedef struct
+{
+	dma_direction_t direction;
+	dma_width_t peripheralWidth;
+	dma_width_t memoryWidth;
+	uint8_t peripheralIncrement;	// 1: the peripheral address moves after every item (memory to memory: the source)
+	uint8_t memoryIncrement;		// 1: the memory address moves after every item
+	uint8_t circular;				// 1: NDTR and the addresses reload at the end, the stream never stops
+	dma_priority_t priority;
+	uint32_t interrupts;			// DMA_INTERRUPT_..., 0 for none
+	dma_burst_t peripheralBurst;	// memory to memory: the source. Needs the FIFO
+	dma_burst_t memoryBurst;		// needs the FIFO
+	uint8_t fifoMode;				// 1: through the FIFO (DMDIS = 1), the widths may differ. Always on memory to memory
+	dma_fifo_threshold_t fifoThreshold;
+} dma_config_t;
+
+/* What the memory port of a stream did since dma_stream_open(), counted by dma_stream_start() from the configuration of every transfer */
+typedef struct
+{
+	uint32_t transfers;
+	uint32_t peripheralAccesses;	// items of the peripheral size, what a direct mode stream would also cost on the memory side
+	uint32_t memoryAccesses;		// items of the memory size
+	uint32_t memoryBursts;			// requests of the memory port: one per burst, one per item in single mode
+	uint32_t unpackedTransfers;		// transfers whose address or length did not allow the configured memory width or burst
+} dma_bus_stats_t;
+
+typedef struct
+{
+	DMA_TypeDef *controller;
+	DMA_Stream_TypeDef *stream;
+	uint8_t number;					// 0..7
+	IRQn_Type irq;
+	uint32_t clockEnableBit;		// in RCC_AHB1ENR
+	volatile uint32_t *flagRegister;	// DMA_LISR for the streams 0..3, DMA_HISR for 4..7
+	volatile uint32_t *clearRegister;	// DMA_LIFCR or DMA_HIFCR
+	uint8_t flagShift;				// 0, 6, 16 or 22
+} dma_stream_hw_t;
+
+typedef struct dma_handle dma_handle_t;
+
+/* Called from the interrupt of the stream with the flags that were set (DMA_FLAG_...), already cleared */
+typedef void (*dma_callback_t)(dma_handle_t *handle, uint32_t flags, void *context);
+
+/* Called from the interrupt of the stream when one half of the buffer of the running transfer is written (peripheral to memory) or has been read
+ * (memory to peripheral): the first half on HT, the second one on TC. In circular mode the DMA is busy with the other half meanwhile */
+typedef void (*dma_half_callback_t)(uint32_t memoryAddress, uint32_t bytes, void *context);
+
+typedef struct
+{
+	uint32_t transferErrors;	// TE: bus error, the hardware stopped the stream
+	uint32_t directModeErrors;	// DME
+	uint32_t fifoErrors;		// FE: FIFO overrun or underrun, or a configuration the FIFO cannot serve
+	uint32_t recoveries;		// circular streams started again
+	uint32_t abandoned;			// circular streams given up after DMA_RECOVERY_LIMIT restarts
+} dma_error_stats_t;
+
+/* Called from the interrupt of the stream when a queued transfer is over: DMA_FLAG_TC, or DMA_FLAG_TE if it stopped on a bus error */
+typedef void (*dma_transfer_callback_t)(uint32_t flags, void *context);
+
+/* One transfer of the queue of a stream, see dma_stream_submit() */
+typedef struct
+{
+	uint32_t memoryAddress;			// memory to memory: the destination
+	uint32_t peripheralAddress;		// 0: the one given to dma_stream_open(). Memory to memory: the source
+	uint32_t length;				// items of the peripheral size, 1..DMA_MAX_ITEMS
+	dma_transfer_callback_t callback;	// 0 for none
+	void *context;
+} dma_transfer_t;
+
+typedef struct
+{
+	uint32_t submitted;		// accepted by dma_stream_submit()
+	uint32_t completed;
+	uint32_t errors;		// ended with a transfer error
+	uint32_t rejected;		// the queue was full
+	uint32_t highWater;		// the most transfers that have ever waited at the same time
+} dma_queue_stats_t;
+
+struct dma_handle
+{
+	const dma_stream_hw_t *hw;
+	dma_request_t request;
+	uint8_t channel;
+	uint8_t opened;
+	dma_callback_t callback;
+	void *context;
+	uint32_t peripheralAddress;		// as given to dma_stream_open()/dma_stream_configure()
+	uint32_t cr;					// DMA_SxCR as configured, without EN
+	dma_bus_stats_t busStats;
+	uint32_t memoryAddress;			// of the last dma_stream_start(), where a circular stream is started again after an error
+	uint32_t length;				// 0 until dma_stream_start()
+	dma_half_callback_t halfCallback;
+	void *halfContext;
+	dma_callback_t errorCallback;
+	void *errorContext;
+	dma_error_stats_t errorStats;
+	uint8_t recoveryFailures;		// restarts since the last HT or TC
+	dma_transfer_t queue[DMA_QUEUE_SIZE];
+	volatile uint32_t queueHead;	// next free descriptor, moved by dma_stream_submit()
+	volatile uint32_t queueTail;	// the running transfer, moved by the interrupt
+	volatile uint8_t queueRunning;	// 1 while the transfer at the tail is on the stream
+	dma_queue_stats_t queueStats;
+};
+
+dma_handle_t *dma_stream_open(dma_request_t request, const dma_config_t *config, uint32_t peripheralAddress);
+void dma_stream_close(dma_handle_t *handle);
+int dma_stream_configure(dma_handle_t *handle, const dma_config_t *config, uint32_t peripheralAddress);
+void dma_stream_set_callback(dma_handle_t *handle, dma_callback_t callback, void *context);
+void dma_stream_start(dma_handle_t *handle, uint32_t memoryAddress, uint32_t length);
+void dma_stream_stop(dma_handle_t *handle);
+uint32_t dma_stream_busy(dma_handle_t *handle);
+uint32_t dma_stream_remaining(dma_handle_t *handle);
+uint32_t dma_stream_get_flags(dma_handle_t *handle);
+void dma_stream_clear_flags(dma_handle_t *handle, uint32_t flags);
+int dma_stream_submit(dma_handle_t *handle, const dma_transfer_t *transfer);
+uint32_t dma_stream_queued(dma_handle_t *handle);
+void dma_stream_flush(dma_handle_t *handle);
+void dma_stream_get_queue_stats(dma_handle_t *handle, dma_queue_stats_t *stats);
+void dma_stream_get_bus_stats(dma_handle_t *handle, dma_bus_stats_t *stats);
+void dma_stream_set_half_callback(dma_handle_t *handle, dma_half_callback_t callback, void *context);
+void dma_stream_set_error_callback(dma_handle_t *handle, dma_callback_t callback, void *context);
+uint32_t dma_stream_handle_errors(dma_handle_t *handle, uint32_t flags);
+void dma_stream_get_error_stats(dma_handle_t *handle, dma_error_stats_t *stats);
+void dma_irq_handler(uint32_t controller, uint32_t stream);
+
+#endif /* DMA_H_ */
@@ -0,0 +1,42 @@
+/*
+ * dma_memory.h
+ *
+ *  Created on: 17 Oct 2026
+ *  Author: George Calin
+ *  Target Development Board: STM32 Nucleo F429ZI
+ */
+
+#ifndef DMA_MEMORY_H_
+#define DMA_MEMORY_H_
+
+#include <stm32f429xx.h>
+#include <stdint.h>
+#include "dma.h"
+
+#define DMA_MEMORY_THRESHOLD_DEFAULT (128U)	// bytes, shorter copies are done by the CPU. Measure it with DMA_Memcpy_Benchmark
+#define DMA_MEMORY_CCM_START (0x10000000UL)	// the 64 KB of CCM RAM are wired to the D-bus of the core only, no DMA can reach them
+#define DMA_MEMORY_CCM_END (0x10010000UL)
+
+#define DMA_MEMORY_OK (0)
+#define DMA_MEMORY_ERROR (-1)				// transfer error: a bus error on an address the DMA cannot reach
+
+/* Called once the whole buffer is written, with DMA_MEMORY_OK or DMA_MEMORY_ERROR. From DMA2_Streamx_IRQHandler, or straight from
+ * dma_memcpy()/dma_memset() when the CPU did the work */
+typedef void (*dma_memory_callback_t)(int status, void *context);
+
+typedef struct
+{
+	uint32_t dmaTransfers;		// dma_memcpy()/dma_memset() handed to DMA2
+	uint32_t cpuTransfers;		// done by the CPU: shorter than the threshold, or in CCM RAM
+	uint32_t errors;
+} dma_memory_stats_t;
+
+int dma_memory_init(void);
+int dma_memcpy(void *destination, const void *source, uint32_t length, dma_memory_callback_t callback, void *context);
+int dma_memset(void *destination, uint8_t value, uint32_t length, dma_memory_callback_t callback, void *context);
+uint32_t dma_memory_busy(void);
+void dma_memory_set_threshold(uint32_t bytes);
+uint32_t dma_memory_get_threshold(void);
+void dma_memory_get_stats(dma_memory_stats_t *stats);
+
+#endif /* DMA_MEMORY_H_ */
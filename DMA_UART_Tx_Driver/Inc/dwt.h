@@ -0,0 +1,19 @@
+/*
+ * dwt.h
+ *
+ *  Created on: 17 Oct 2026
+ *  Author: George Calin
+ *  Target Development Board: STM32 Nucleo F429ZI
+ */
+
+#ifndef DWT_H_
+#define DWT_H_
+
+#include <stm32f429xx.h>
+#include <stdint.h>
+
+void dwt_cycle_counter_init(void);
+uint32_t dwt_get_cycles(void);
+int dwt_cycle_counter_is_running(void);
+
+#endif /* DWT_H_ */
@@ -0,0 +1,21 @@
+/*
+ * format.h
+ *
+ *  Created on: 17 Oct 2026
+ *  Author: George Calin
+ *  Target Development Board: STM32 Nucleo F429ZI
+ */
+
+#ifndef FORMAT_H_
+#define FORMAT_H_
+
+#include <stdint.h>
+#include <stdarg.h>
+
+#define FORMAT_UART_BUFFER_SIZE (128U) // the longest line uart3_printf can send, it lives on the stack of the caller
+
+int format_vsnprintf(char *buffer, uint32_t size, const char *format, va_list arguments);
+int format_snprintf(char *buffer, uint32_t size, const char *format, ...);
+int uart3_printf(const char *format, ...);
+
+#endif /* FORMAT_H_ */
@@ -0,0 +1,45 @@
+/*
+ * logq.h
+ *
+ *  Created on: 17 Oct 2026
+ *  Author: George Calin
+ *  Target Development Board: STM32 Nucleo F429ZI
+ */
+
+#ifndef LOGQ_H_
+#define LOGQ_H_
+
+#include <stm32f429xx.h>
+#include <stdint.h>
+
+#define LOGQ_SLOTS (32U)		// records waiting at the same time, has to be a power of 2
+#define LOGQ_SLOT_SIZE (64U)	// the longest record, level tag and end of line included
+
+typedef enum
+{
+	LOGQ_LEVEL_ERROR = 0,
+	LOGQ_LEVEL_WARNING,
+	LOGQ_LEVEL_INFO,
+	LOGQ_LEVEL_DEBUG,
+	LOGQ_LEVEL_COUNT
+} logq_level_t;
+
+typedef struct
+{
+	uint32_t committed;					// records placed in the queue since logq_init()
+	uint32_t sent;						// records handed to the sink
+	uint32_t dropped[LOGQ_LEVEL_COUNT];	// records lost because the queue was full, per level
+	uint32_t highWater;					// the maximum number of records that have ever waited at the same time
+} logq_stats_t;
+
+/* The function the records are handed to, for example uart3_write_partial. It returns the number of characters it accepted.
+ * logq_drain() keeps what was not accepted, so the sink must not count it as lost */
+typedef int (*logq_sink_t)(const char *ptr, int len);
+
+void logq_init(logq_sink_t sink);
+int logq_printf(logq_level_t level, const char *format, ...);
+int logq_write(logq_level_t level, const char *text, uint32_t length);
+uint32_t logq_drain(void);
+void logq_get_stats(logq_stats_t *stats);
+
+#endif /* LOGQ_H_ */
@@ -0,0 +1,48 @@
+/*
+ * telemetry.h
+ *
+ *  Created on: 17 Oct 2026
+ *  Author: George Calin
+ *  Target Development Board: STM32 Nucleo F429ZI
+ */
+
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+#include <stm32f429xx.h>
+#include <stdint.h>
+
+#define TELEMETRY_MAX_PAYLOAD (240U)
+
+/* Types of records, the host decoder (Tools/telemetry_decode.py) has to know the same numbers */
+#define TELEMETRY_TYPE_RAW (0x00U)		// payload of bytes
+#define TELEMETRY_TYPE_ADC (0x01U)		// payload of uint16_t ADC samples
+#define TELEMETRY_TYPE_ACCEL (0x02U)	// payload of int16_t x, y, z triples from the ADXL345
+#define TELEMETRY_TYPE_ADC_DELTA (0x03U)	// the same samples as TELEMETRY_TYPE_ADC, delta + zig-zag + varint encoded
+#define TELEMETRY_TYPE_ACCEL_DELTA (0x04U)	// the same triples as TELEMETRY_TYPE_ACCEL, delta + zig-zag + varint encoded per axis
+#define TELEMETRY_TYPE_STATS (0x05U)	// payload of one telemetry_stats_t, see telemetry_send_stats()
+
+typedef struct
+{
+	uint32_t samples;			// values handed to telemetry_send_adc/accel (an x, y, z triple counts 3)
+	uint32_t rawBytes;			// what their payloads would have taken uncompressed
+	uint32_t sentBytes;			// what the payloads really took
+	uint32_t ratioPercent;		// rawBytes / sentBytes: 200 means twice as many samples per second through the same baud rate
+	uint32_t cyclesPerSample;	// spent in the delta encoder
+} telemetry_stats_t;
+
+/* The function the encoded frames are handed to, for example uart3_dma_write or uart3_dbm_logger_write */
+typedef int (*telemetry_sink_t)(const char *ptr, int len);
+
+void telemetry_init(telemetry_sink_t sink);
+int telemetry_send(uint8_t type, const void *payload, uint16_t length);
+int telemetry_send_adc(const uint16_t *samples, uint16_t count);
+int telemetry_send_accel(const int16_t *xyz, uint16_t count);
+void telemetry_set_compression(uint32_t enabled);
+void telemetry_get_stats(telemetry_stats_t *stats);
+int telemetry_send_stats(void);
+
+uint32_t crc32_hw_compute(const uint8_t *data, uint32_t length);
+uint32_t cobs_encode(const uint8_t *source, uint32_t length, uint8_t *destination);
+
+#endif /* TELEMETRY_H_ */
@@ -11,6 +11,8 @@
 
 #include <stm32f429xx.h>
 #include <stdint.h>
+#include "baudrate.h"
+#include "usart.h"
 
 void uart3_tx_init(void);
 void uart3_rx_interrupt_init(void);
@@ -20,7 +22,128 @@ void uart3_rxtx_init(void);
 void uart3_write(int charYouWantToWrite);
 int __io_putchar(int myCharacter);
 
-void dma1_stream3_init(uint32_t source, uint32_t destination, uint32_t length);
+int uart3_set_baudrate(uint32_t baudRate, uint32_t oversampling, usart_baudrate_t *result);
+uint32_t uart3_get_baudrate(void);
+int uart3_flow_control_init(uint32_t flags);
+
+/* *** Multiprocessor (mute mode) addressing on a multi-drop bus, see usart_multiprocessor_init() *** */
+int uart3_multiprocessor_init(uint8_t address);
+int uart3_mute(void);
+uint32_t uart3_is_muted(void);
+int uart3_write_address(uint8_t address);
+
+/* *** Interrupt driven transmitter with a ring buffer *** */
+#define UART3_TX_BUFFER_SIZE (256U) // has to be a power of 2 so the indexes can wrap around with a mask
+
+typedef enum
+{
+	UART_TX_FULL_DROP = 0,		// the new character is thrown away
+	UART_TX_FULL_BLOCK,			// the caller waits until the interrupt made room for the new character
+	UART_TX_FULL_OVERWRITE		// the oldest character still waiting in the buffer is thrown away
+} uart_tx_full_policy_t;
+
+typedef struct
+{
+	uint32_t highWater;		// the maximum number of characters that have ever waited in the buffer at the same time
+	uint32_t dropped;		// the number of characters lost because the buffer was full
+} uart_tx_stats_t;
+
+typedef enum
+{
+	UART_TX_BACKEND_POLLED = 0,		// uart3_write(): the CPU waits on TXE for every character
+	UART_TX_BACKEND_INTERRUPT,		// ring buffer drained by USART3_IRQHandler
+	UART_TX_BACKEND_DMA,			// staging buffer sent by DMA1 Stream3 Channel4, chained from the interrupt of the stream
+	UART_TX_BACKEND_DMA_DOUBLE_BUFFER	// continuous logger, DMA1 Stream3 in double buffer mode alternating between two halves
+} uart_tx_backend_t;
+
+void uart3_tx_ring_init(void);
+void uart3_tx_set_full_policy(uart_tx_full_policy_t policy);
+int uart3_tx_ring_put(char character);
+void uart3_tx_get_stats(uart_tx_stats_t *stats);
+void uart3_tx_reset_stats(void);
+
+/* *** DMA driven transmitter behind _write *** */
+#define UART3_DMA_TX_BUFFER_SIZE (1024U) // has to be a power of 2
+
+int uart3_dma_tx_init(void);
+int uart3_dma_write(const char *ptr, int len);
+uart_tx_backend_t uart3_tx_get_backend(void);
+uint32_t uart3_tx_pending(void);
+int uart3_write_buffer(const char *ptr, int len);
+int uart3_write_partial(const char *ptr, int len); // takes only what fits now, the rest is left to the caller and not counted as dropped
+void dma1_callback(void); // called from the interrupt of the USART3_TX stream once everything that was queued has been sent
+
+/* *** Asynchronous write with completion callback, and flush *** */
+#define UART3_TX_MAX_CALLBACKS (8U) // completions waiting at the same time, has to be a power of 2
+
+typedef void (*uart_tx_callback_t)(void *context); // called from the interrupt of the USART3_TX stream
+
+int uart3_write_async(const char *ptr, int len, uart_tx_callback_t callback, void *context);
+int uart3_flush(uint32_t timeoutMs);
+
+/* *** Zero copy scatter gather write over the DMA transmitter *** */
+#define UART3_WRITEV_MAX_SEGMENTS (8U)
+
+typedef struct
+{
+	const uint8_t *data;	// read by the DMA in place, it must stay untouched until uart3_writev_callback()
+	uint32_t length;
+} uart_segment_t;
+
+int uart3_writev(const uart_segment_t *segments, uint32_t count);
+int uart3_writev_busy(void);
+void uart3_writev_callback(void); // called from the interrupt of the USART3_TX stream once the whole message has been sent
+
+/* *** Continuous logger with DMA double buffer mode *** */
+#define UART3_DBM_HALF_SIZE (64U) // characters sent by one half, at 115200 baud one half lasts about 5.5 ms
+#define UART3_DBM_FILL_CHARACTER (0x00) // sent in the unused part of a half, so the line never goes idle. The receiver has to discard it, see uart.c
+
+typedef struct
+{
+	uint32_t payloadBytes;			// characters written by the application and sent
+	uint32_t sentBytes;				// characters sent on the line, payload plus fill characters
+	uint32_t dropped;				// characters lost because the half being filled was full
+	uint32_t lineCapacity;			// the theoretical capacity of the line in characters per second (baud rate / 10 bits per frame)
+	uint32_t payloadPerSecond;		// achieved payload in characters per second
+	uint32_t utilizationPermille;	// payloadBytes / sentBytes, in 1/1000 of the theoretical capacity
+} uart_dbm_stats_t;
+
+int uart3_dbm_logger_init(void);
+int uart3_dbm_logger_write(const char *ptr, int len);
+void uart3_dbm_logger_get_stats(uart_dbm_stats_t *stats);
+
+/* *** DMA driven receiver with IDLE line frame detection *** */
+#define UART3_DMA_RX_BUFFER_SIZE (512U) // has to be a power of 2
+#define UART3_DMA_RX_MAX_FRAMES (8U) // frame ends remembered until the application reads them
+
+typedef struct
+{
+	uint32_t received;		// characters written by the DMA since the initialization
+	uint32_t frames;		// frames detected through the IDLE line
+	uint32_t overrun;		// characters overwritten by the DMA before the application read them
+	uint32_t framesMerged;	// frame ends forgotten because the application did not read the frames fast enough
+	uint32_t addresses;		// multiprocessor mode: address characters that woke this node, read by uart3_read() (the DMA receiver does not see the ninth bit)
+} uart_rx_stats_t;
+
+int uart3_dma_rx_init(void);
+uint32_t uart3_dma_rx_available(void);
+uint32_t uart3_dma_rx_read(uint8_t *destination, uint32_t maxLength);
+int uart3_dma_rx_read_frame(uint8_t *destination, uint32_t maxLength);
+void uart3_dma_rx_get_stats(uart_rx_stats_t *stats);
+void usart3_rx_frame_callback(uint32_t length); // called from USART3_IRQHandler every time the IDLE line closes a frame
+
+/* *** stdin (_read, __io_getchar) backed by the DMA receiver *** */
+#define UART3_READ_NONBLOCKING (0U)
+#define UART3_READ_FOREVER (0xFFFFFFFFU)
+
+void uart3_stdin_init(uint32_t timeoutMs);
+void uart3_stdin_set_timeout(uint32_t timeoutMs);
+uint32_t uart3_rx_available(void);
+uint32_t uart3_read_timeout(uint8_t *destination, uint32_t maxLength, uint32_t timeoutMs);
+int uart3_getchar_timeout(uint32_t timeoutMs);
+int __io_getchar(void);
+
+int dma1_stream3_init(uint32_t source, uint32_t destination, uint32_t length);
 
 
 #endif /* UART_H_ */
@@ -0,0 +1,99 @@
+/*
+ * usart.h
+ *
+ *  Created on: 17 Oct 2026
+ *  Author: George Calin
+ *  Target Development Board: STM32 Nucleo F429ZI
+ */
+
+#ifndef USART_H_
+#define USART_H_
+
+#include <stm32f429xx.h>
+#include <stdint.h>
+#include "baudrate.h"
+
+#define USART_TX_BUFFER_SIZE (128U) // for every port, has to be a power of 2
+#define USART_RX_BUFFER_SIZE (128U) // for every port, has to be a power of 2
+
+typedef enum
+{
+	USART_PORT_1 = 0,	// PA9 TX,  PA10 RX, AF7, APB2
+	USART_PORT_2,		// PD5 TX,  PD6 RX,  AF7, APB1
+	USART_PORT_3,		// PD8 TX,  PD9 RX,  AF7, APB1 (the ST-LINK virtual COM port of the Nucleo 144)
+	UART_PORT_4,		// PC10 TX, PC11 RX, AF8, APB1
+	UART_PORT_5,		// PC12 TX, PD2 RX,  AF8, APB1
+	USART_PORT_6,		// PC6 TX,  PC7 RX,  AF8, APB2
+	UART_PORT_7,		// PE8 TX,  PE7 RX,  AF8, APB1
+	UART_PORT_8,		// PE1 TX,  PE0 RX,  AF8, APB1
+	USART_PORT_COUNT
+} usart_port_t;
+
+typedef struct
+{
+	USART_TypeDef *instance;
+	GPIO_TypeDef *txPort;
+	uint8_t txPin;
+	GPIO_TypeDef *rxPort;
+	uint8_t rxPin;
+	uint8_t alternateFunction;
+	volatile uint32_t *clockEnableRegister;	// RCC->APB1ENR or RCC->APB2ENR
+	uint32_t clockEnableBit;
+	IRQn_Type irq;
+	GPIO_TypeDef *ctsPort;		// 0 for the UARTs, which have no hardware flow control
+	uint8_t ctsPin;
+	GPIO_TypeDef *rtsPort;
+	uint8_t rtsPin;
+} usart_hw_t;
+
+#define USART_FLOW_NONE (0U)
+#define USART_FLOW_RTS (1U<<0)	// nRTS goes low when the receiver is ready for the next character
+#define USART_FLOW_CTS (1U<<1)	// the transmitter starts a character only while nCTS is low
+
+#define USART_ADDRESS_MARK (0x100U)		// the ninth bit, set only in the address characters of a multiprocessor bus
+#define USART_ADDRESS_MAX (0x0FU)		// the node address is compared on the 4 low bits
+
+typedef struct
+{
+	uint32_t txDropped;		// characters refused by usart_write because the TX buffer was full
+	uint32_t rxDropped;		// characters received while the RX buffer was full
+	uint32_t rxErrors;		// overrun, noise, framing and parity errors reported by the USART
+	uint32_t rxAddresses;	// address characters received in multiprocessor mode: the messages that woke this node up
+} usart_stats_t;
+
+typedef struct
+{
+	const usart_hw_t *hw;
+	usart_port_t port;
+	uint8_t opened;
+	usart_baudrate_t baudrate;
+
+	volatile uint8_t txBuffer[USART_TX_BUFFER_SIZE];
+	volatile uint32_t txHead;
+	volatile uint32_t txTail;
+
+	volatile uint8_t rxBuffer[USART_RX_BUFFER_SIZE];
+	volatile uint32_t rxHead;
+	volatile uint32_t rxTail;
+
+	volatile usart_stats_t stats;
+} usart_handle_t;
+
+usart_handle_t *usart_open(usart_port_t port, uint32_t baudRate);
+void usart_close(usart_handle_t *handle);
+uint32_t usart_write(usart_handle_t *handle, const uint8_t *data, uint32_t length);
+uint32_t usart_read(usart_handle_t *handle, uint8_t *destination, uint32_t maxLength);
+uint32_t usart_rx_available(usart_handle_t *handle);
+uint32_t usart_tx_pending(usart_handle_t *handle);
+void usart_get_stats(usart_handle_t *handle, usart_stats_t *stats);
+void usart_irq_handler(usart_port_t port);
+
+int usart_flow_control_init(usart_port_t port, uint32_t flags);
+uint32_t usart_cts_is_clear(usart_port_t port);
+
+int usart_multiprocessor_init(usart_port_t port, uint8_t address);
+int usart_mute(usart_port_t port);
+uint32_t usart_is_muted(usart_port_t port);
+int usart_write_address(usart_port_t port, uint8_t address);
+
+#endif /* USART_H_ */
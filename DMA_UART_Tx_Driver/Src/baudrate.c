@@ -0,0 +1,188 @@
+/*
+ * baudrate.c
+ *
+ *  Created on: 17 Oct 2026
+ *  Author: George Calin
+ *  Target Development Board: STM32 Nucleo F429ZI
+ */
+
+#include <stdlib.h>
+#include "baudrate.h"
+
+#define RCC_CFGR__SWS_MASK (3UL<<2)
+#define RCC_CFGR__SWS_HSE (1UL<<2)
+#define RCC_CFGR__SWS_PLL (2UL<<2)
+#define RCC_CFGR__HPRE_POS (4U)
+#define RCC_CFGR__PPRE1_POS (10U)
+#define RCC_CFGR__PPRE2_POS (13U)
+
+#define RCC_PLLCFGR__PLLSRC_HSE (1UL<<22)
+
+#define USART_CR1__UE (1UL<<13)
+#define USART_CR1__OVER8 (1UL<<15)
+
+#define USART_BRR_MANTISSA_MAX (0xFFFU)
+
+/* ******************************************************************************************************************************************************************
+ * Explanation: Info taken from RM0090: RCC clock configuration register (RCC_CFGR)
+ * 		Bits 3:2 SWS: System clock switch status. 00: HSI oscillator, 01: HSE oscillator, 10: PLL
+ * 		Bits 7:4 HPRE: AHB prescaler. 0xxx: system clock not divided, 1000: divided by 2, 1001: by 4, 1010: by 8, 1011: by 16, 1100: by 64, 1101: by 128, 1110: by 256, 1111: by 512
+ * 		Bits 12:10 PPRE1: APB Low speed prescaler (APB1). 0xx: AHB clock not divided, 100: divided by 2, 101: by 4, 110: by 8, 111: by 16
+ * 		Bits 15:13 PPRE2: APB high-speed prescaler (APB2), same coding as PPRE1
+ * Info taken from RM0090: RCC PLL configuration register (RCC_PLLCFGR)
+ * 		Bits 5:0 PLLM, bits 14:6 PLLN, bits 17:16 PLLP (00: 2, 01: 4, 10: 6, 11: 8), bit 22 PLLSRC (0: HSI, 1: HSE)
+ * 		f(VCO) = f(PLL input) * PLLN / PLLM and f(PLL general clock output) = f(VCO) / PLLP
+ * Reading the real clock tree instead of assuming 16 MHz keeps the baud rate right when somebody starts the PLL.
+ * ******************************************************************************************************************************************************************
+ */
+uint32_t rcc_get_sysclk_freq(void)
+{
+	uint32_t source = RCC->CFGR & RCC_CFGR__SWS_MASK;
+
+	if(source == RCC_CFGR__SWS_HSE)
+	{
+		return HSE_FREQ;
+	}
+
+	if(source == RCC_CFGR__SWS_PLL)
+	{
+		uint32_t pllcfgr = RCC->PLLCFGR;
+		uint32_t input = (pllcfgr & RCC_PLLCFGR__PLLSRC_HSE) ? HSE_FREQ : HSI_FREQ;
+		uint32_t pllm = pllcfgr & 0x3FU;
+		uint32_t plln = (pllcfgr >> 6) & 0x1FFU;
+		uint32_t pllp = (((pllcfgr >> 16) & 0x3U) + 1U) * 2U;
+
+		return (uint32_t) (((uint64_t) input * plln) / (pllm * pllp));
+	}
+
+	return HSI_FREQ;
+}
+
+uint32_t rcc_get_hclk_freq(void)
+{
+	static const uint8_t ahbShift[16] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 3, 4, 6, 7, 8, 9};
+
+	return rcc_get_sysclk_freq() >> ahbShift[(RCC->CFGR >> RCC_CFGR__HPRE_POS) & 0xFU];
+}
+
+uint32_t rcc_get_pclk1_freq(void)
+{
+	static const uint8_t apbShift[8] = {0, 0, 0, 0, 1, 2, 3, 4};
+
+	return rcc_get_hclk_freq() >> apbShift[(RCC->CFGR >> RCC_CFGR__PPRE1_POS) & 0x7U];
+}
+
+uint32_t rcc_get_pclk2_freq(void)
+{
+	static const uint8_t apbShift[8] = {0, 0, 0, 0, 1, 2, 3, 4};
+
+	return rcc_get_hclk_freq() >> apbShift[(RCC->CFGR >> RCC_CFGR__PPRE2_POS) & 0x7U];
+}
+
+/* From the block diagram in the datasheet: USART1 and USART6 are on APB2, all the others on APB1 */
+uint32_t usart_get_clock(USART_TypeDef *USARTx)
+{
+	if((USARTx == USART1) || (USARTx == USART6))
+	{
+		return rcc_get_pclk2_freq();
+	}
+
+	return rcc_get_pclk1_freq();
+}
+
+/* ******************************************************************************************************************************************************************
+ * Explanation: Info taken from RM0090: Fractional baud rate generation and Baud rate register (USART_BRR)
+ * 		Tx/Rx baud = f(CK) / (8 * (2 - OVER8) * USARTDIV)
+ * 		Bits 15:4 DIV_Mantissa[11:0], bits 3:0 DIV_Fraction[3:0]
+ * 		When OVER8 = 0 the fraction is coded on 4 bits (sixteenths), when OVER8 = 1 it is coded on 3 bits (eighths) and DIV_Fraction3 must be kept cleared.
+ * So USARTDIV * oversampling = f(CK) / baud: rounding this single number gives the mantissa in the upper bits and the fraction in the lower 4 (or 3) bits.
+ * With 16x oversampling the fastest baud rate is f(CK) / 16, with 8x it is f(CK) / 8: 11.25 Mbaud for USART1/6 on a 90 MHz APB2.
+ * Returns 0 when the baud rate can be generated, -1 when it is out of the range of the generator.
+ * ******************************************************************************************************************************************************************
+ */
+int usart_compute_baudrate(uint32_t peripheralClock, uint32_t baudRate, uint32_t oversampling, usart_baudrate_t *result)
+{
+	if(oversampling == USART_OVERSAMPLING_AUTO)
+	{
+		usart_baudrate_t over16;
+		usart_baudrate_t over8;
+		int valid16 = usart_compute_baudrate(peripheralClock, baudRate, USART_OVERSAMPLING_16, &over16);
+		int valid8 = usart_compute_baudrate(peripheralClock, baudRate, USART_OVERSAMPLING_8, &over8);
+
+		if((valid16 == 0) && ((valid8 != 0) || (labs(over16.errorPpm) <= labs(over8.errorPpm))))
+		{
+			*result = over16;
+			return 0;
+		}
+
+		*result = over8;
+		return valid8;
+	}
+
+	result->peripheralClock = peripheralClock;
+	result->requested = baudRate;
+	result->oversampling = (uint8_t) oversampling;
+	result->brr = 0;
+	result->actual = 0;
+	result->errorPpm = 0;
+
+	if((baudRate == 0) || ((oversampling != USART_OVERSAMPLING_8) && (oversampling != USART_OVERSAMPLING_16)))
+	{
+		return -1;
+	}
+
+	/* USARTDIV multiplied by the oversampling, rounded to the nearest integer */
+	uint32_t divider = (peripheralClock + (baudRate / 2U)) / baudRate;
+	uint32_t fractionBits = (oversampling == USART_OVERSAMPLING_16) ? 4U : 3U;
+	uint32_t mantissa = divider >> fractionBits;
+	uint32_t fraction = divider & ((1UL << fractionBits) - 1U);
+
+	if((mantissa == 0) || (mantissa > USART_BRR_MANTISSA_MAX))
+	{
+		return -1;
+	}
+
+	result->brr = (uint16_t) ((mantissa << 4) | fraction);
+	result->actual = (peripheralClock + (divider / 2U)) / divider;
+	result->errorPpm = (int32_t) ((((int64_t) result->actual - (int64_t) baudRate) * 1000000LL) / (int64_t) baudRate);
+
+	return 0;
+}
+
+/* Info taken from RM0090: Control register 1 (USART_CR1), Bit 15 OVER8: Oversampling mode. 0: oversampling by 16, 1: oversampling by 8 */
+int usart_set_baudrate(USART_TypeDef *USARTx, uint32_t baudRate, uint32_t oversampling, usart_baudrate_t *result)
+{
+	usart_baudrate_t computed;
+
+	if(usart_compute_baudrate(usart_get_clock(USARTx), baudRate, oversampling, &computed) != 0)
+	{
+		if(result != 0)
+		{
+			*result = computed;
+		}
+		return -1;
+	}
+
+	/* The oversampling should not change while the USART is enabled, so the module is stopped for the time of the change */
+	uint32_t enabled = USARTx->CR1 & USART_CR1__UE;
+	USARTx->CR1 &=~USART_CR1__UE;
+
+	if(computed.oversampling == USART_OVERSAMPLING_8)
+	{
+		USARTx->CR1 |= USART_CR1__OVER8;
+	}
+	else
+	{
+		USARTx->CR1 &=~USART_CR1__OVER8;
+	}
+
+	USARTx->BRR = computed.brr;
+	USARTx->CR1 |= enabled;
+
+	if(result != 0)
+	{
+		*result = computed;
+	}
+
+	return 0;
+}
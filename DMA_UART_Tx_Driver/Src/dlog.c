@@ -0,0 +1,52 @@
+/*
+ * dlog.c
+ *
+ *  Created on: 17 Oct 2026
+ *  Author: George Calin
+ *  Target Development Board: STM32 Nucleo F429ZI
+ */
+
+#include "dlog.h"
+#include "telemetry.h"
+
+/* ID (2 bytes) and the arguments, COBS adds 1 byte and the delimiter 1 more */
+#define DLOG_RECORD_MAX (2U + (4U * DLOG_MAX_ARGUMENTS))
+#define DLOG_ENCODED_MAX (DLOG_RECORD_MAX + 2U)
+
+static dlog_sink_t dlogSink;
+
+void dlog_init(dlog_sink_t sink)
+{
+	dlogSink = sink;
+}
+
+/* Called by the DLOG macro. The buffers live on the stack, so DLOG can be used from the main loop and from any interrupt at the same time */
+void dlog_emit(uint32_t id, const uint32_t *arguments, uint32_t count)
+{
+	uint8_t record[DLOG_RECORD_MAX];
+	uint8_t encoded[DLOG_ENCODED_MAX];
+
+	if((dlogSink == 0) || (count > DLOG_MAX_ARGUMENTS))
+	{
+		return;
+	}
+
+	/* The IDs are offsets in .logstr, which starts at address 0, so 2 bytes are enough for 64 KB of format strings */
+	record[0] = (uint8_t) id;
+	record[1] = (uint8_t) (id >> 8);
+
+	uint32_t length = 2U;
+
+	for(uint32_t i = 0; i < count; i++)
+	{
+		record[length++] = (uint8_t) arguments[i];
+		record[length++] = (uint8_t) (arguments[i] >> 8);
+		record[length++] = (uint8_t) (arguments[i] >> 16);
+		record[length++] = (uint8_t) (arguments[i] >> 24);
+	}
+
+	uint32_t encodedLength = cobs_encode(record, length, encoded);
+	encoded[encodedLength++] = 0x00; // the delimiter
+
+	dlogSink((const char *) encoded, (int) encodedLength);
+}
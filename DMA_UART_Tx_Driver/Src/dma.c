@@ -0,0 +1,838 @@
+/*
+ * dma.c
+ *
+ *  Created on: 17 Oct 2026
+ *  Author: George Calin
+ *  Target Development Board: STM32 Nucleo F429ZI
+ */
+
+/* ******************************************************************************************************************************************************************
+ * One driver for the 16 streams of DMA1 and DMA2. Instead of a copy of dma1_stream3_init() for every new user (with the stream, the channel and the
+ * bits of DMA_LIFCR hard coded) the user asks for a peripheral request, for example DMA_REQUEST_USART3_TX, and dma_stream_open() looks it up in
+ * dma_request_table, which is the request mapping of RM0090. Many requests can be served by two streams: the first one that is still free is taken.
+ * The flags of the 4 streams 0..3 share DMA_LISR/DMA_LIFCR and those of 4..7 share DMA_HISR/DMA_HIFCR, 6 bits apart with a gap in the middle
+ * (offsets 0, 6, 16, 22). dma_stream_hw_table keeps the register and the offset of every stream, and the flags are always handed to the caller at the
+ * positions of stream 0 (DMA_FLAG_...), so no caller needs to know the offsets.
+ * The interrupt of every stream ends in dma_irq_handler(), which clears the flags, recovers from the errors (dma_stream_handle_errors()) and calls
+ * the callbacks of the handle (dma_stream_set_callback(), dma_stream_set_half_callback(), dma_stream_set_error_callback()).
+ * All 16 vectors are defined here, the USART3 receiver and transmitter of uart.c included: whichever stream a request is given, its owner is reached
+ * through the callbacks of the handle.
+ * ******************************************************************************************************************************************************************
+ */
+
+#include "dma.h"
+
+#define RCC_AHB1ENR__DMA1EN (1UL<<21)
+#define RCC_AHB1ENR__DMA2EN (1UL<<22)
+
+#define DMA_SxCR__EN (1UL<<0)
+#define DMA_SxCR__DIR_SHIFT (6U)
+#define DMA_SxCR__CIRC (1UL<<8)
+#define DMA_SxCR__PINC (1UL<<9)
+#define DMA_SxCR__MINC (1UL<<10)
+#define DMA_SxCR__PSIZE_SHIFT (11U)
+#define DMA_SxCR__MSIZE_SHIFT (13U)
+#define DMA_SxCR__PL_SHIFT (16U)
+#define DMA_SxCR__PBURST_SHIFT (21U)
+#define DMA_SxCR__MBURST_SHIFT (23U)
+#define DMA_SxCR__CHSEL_SHIFT (25U)
+#define DMA_SxCR__PSIZE_MASK (3UL<<11)
+#define DMA_SxCR__MSIZE_MASK (3UL<<13)
+#define DMA_SxCR__MBURST_MASK (3UL<<23)
+#define DMA_SxCR__INTERRUPTS (DMA_INTERRUPT_DME | DMA_INTERRUPT_TE | DMA_INTERRUPT_HT | DMA_INTERRUPT_TC)
+#define DMA_SxFCR__FTH_SHIFT (0U)
+#define DMA_SxFCR__DMDIS (1UL<<2)
+#define DMA_SxFCR__FEIE (1UL<<7)
+
+#define DMA_FIFO_BYTES (16U)
+
+#define DMA_QUEUE_MASK (DMA_QUEUE_SIZE - 1U)
+
+typedef struct
+{
+	dma_request_t request;
+	uint8_t controller;		// 1 or 2
+	uint8_t stream;
+	uint8_t channel;
+} dma_request_map_t;
+
+/* Info taken from RM0090: DMA1 request mapping and DMA2 request mapping (stream on the columns, channel on the rows).
+ * When a request appears twice the first line is the one taken while its stream is free */
+static const dma_request_map_t dma_request_table[] =
+{
+	{DMA_REQUEST_USART1_RX, 2, 2, 4},
+	{DMA_REQUEST_USART1_RX, 2, 5, 4},
+	{DMA_REQUEST_USART1_TX, 2, 7, 4},
+	{DMA_REQUEST_USART2_RX, 1, 5, 4},
+	{DMA_REQUEST_USART2_TX, 1, 6, 4},
+	{DMA_REQUEST_USART3_RX, 1, 1, 4},
+	{DMA_REQUEST_USART3_TX, 1, 3, 4},
+	{DMA_REQUEST_USART3_TX, 1, 4, 7},
+	{DMA_REQUEST_UART4_RX,  1, 2, 4},
+	{DMA_REQUEST_UART4_TX,  1, 4, 4},
+	{DMA_REQUEST_UART5_RX,  1, 0, 4},
+	{DMA_REQUEST_UART5_TX,  1, 7, 4},
+	{DMA_REQUEST_USART6_RX, 2, 1, 5},
+	{DMA_REQUEST_USART6_RX, 2, 2, 5},
+	{DMA_REQUEST_USART6_TX, 2, 6, 5},
+	{DMA_REQUEST_USART6_TX, 2, 7, 5},
+	{DMA_REQUEST_UART7_RX,  1, 3, 5},
+	{DMA_REQUEST_UART7_TX,  1, 1, 5},
+	{DMA_REQUEST_UART8_RX,  1, 6, 5},
+	{DMA_REQUEST_UART8_TX,  1, 0, 5},
+	{DMA_REQUEST_SPI1_RX,   2, 0, 3},
+	{DMA_REQUEST_SPI1_RX,   2, 2, 3},
+	{DMA_REQUEST_SPI1_TX,   2, 3, 3},
+	{DMA_REQUEST_SPI1_TX,   2, 5, 3},
+	{DMA_REQUEST_SPI2_RX,   1, 3, 0},
+	{DMA_REQUEST_SPI2_TX,   1, 4, 0},
+	{DMA_REQUEST_SPI3_RX,   1, 0, 0},
+	{DMA_REQUEST_SPI3_RX,   1, 2, 0},
+	{DMA_REQUEST_SPI3_TX,   1, 5, 0},
+	{DMA_REQUEST_SPI3_TX,   1, 7, 0},
+	{DMA_REQUEST_SPI4_RX,   2, 0, 4},
+	{DMA_REQUEST_SPI4_RX,   2, 3, 5},
+	{DMA_REQUEST_SPI4_TX,   2, 1, 4},
+	{DMA_REQUEST_SPI4_TX,   2, 4, 5},
+	{DMA_REQUEST_SPI5_RX,   2, 3, 2},
+	{DMA_REQUEST_SPI5_RX,   2, 5, 7},
+	{DMA_REQUEST_SPI5_TX,   2, 4, 2},
+	{DMA_REQUEST_SPI5_TX,   2, 6, 7},
+	{DMA_REQUEST_SPI6_RX,   2, 6, 1},
+	{DMA_REQUEST_SPI6_TX,   2, 5, 1},
+	{DMA_REQUEST_I2C1_RX,   1, 0, 1},
+	{DMA_REQUEST_I2C1_RX,   1, 5, 1},
+	{DMA_REQUEST_I2C1_TX,   1, 6, 1},
+	{DMA_REQUEST_I2C1_TX,   1, 7, 1},
+	{DMA_REQUEST_I2C2_RX,   1, 2, 7},
+	{DMA_REQUEST_I2C2_RX,   1, 3, 7},
+	{DMA_REQUEST_I2C2_TX,   1, 7, 7},
+	{DMA_REQUEST_I2C3_RX,   1, 2, 3},
+	{DMA_REQUEST_I2C3_TX,   1, 4, 3},
+	{DMA_REQUEST_ADC1,      2, 0, 0},
+	{DMA_REQUEST_ADC1,      2, 4, 0},
+	{DMA_REQUEST_ADC2,      2, 2, 1},
+	{DMA_REQUEST_ADC2,      2, 3, 1},
+	{DMA_REQUEST_ADC3,      2, 0, 2},
+	{DMA_REQUEST_ADC3,      2, 1, 2},
+	{DMA_REQUEST_DAC1,      1, 5, 7},
+	{DMA_REQUEST_DAC2,      1, 6, 7},
+	{DMA_REQUEST_TIM2_UP,   1, 1, 3},
+	{DMA_REQUEST_TIM2_UP,   1, 7, 3},
+	{DMA_REQUEST_SDIO,      2, 3, 4},
+	{DMA_REQUEST_SDIO,      2, 6, 4},
+	/* Only DMA2 can copy memory to memory, the channel is not used. The streams that serve the fewest peripherals come first */
+	{DMA_REQUEST_MEMORY,    2, 4, 0},
+	{DMA_REQUEST_MEMORY,    2, 1, 0},
+	{DMA_REQUEST_MEMORY,    2, 6, 0},
+	{DMA_REQUEST_MEMORY,    2, 7, 0},
+	{DMA_REQUEST_MEMORY,    2, 3, 0},
+	{DMA_REQUEST_MEMORY,    2, 5, 0},
+	{DMA_REQUEST_MEMORY,    2, 2, 0},
+	{DMA_REQUEST_MEMORY,    2, 0, 0},
+};
+
+#define DMA_REQUEST_TABLE_SIZE (sizeof(dma_request_table) / sizeof(dma_request_table[0]))
+
+/* Info taken from RM0090: DMA register map, and the vector table in Startup > startup_stm32f429zitx.s (the IRQ numbers of the streams are not contiguous) */
+static const dma_stream_hw_t dma_stream_hw_table[2][DMA_STREAM_COUNT] =
+{
+	{
+		{DMA1, DMA1_Stream0, 0, DMA1_Stream0_IRQn, RCC_AHB1ENR__DMA1EN, &DMA1->LISR, &DMA1->LIFCR, 0},
+		{DMA1, DMA1_Stream1, 1, DMA1_Stream1_IRQn, RCC_AHB1ENR__DMA1EN, &DMA1->LISR, &DMA1->LIFCR, 6},
+		{DMA1, DMA1_Stream2, 2, DMA1_Stream2_IRQn, RCC_AHB1ENR__DMA1EN, &DMA1->LISR, &DMA1->LIFCR, 16},
+		{DMA1, DMA1_Stream3, 3, DMA1_Stream3_IRQn, RCC_AHB1ENR__DMA1EN, &DMA1->LISR, &DMA1->LIFCR, 22},
+		{DMA1, DMA1_Stream4, 4, DMA1_Stream4_IRQn, RCC_AHB1ENR__DMA1EN, &DMA1->HISR, &DMA1->HIFCR, 0},
+		{DMA1, DMA1_Stream5, 5, DMA1_Stream5_IRQn, RCC_AHB1ENR__DMA1EN, &DMA1->HISR, &DMA1->HIFCR, 6},
+		{DMA1, DMA1_Stream6, 6, DMA1_Stream6_IRQn, RCC_AHB1ENR__DMA1EN, &DMA1->HISR, &DMA1->HIFCR, 16},
+		{DMA1, DMA1_Stream7, 7, DMA1_Stream7_IRQn, RCC_AHB1ENR__DMA1EN, &DMA1->HISR, &DMA1->HIFCR, 22},
+	},
+	{
+		{DMA2, DMA2_Stream0, 0, DMA2_Stream0_IRQn, RCC_AHB1ENR__DMA2EN, &DMA2->LISR, &DMA2->LIFCR, 0},
+		{DMA2, DMA2_Stream1, 1, DMA2_Stream1_IRQn, RCC_AHB1ENR__DMA2EN, &DMA2->LISR, &DMA2->LIFCR, 6},
+		{DMA2, DMA2_Stream2, 2, DMA2_Stream2_IRQn, RCC_AHB1ENR__DMA2EN, &DMA2->LISR, &DMA2->LIFCR, 16},
+		{DMA2, DMA2_Stream3, 3, DMA2_Stream3_IRQn, RCC_AHB1ENR__DMA2EN, &DMA2->LISR, &DMA2->LIFCR, 22},
+		{DMA2, DMA2_Stream4, 4, DMA2_Stream4_IRQn, RCC_AHB1ENR__DMA2EN, &DMA2->HISR, &DMA2->HIFCR, 0},
+		{DMA2, DMA2_Stream5, 5, DMA2_Stream5_IRQn, RCC_AHB1ENR__DMA2EN, &DMA2->HISR, &DMA2->HIFCR, 6},
+		{DMA2, DMA2_Stream6, 6, DMA2_Stream6_IRQn, RCC_AHB1ENR__DMA2EN, &DMA2->HISR, &DMA2->HIFCR, 16},
+		{DMA2, DMA2_Stream7, 7, DMA2_Stream7_IRQn, RCC_AHB1ENR__DMA2EN, &DMA2->HISR, &DMA2->HIFCR, 22},
+	},
+};
+
+static dma_handle_t dma_handles[2][DMA_STREAM_COUNT];
+
+/* Beats of DMA_BURST_SINGLE, INCR4, INCR8, INCR16 */
+static const uint8_t dma_burst_beats[4] = {1, 4, 8, 16};
+
+static void dma_queue_start_next(dma_handle_t *handle);
+static void dma_stream_call_halves(dma_handle_t *handle, uint32_t flags);
+static uint32_t dma_stream_fit_memory_side(dma_handle_t *handle, uint32_t cr, uint32_t memoryAddress, uint32_t length);
+
+/* Returns the handle, or 0 if the request has no free stream left. Opening a request that is already open gives back the same stream with the new
+ * configuration, so the users can initialize again without losing their stream and its statistics (the callbacks have to be registered again).
+ * DMA_REQUEST_MEMORY is the exception: every open takes one more free stream of DMA2, with its statistics cleared.
+ * The stream is configured but not started, dma_stream_start() hands it the memory address and the length */
+dma_handle_t *dma_stream_open(dma_request_t request, const dma_config_t *config, uint32_t peripheralAddress)
+{
+	dma_handle_t *handle = 0;
+	const dma_request_map_t *map = 0;
+
+	/* The stream the request already holds comes first, even if an earlier entry of the table is free: otherwise one request could end up with two streams */
+	for(uint32_t i = 0; (i < DMA_REQUEST_TABLE_SIZE) && (handle == 0) && (request != DMA_REQUEST_MEMORY); i++)
+	{
+		dma_handle_t *candidate = &dma_handles[dma_request_table[i].controller - 1U][dma_request_table[i].stream];
+
+		if((dma_request_table[i].request == request) && candidate->opened && (candidate->request == request))
+		{
+			handle = candidate;
+			map = &dma_request_table[i];
+		}
+	}
+
+	uint32_t reopened = (handle != 0) ? 1U : 0U;
+
+	for(uint32_t i = 0; (i < DMA_REQUEST_TABLE_SIZE) && (handle == 0); i++)
+	{
+		dma_handle_t *candidate = &dma_handles[dma_request_table[i].controller - 1U][dma_request_table[i].stream];
+
+		if((dma_request_table[i].request == request) && !candidate->opened)
+		{
+			handle = candidate;
+			map = &dma_request_table[i];
+		}
+	}
+
+	if(handle == 0)
+	{
+		return 0;
+	}
+
+	handle->hw = &dma_stream_hw_table[map->controller - 1U][map->stream];
+	handle->request = request;
+	handle->channel = map->channel;
+	handle->callback = 0;
+	handle->context = 0;
+	handle->halfCallback = 0;
+	handle->halfContext = 0;
+	handle->errorCallback = 0;
+	handle->errorContext = 0;
+
+	/* A stream taken by a new owner starts counting from 0, the statistics of the previous owner are not its own */
+	if(!reopened)
+	{
+		handle->queueStats = (dma_queue_stats_t) {0};
+		handle->busStats = (dma_bus_stats_t) {0};
+		handle->errorStats = (dma_error_stats_t) {0};
+	}
+
+	/* Enable clock access to the controller, both sit on AHB1 */
+	RCC->AHB1ENR |= handle->hw->clockEnableBit;
+
+	if(dma_stream_configure(handle, config, peripheralAddress) != 0)
+	{
+		handle->opened = 0;
+		return 0;
+	}
+
+	handle->opened = 1;
+
+	return handle;
+}
+
+/* ******************************************************************************************************************************************************************
+ * Explanation: Info taken from RM0090: DMA stream x configuration register (DMA_SxCR) (x = 0..7)
+ * 		Bits 27:25 CHSEL: channel selection, the request that drives the stream
+ * 		Bits 24:23 MBURST and 22:21 PBURST: memory and peripheral burst (00 single, 01 INCR4, 10 INCR8, 11 INCR16)
+ * 		Bits 17:16 PL: priority level. Bits 14:13 MSIZE and 12:11 PSIZE: memory and peripheral data size (00 byte, 01 half word, 10 word)
+ * 		Bit 10 MINC, bit 9 PINC: memory and peripheral increment. Bit 8 CIRC: circular mode. Bits 7:6 DIR: direction
+ * 		Bits 4:1 TCIE, HTIE, TEIE, DMEIE: interrupt enables
+ * 		All of them are protected and can be written only while EN is '0'.
+ * Info taken from RM0090: DMA stream x FIFO control register (DMA_SxFCR): bit 7 FEIE, FIFO error interrupt enable; bit 2 DMDIS, direct mode disable;
+ * bits 1:0 FTH, FIFO threshold.
+ * In direct mode every item the peripheral asks for is one access on each side: the hardware takes MSIZE = PSIZE and single transfers.
+ * Through the FIFO (4 words) the two sides are decoupled: an 8 bit peripheral can be fed from 32 bit reads of the memory (packing), and the memory port
+ * can move a whole burst of 4, 8 or 16 beats for one request of the bus matrix. In memory to memory mode the direct mode is not allowed and the FIFO is forced.
+ * Info taken from RM0090: FIFO threshold configurations. A memory burst (beats * MSIZE) has to fit the threshold an exact number of times,
+ * the configurations that break this rule are refused here because the hardware would stop the stream with a FIFO error. A peripheral burst must fit the FIFO.
+ * Returns 0, or -1 if the configuration is not allowed: the stream stays stopped.
+ * It configures the stream again without looking up the request, for example between two memory to memory copies.
+ * ******************************************************************************************************************************************************************
+ */
+int dma_stream_configure(dma_handle_t *handle, const dma_config_t *config, uint32_t peripheralAddress)
+{
+	DMA_Stream_TypeDef *stream = handle->hw->stream;
+	uint32_t fifoMode = (config->fifoMode || (config->direction == DMA_MEMORY_TO_MEMORY)) ? 1U : 0U;
+
+	dma_stream_stop(handle);
+	dma_stream_clear_flags(handle, DMA_FLAG_ALL);
+
+	/* Whatever was queued for the old configuration is dropped, and there is no buffer to recover yet */
+	handle->queueHead = handle->queueTail;
+	handle->queueRunning = 0;
+	handle->length = 0;
+	handle->recoveryFailures = 0;
+
+	if(fifoMode)
+	{
+		uint32_t thresholdBytes = ((uint32_t) config->fifoThreshold + 1U) * 4U;
+		uint32_t memoryBurstBytes = dma_burst_beats[config->memoryBurst] * (1U << config->memoryWidth);
+		uint32_t peripheralBurstBytes = dma_burst_beats[config->peripheralBurst] * (1U << config->peripheralWidth);
+
+		if(((thresholdBytes % memoryBurstBytes) != 0) || (peripheralBurstBytes > DMA_FIFO_BYTES))
+		{
+			return -1;
+		}
+	}
+	else if((config->memoryWidth != config->peripheralWidth) || (config->memoryBurst != DMA_BURST_SINGLE) || (config->peripheralBurst != DMA_BURST_SINGLE))
+	{
+		/* Packing and bursts need the FIFO */
+		return -1;
+	}
+
+	handle->peripheralAddress = peripheralAddress;
+	stream->PAR = peripheralAddress;
+	stream->NDTR = 0;
+
+	uint32_t cr = ((uint32_t) handle->channel << DMA_SxCR__CHSEL_SHIFT)
+				| ((uint32_t) config->memoryBurst << DMA_SxCR__MBURST_SHIFT)
+				| ((uint32_t) config->peripheralBurst << DMA_SxCR__PBURST_SHIFT)
+				| ((uint32_t) config->priority << DMA_SxCR__PL_SHIFT)
+				| ((uint32_t) config->memoryWidth << DMA_SxCR__MSIZE_SHIFT)
+				| ((uint32_t) config->peripheralWidth << DMA_SxCR__PSIZE_SHIFT)
+				| ((uint32_t) config->direction << DMA_SxCR__DIR_SHIFT)
+				| (config->interrupts & DMA_SxCR__INTERRUPTS);
+
+	if(config->memoryIncrement)
+	{
+		cr |= DMA_SxCR__MINC;
+	}
+
+	if(config->peripheralIncrement)
+	{
+		cr |= DMA_SxCR__PINC;
+	}
+
+	if(config->circular && (config->direction != DMA_MEMORY_TO_MEMORY))
+	{
+		cr |= DMA_SxCR__CIRC;
+	}
+
+	handle->cr = cr;
+	stream->CR = cr;
+
+	if(fifoMode)
+	{
+		stream->FCR = DMA_SxFCR__DMDIS | ((uint32_t) config->fifoThreshold << DMA_SxFCR__FTH_SHIFT) | (config->interrupts & DMA_SxFCR__FEIE);
+	}
+	else
+	{
+		/* Direct mode, no FIFO */
+		stream->FCR = 0x0;
+	}
+
+	if(config->interrupts != 0)
+	{
+		NVIC_EnableIRQ(handle->hw->irq);
+	}
+	else
+	{
+		NVIC_DisableIRQ(handle->hw->irq);
+	}
+
+	return 0;
+}
+
+/* The callback runs in the interrupt of the stream, see dma_irq_handler(). Only the interrupts enabled in dma_config_t call it */
+void dma_stream_set_callback(dma_handle_t *handle, dma_callback_t callback, void *context)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	handle->callback = callback;
+	handle->context = context;
+
+	__set_PRIMASK(primask);
+}
+
+void dma_stream_close(dma_handle_t *handle)
+{
+	NVIC_DisableIRQ(handle->hw->irq);
+	dma_stream_flush(handle);
+	dma_stream_clear_flags(handle, DMA_FLAG_ALL);
+	handle->hw->stream->CR = 0;
+	handle->opened = 0;
+}
+
+/* Re-arm the stream for a new transfer of length items (of the size of the peripheral). The rest of the configuration stays as dma_stream_open() set it */
+void dma_stream_start(dma_handle_t *handle, uint32_t memoryAddress, uint32_t length)
+{
+	DMA_Stream_TypeDef *stream = handle->hw->stream;
+
+	dma_stream_stop(handle);
+
+	/* The stream cannot be enabled while any of its flags is set */
+	dma_stream_clear_flags(handle, DMA_FLAG_ALL);
+
+	if(stream->FCR & DMA_SxFCR__DMDIS)
+	{
+		/* Through the FIFO the memory width and burst may change from one transfer to the next, they are protected bits as well */
+		stream->CR = dma_stream_fit_memory_side(handle, handle->cr, memoryAddress, length);
+	}
+	else
+	{
+		handle->busStats.transfers++;
+		handle->busStats.peripheralAccesses += length;
+		handle->busStats.memoryAccesses += length;
+		handle->busStats.memoryBursts += length;
+	}
+
+	handle->memoryAddress = memoryAddress;
+	handle->length = length;
+
+	stream->M0AR = memoryAddress;
+	stream->NDTR = length;
+
+	stream->CR |= DMA_SxCR__EN;
+}
+
+/* Disable the stream and wait until it is really stopped: EN reads '1' until the transfer of the current item is over */
+void dma_stream_stop(dma_handle_t *handle)
+{
+	DMA_Stream_TypeDef *stream = handle->hw->stream;
+
+	stream->CR &=~DMA_SxCR__EN;
+	while(stream->CR & DMA_SxCR__EN);
+}
+
+/* At the end of a transfer (not in circular mode) the hardware clears EN by itself */
+uint32_t dma_stream_busy(dma_handle_t *handle)
+{
+	return (handle->hw->stream->CR & DMA_SxCR__EN) ? 1U : 0U;
+}
+
+/* Items still to transfer (DMA_SxNDTR) */
+uint32_t dma_stream_remaining(dma_handle_t *handle)
+{
+	return handle->hw->stream->NDTR;
+}
+
+/* Info taken from RM0090: DMA low/high interrupt status register (DMA_LISR/DMA_HISR). Returns DMA_FLAG_..., moved to the positions of stream 0 */
+uint32_t dma_stream_get_flags(dma_handle_t *handle)
+{
+	return (*handle->hw->flagRegister >> handle->hw->flagShift) & DMA_FLAG_ALL;
+}
+
+/* Info taken from RM0090: DMA low/high interrupt flag clear register (DMA_LIFCR/DMA_HIFCR). Writing '1' clears a flag, '0' changes nothing,
+ * so the flags of the other streams in the same register are safe */
+void dma_stream_clear_flags(dma_handle_t *handle, uint32_t flags)
+{
+	*handle->hw->clearRegister = (flags & DMA_FLAG_ALL) << handle->hw->flagShift;
+}
+
+void dma_stream_get_bus_stats(dma_handle_t *handle, dma_bus_stats_t *stats)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	*stats = handle->busStats;
+
+	__set_PRIMASK(primask);
+}
+
+/* ******************************************************************************************************************************************************************
+ * Explanation: Info taken from RM0090: the memory address has to be aligned on MSIZE, NDTR * PSIZE has to be a whole number of memory items
+ * and, with a memory burst, of bursts. A burst must not cross a 1 KB boundary, which never happens when the address is aligned on the size of the burst.
+ * A UART chunk can start anywhere in its buffer, so instead of refusing such a transfer the memory side steps down for it alone:
+ * first to single transfers of MSIZE, then to MSIZE = PSIZE, which is always allowed. Returns the DMA_SxCR to use and counts the accesses of the memory port.
+ * ******************************************************************************************************************************************************************
+ */
+static uint32_t dma_stream_fit_memory_side(dma_handle_t *handle, uint32_t cr, uint32_t memoryAddress, uint32_t length)
+{
+	uint32_t peripheralBytes = 1U << ((cr & DMA_SxCR__PSIZE_MASK) >> DMA_SxCR__PSIZE_SHIFT);
+	uint32_t memoryBytes = 1U << ((cr & DMA_SxCR__MSIZE_MASK) >> DMA_SxCR__MSIZE_SHIFT);
+	uint32_t beats = dma_burst_beats[(cr & DMA_SxCR__MBURST_MASK) >> DMA_SxCR__MBURST_SHIFT];
+	uint32_t bytes = length * peripheralBytes;
+
+	if(((memoryAddress % (memoryBytes * beats)) != 0) || ((bytes % (memoryBytes * beats)) != 0))
+	{
+		cr &=~DMA_SxCR__MBURST_MASK;
+		beats = 1U;
+
+		if(((memoryAddress % memoryBytes) != 0) || ((bytes % memoryBytes) != 0))
+		{
+			cr = (cr & ~DMA_SxCR__MSIZE_MASK) | (((cr & DMA_SxCR__PSIZE_MASK) >> DMA_SxCR__PSIZE_SHIFT) << DMA_SxCR__MSIZE_SHIFT);
+			memoryBytes = peripheralBytes;
+		}
+
+		handle->busStats.unpackedTransfers++;
+	}
+
+	handle->busStats.transfers++;
+	handle->busStats.peripheralAccesses += length;
+	handle->busStats.memoryAccesses += bytes / memoryBytes;
+	handle->busStats.memoryBursts += bytes / (memoryBytes * beats);
+
+	return cr;
+}
+
+/* *** TRANSFER QUEUE *** */
+/* ******************************************************************************************************************************************************************
+ * Explanation: dma_stream_start() on a stream that is still running stops it in the middle of the transfer. The queue lets any context hand over
+ * the next transfer at any time instead: dma_stream_submit() copies the descriptor into the queue of the stream (DMA_QUEUE_SIZE entries) and starts it
+ * right away only if the stream is idle. At the end of every transfer dma_irq_handler() programs the next descriptor first and only then calls the callback
+ * of the one that completed, like uart3_dma_tx_callback() does in uart.c with the staging buffer, so the peripheral waits only for the few register writes
+ * in between and never for the application.
+ * The queue needs the TC interrupt and the stream must not be circular.
+ * ******************************************************************************************************************************************************************
+ */
+/* Returns 0 once the transfer is queued, or -1 if the queue is full, the length is out of range or the stream cannot chain */
+int dma_stream_submit(dma_handle_t *handle, const dma_transfer_t *transfer)
+{
+	DMA_Stream_TypeDef *stream = handle->hw->stream;
+
+	if(!handle->opened || (transfer->length == 0) || (transfer->length > DMA_MAX_ITEMS))
+	{
+		return -1;
+	}
+
+	if(!(stream->CR & DMA_INTERRUPT_TC) || (stream->CR & DMA_SxCR__CIRC))
+	{
+		return -1;
+	}
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	uint32_t queued = handle->queueHead - handle->queueTail;
+
+	if(queued >= DMA_QUEUE_SIZE)
+	{
+		handle->queueStats.rejected++;
+		__set_PRIMASK(primask);
+		return -1;
+	}
+
+	handle->queue[handle->queueHead & DMA_QUEUE_MASK] = *transfer;
+	handle->queueHead++;
+	handle->queueStats.submitted++;
+
+	if((queued + 1U) > handle->queueStats.highWater)
+	{
+		handle->queueStats.highWater = queued + 1U;
+	}
+
+	if(!handle->queueRunning)
+	{
+		dma_queue_start_next(handle);
+	}
+
+	__set_PRIMASK(primask);
+
+	return 0;
+}
+
+/* Transfers still waiting, the running one included */
+uint32_t dma_stream_queued(dma_handle_t *handle)
+{
+	return handle->queueHead - handle->queueTail;
+}
+
+/* Stops the stream and drops the queue. The callbacks of the dropped transfers are not called */
+void dma_stream_flush(dma_handle_t *handle)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	dma_stream_stop(handle);
+	dma_stream_clear_flags(handle, DMA_FLAG_ALL);
+	handle->queueTail = handle->queueHead;
+	handle->queueRunning = 0;
+
+	__set_PRIMASK(primask);
+}
+
+void dma_stream_get_queue_stats(dma_handle_t *handle, dma_queue_stats_t *stats)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	*stats = handle->queueStats;
+
+	__set_PRIMASK(primask);
+}
+
+/* Has to be called with the interrupts disabled, or from the interrupt of the stream, and with the stream idle */
+static void dma_queue_start_next(dma_handle_t *handle)
+{
+	if(handle->queueTail == handle->queueHead)
+	{
+		handle->queueRunning = 0;
+		return;
+	}
+
+	const dma_transfer_t *transfer = &handle->queue[handle->queueTail & DMA_QUEUE_MASK];
+
+	handle->hw->stream->PAR = (transfer->peripheralAddress != 0) ? transfer->peripheralAddress : handle->peripheralAddress;
+	handle->queueRunning = 1;
+
+	dma_stream_start(handle, transfer->memoryAddress, transfer->length);
+}
+
+/* *** HALF TRANSFER AND ERROR CALLBACKS *** */
+/* ******************************************************************************************************************************************************************
+ * Explanation: Info taken from RM0090: DMA interrupt status registers and "Error management"
+ * 		HTIF: half of NDTR has been transferred. With TCIF it splits a circular buffer in two: the CPU works on one half while the DMA fills the other one.
+ * 		TEIF: a bus error on an address the stream accessed (for example a buffer in the CCM RAM). The hardware clears EN, the stream stops.
+ * 		DMEIF: direct mode error, a new request arrived before the previous item had been moved. The stream may have been stopped as well.
+ * 		FEIF: FIFO overrun or underrun, or a burst the FIFO threshold cannot serve. Data may be lost or repeated, the stream goes on.
+ * Before, these flags were cleared once at the start and then ignored, so a single bus error stopped an ADC capture or a UART receiver for good.
+ * dma_stream_handle_errors() counts them and starts a circular stream that was stopped again from the beginning of its buffer, at most DMA_RECOVERY_LIMIT
+ * times in a row: an address that is really wrong would otherwise keep the CPU in the interrupt. Any HT or TC in between means the stream worked again.
+ * A one shot transfer is never started again (a UART would send its characters twice), the error callback and the queue (DMA_FLAG_TE) tell its owner.
+ * ******************************************************************************************************************************************************************
+ */
+void dma_stream_set_half_callback(dma_handle_t *handle, dma_half_callback_t callback, void *context)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	handle->halfCallback = callback;
+	handle->halfContext = context;
+
+	__set_PRIMASK(primask);
+}
+
+/* The callback gets the error flags (DMA_FLAG_ERRORS) plus DMA_EVENT_RECOVERED or DMA_EVENT_ABANDONED. DMA_INTERRUPT_TE, DME and FE have to be enabled */
+void dma_stream_set_error_callback(dma_handle_t *handle, dma_callback_t callback, void *context)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	handle->errorCallback = callback;
+	handle->errorContext = context;
+
+	__set_PRIMASK(primask);
+}
+
+/* Called from dma_irq_handler() with the flags it has just read and cleared, before the other callbacks. Returns the error flags with the DMA_EVENT_... of the recovery, 0 if there was no error */
+uint32_t dma_stream_handle_errors(dma_handle_t *handle, uint32_t flags)
+{
+	uint32_t errors = flags & DMA_FLAG_ERRORS;
+
+	if(errors == 0)
+	{
+		if(flags & (DMA_FLAG_HT | DMA_FLAG_TC))
+		{
+			handle->recoveryFailures = 0;
+		}
+
+		return 0;
+	}
+
+	if(errors & DMA_FLAG_TE)
+	{
+		handle->errorStats.transferErrors++;
+	}
+
+	if(errors & DMA_FLAG_DME)
+	{
+		handle->errorStats.directModeErrors++;
+	}
+
+	if(errors & DMA_FLAG_FE)
+	{
+		handle->errorStats.fifoErrors++;
+	}
+
+	DMA_Stream_TypeDef *stream = handle->hw->stream;
+
+	if(!(stream->CR & DMA_SxCR__EN) && (handle->cr & DMA_SxCR__CIRC) && (handle->length != 0))
+	{
+		if(handle->recoveryFailures < DMA_RECOVERY_LIMIT)
+		{
+			handle->recoveryFailures++;
+			handle->errorStats.recoveries++;
+			dma_stream_start(handle, handle->memoryAddress, handle->length);
+			errors |= DMA_EVENT_RECOVERED;
+		}
+		else
+		{
+			handle->errorStats.abandoned++;
+			errors |= DMA_EVENT_ABANDONED;
+		}
+	}
+
+	if(handle->errorCallback != 0)
+	{
+		handle->errorCallback(handle, errors, handle->errorContext);
+	}
+
+	return errors;
+}
+
+void dma_stream_get_error_stats(dma_handle_t *handle, dma_error_stats_t *stats)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	*stats = handle->errorStats;
+
+	__set_PRIMASK(primask);
+}
+
+/* Hands the halves of the last dma_stream_start() to the half callback. HT counts only if its interrupt is enabled,
+ * otherwise the flag set in the middle of the transfer would be seen only together with TC */
+static void dma_stream_call_halves(dma_handle_t *handle, uint32_t flags)
+{
+	if((handle->halfCallback == 0) || (handle->length == 0))
+	{
+		return;
+	}
+
+	uint32_t bytes = handle->length << ((handle->cr & DMA_SxCR__PSIZE_MASK) >> DMA_SxCR__PSIZE_SHIFT);
+	uint32_t firstHalf = bytes / 2U;
+
+	if((flags & DMA_FLAG_HT) && (handle->cr & DMA_INTERRUPT_HT))
+	{
+		handle->halfCallback(handle->memoryAddress, firstHalf, handle->halfContext);
+	}
+
+	if(flags & DMA_FLAG_TC)
+	{
+		handle->halfCallback(handle->memoryAddress + firstHalf, bytes - firstHalf, handle->halfContext);
+	}
+}
+
+/* Called from the interrupt of the stream: clears the flags that were set, starts a stopped circular stream again, chains the next queued transfer
+ * and hands the flags to the callbacks */
+void dma_irq_handler(uint32_t controller, uint32_t stream)
+{
+	dma_handle_t *handle = &dma_handles[controller - 1U][stream];
+
+	if(!handle->opened)
+	{
+		return;
+	}
+
+	uint32_t flags = dma_stream_get_flags(handle);
+	dma_stream_clear_flags(handle, flags);
+
+	/* The recovery first, the stream is idle until it runs again */
+	uint32_t errors = dma_stream_handle_errors(handle, flags);
+
+	/* After a transfer error the buffer is not complete, the halves are not handed over */
+	if(!(errors & DMA_FLAG_TE) && !handle->queueRunning)
+	{
+		dma_stream_call_halves(handle, flags);
+	}
+
+	/* TC, or TE: on a transfer error the hardware has already disabled the stream */
+	if(handle->queueRunning && (flags & (DMA_FLAG_TC | DMA_FLAG_TE)))
+	{
+		dma_transfer_t done = handle->queue[handle->queueTail & DMA_QUEUE_MASK];
+		handle->queueTail++;
+
+		if(flags & DMA_FLAG_TE)
+		{
+			handle->queueStats.errors++;
+		}
+		else
+		{
+			handle->queueStats.completed++;
+		}
+
+		/* The next transfer first, the peripheral does not wait for the callbacks */
+		dma_queue_start_next(handle);
+
+		if(done.callback != 0)
+		{
+			done.callback(flags & (DMA_FLAG_TC | DMA_FLAG_TE), done.context);
+		}
+	}
+
+	if((flags != 0) && (handle->callback != 0))
+	{
+		handle->callback(handle, flags, handle->context);
+	}
+}
+
+/* Interrupt service routines, the names come from the vector table in Startup > startup_stm32f429zitx.s */
+void DMA1_Stream0_IRQHandler(void)
+{
+	dma_irq_handler(1, 0);
+}
+
+void DMA1_Stream1_IRQHandler(void)
+{
+	dma_irq_handler(1, 1);
+}
+
+void DMA1_Stream2_IRQHandler(void)
+{
+	dma_irq_handler(1, 2);
+}
+
+void DMA1_Stream3_IRQHandler(void)
+{
+	dma_irq_handler(1, 3);
+}
+
+void DMA1_Stream4_IRQHandler(void)
+{
+	dma_irq_handler(1, 4);
+}
+
+void DMA1_Stream5_IRQHandler(void)
+{
+	dma_irq_handler(1, 5);
+}
+
+void DMA1_Stream6_IRQHandler(void)
+{
+	dma_irq_handler(1, 6);
+}
+
+void DMA1_Stream7_IRQHandler(void)
+{
+	dma_irq_handler(1, 7);
+}
+
+void DMA2_Stream0_IRQHandler(void)
+{
+	dma_irq_handler(2, 0);
+}
+
+void DMA2_Stream1_IRQHandler(void)
+{
+	dma_irq_handler(2, 1);
+}
+
+void DMA2_Stream2_IRQHandler(void)
+{
+	dma_irq_handler(2, 2);
+}
+
+void DMA2_Stream3_IRQHandler(void)
+{
+	dma_irq_handler(2, 3);
+}
+
+void DMA2_Stream4_IRQHandler(void)
+{
+	dma_irq_handler(2, 4);
+}
+
+void DMA2_Stream5_IRQHandler(void)
+{
+	dma_irq_handler(2, 5);
+}
+
+void DMA2_Stream6_IRQHandler(void)
+{
+	dma_irq_handler(2, 6);
+}
+
+void DMA2_Stream7_IRQHandler(void)
+{
+	dma_irq_handler(2, 7);
+}
@@ -0,0 +1,353 @@
+/*
+ * dma_memory.c
+ *
+ *  Created on: 17 Oct 2026
+ *  Author: George Calin
+ *  Target Development Board: STM32 Nucleo F429ZI
+ */
+
+/* ******************************************************************************************************************************************************************
+ * dma_memcpy() and dma_memset() on a stream of DMA2, the only controller of the F429 that can copy memory to memory. The call returns as soon as the
+ * stream runs and the callback tells when the buffer is written, so the CPU is free for the whole copy.
+ * Explanation: Info taken from RM0090: DMA, memory-to-memory mode
+ * 		- the peripheral port reads the source (DMA_SxPAR) and the memory port writes the destination (DMA_SxM0AR);
+ * 		- the direct mode is not allowed, the data goes through the FIFO of the stream (dma_stream_configure() sets it up for this direction);
+ * 		- NDTR counts items of the peripheral size and is 16 bits wide: longer copies are cut in chunks, the next chunk starts from the TC interrupt;
+ * 		- a burst of 4 words moves 16 bytes in one go, but it must not cross a 1 KB boundary. With both addresses aligned on 16 bytes no burst ever does.
+ * That is why the CPU copies the head, until the destination is aligned as far as the source allows, and the tail that does not fill a whole item or burst.
+ * Source and destination aligned alike on 16 bytes: words in bursts of 4; alike on 4 bytes: single words; on 2 bytes: half words; otherwise bytes.
+ * Starting the stream costs some hundred cycles, for short buffers memcpy()/memset() of the C library are faster: below the threshold
+ * (dma_memory_set_threshold(), DMA_Memcpy_Benchmark measures where the DMA starts winning) and for the CCM RAM, which no DMA can reach,
+ * the CPU does the work and the callback is called before dma_memcpy()/dma_memset() return.
+ * ******************************************************************************************************************************************************************
+ */
+
+#include <string.h>
+#include "dma_memory.h"
+
+#define DMA_MEMORY_MAX_ITEMS (65532U)	// NDTR is 16 bits wide, kept a multiple of the 4 beats of a burst
+
+static dma_handle_t *dmaMemoryStream;
+static volatile uint32_t dmaMemoryBusy;
+static uint32_t dmaMemoryThreshold = DMA_MEMORY_THRESHOLD_DEFAULT;
+static dma_memory_stats_t dmaMemoryStats;
+
+/* The chunks still to copy, moved forward by dma_memory_next_chunk() */
+static uint32_t dmaMemoryDestination;
+static uint32_t dmaMemorySource;
+static uint32_t dmaMemoryRemaining;		// items
+static uint32_t dmaMemoryItemSize;		// bytes
+static uint32_t dmaMemorySourceIncrement;
+static dma_memory_callback_t dmaMemoryCallback;
+static void *dmaMemoryContext;
+
+/* The source of dma_memset(), the stream reads the same word again and again */
+static uint32_t dmaMemoryPattern;
+
+static int dma_memory_claim(void);
+static void dma_memory_start(uint32_t destination, uint32_t source, uint32_t sourceIncrement, uint32_t items, dma_width_t width,
+		dma_burst_t burst, dma_memory_callback_t callback, void *context);
+static void dma_memory_next_chunk(void);
+static void dma_memory_finish(int status);
+static void dma_memory_stream_callback(dma_handle_t *handle, uint32_t flags, void *context);
+static uint32_t dma_memory_reachable(uint32_t address, uint32_t length);
+static void dma_memory_count(uint32_t *counter);
+
+/* Takes one of the streams of DMA2 for the memory copies. Returns -1 if every stream of DMA2 is already in use */
+int dma_memory_init(void)
+{
+	if(dmaMemoryStream != 0)
+	{
+		return 0;
+	}
+
+	dma_config_t config = {DMA_MEMORY_TO_MEMORY, DMA_WIDTH_WORD, DMA_WIDTH_WORD, 1, 1, 0, DMA_PRIORITY_LOW, DMA_INTERRUPT_TE | DMA_INTERRUPT_TC,
+			DMA_BURST_SINGLE, DMA_BURST_SINGLE, 1, DMA_FIFO_THRESHOLD_FULL};
+
+	dmaMemoryStream = dma_stream_open(DMA_REQUEST_MEMORY, &config, 0);
+
+	if(dmaMemoryStream == 0)
+	{
+		return -1;
+	}
+
+	dma_stream_set_callback(dmaMemoryStream, dma_memory_stream_callback, 0);
+	dmaMemoryBusy = 0;
+
+	return 0;
+}
+
+/* ******************************************************************************************************************************************************************
+ * Returns 0 once the copy is started (or done by the CPU), -1 if the previous copy is still running or dma_memory_init() failed.
+ * The buffers must not overlap and must stay valid until the callback, which may be 0 when the caller polls dma_memory_busy()
+ * ******************************************************************************************************************************************************************
+ */
+int dma_memcpy(void *destination, const void *source, uint32_t length, dma_memory_callback_t callback, void *context)
+{
+	uint32_t d = (uint32_t) destination;
+	uint32_t s = (uint32_t) source;
+
+	if((length < dmaMemoryThreshold) || !dma_memory_reachable(d, length) || !dma_memory_reachable(s, length))
+	{
+		memcpy(destination, source, length);
+		dma_memory_count(&dmaMemoryStats.cpuTransfers);
+
+		if(callback != 0)
+		{
+			callback(DMA_MEMORY_OK, context);
+		}
+
+		return 0;
+	}
+
+	if(dma_memory_claim() != 0)
+	{
+		return -1;
+	}
+
+	uint32_t unit;
+	dma_width_t width;
+	dma_burst_t burst = DMA_BURST_SINGLE;
+
+	if(((d ^ s) & 0xFU) == 0)
+	{
+		unit = 16U;
+		width = DMA_WIDTH_WORD;
+		burst = DMA_BURST_INCR4;
+	}
+	else if(((d ^ s) & 0x3U) == 0)
+	{
+		unit = 4U;
+		width = DMA_WIDTH_WORD;
+	}
+	else if(((d ^ s) & 0x1U) == 0)
+	{
+		unit = 2U;
+		width = DMA_WIDTH_HALF_WORD;
+	}
+	else
+	{
+		unit = 1U;
+		width = DMA_WIDTH_BYTE;
+	}
+
+	uint32_t head = (unit - (d & (unit - 1U))) & (unit - 1U);
+
+	if(head > length)
+	{
+		head = length;
+	}
+
+	uint32_t body = ((length - head) / unit) * unit;
+	uint32_t tail = length - head - body;
+
+	/* The CPU writes the two ends now, the DMA never touches them */
+	memcpy(destination, source, head);
+	memcpy((uint8_t *) destination + head + body, (const uint8_t *) source + head + body, tail);
+
+	uint32_t itemSize = (width == DMA_WIDTH_WORD) ? 4U : (width == DMA_WIDTH_HALF_WORD) ? 2U : 1U;
+	dmaMemoryItemSize = itemSize;
+
+	dma_memory_start(d + head, s + head, 1, body / itemSize, width, burst, callback, context);
+
+	return 0;
+}
+
+/* Same rules as dma_memcpy(). The source is one word holding the value four times, so the destination only has to be aligned */
+int dma_memset(void *destination, uint8_t value, uint32_t length, dma_memory_callback_t callback, void *context)
+{
+	uint32_t d = (uint32_t) destination;
+
+	if((length < dmaMemoryThreshold) || !dma_memory_reachable(d, length))
+	{
+		memset(destination, value, length);
+		dma_memory_count(&dmaMemoryStats.cpuTransfers);
+
+		if(callback != 0)
+		{
+			callback(DMA_MEMORY_OK, context);
+		}
+
+		return 0;
+	}
+
+	/* The running copy may still read the pattern, it is written only after the stream is ours */
+	if(dma_memory_claim() != 0)
+	{
+		return -1;
+	}
+
+	dmaMemoryPattern = (uint32_t) value * 0x01010101U;
+
+	uint32_t head = (16U - (d & 0xFU)) & 0xFU;
+
+	if(head > length)
+	{
+		head = length;
+	}
+
+	uint32_t body = ((length - head) / 16U) * 16U;
+	uint32_t tail = length - head - body;
+
+	memset(destination, value, head);
+	memset((uint8_t *) destination + head + body, value, tail);
+
+	dmaMemoryItemSize = 4U;
+
+	/* Bursts only on the memory side: the source does not move */
+	dma_memory_start(d + head, (uint32_t) &dmaMemoryPattern, 0, body / 4U, DMA_WIDTH_WORD, DMA_BURST_INCR4, callback, context);
+
+	return 0;
+}
+
+uint32_t dma_memory_busy(void)
+{
+	return dmaMemoryBusy;
+}
+
+/* Copies shorter than bytes are done by the CPU. 0 sends everything to the DMA (the CCM RAM excepted) */
+void dma_memory_set_threshold(uint32_t bytes)
+{
+	dmaMemoryThreshold = bytes;
+}
+
+uint32_t dma_memory_get_threshold(void)
+{
+	return dmaMemoryThreshold;
+}
+
+void dma_memory_get_stats(dma_memory_stats_t *stats)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	*stats = dmaMemoryStats;
+
+	__set_PRIMASK(primask);
+}
+
+/* The stream belongs to one copy at a time. Returns -1 if it is taken, the caller can retry after its callback */
+static int dma_memory_claim(void)
+{
+	int result = -1;
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	if((dmaMemoryStream != 0) && !dmaMemoryBusy)
+	{
+		dmaMemoryBusy = 1;
+		result = 0;
+	}
+
+	__set_PRIMASK(primask);
+
+	return result;
+}
+
+static void dma_memory_start(uint32_t destination, uint32_t source, uint32_t sourceIncrement, uint32_t items, dma_width_t width,
+		dma_burst_t burst, dma_memory_callback_t callback, void *context)
+{
+	dmaMemoryDestination = destination;
+	dmaMemorySource = source;
+	dmaMemorySourceIncrement = sourceIncrement;
+	dmaMemoryRemaining = items;
+	dmaMemoryCallback = callback;
+	dmaMemoryContext = context;
+
+	if(items == 0)
+	{
+		/* The CPU already wrote the head and the tail, there was nothing in between */
+		dma_memory_count(&dmaMemoryStats.cpuTransfers);
+		dma_memory_finish(DMA_MEMORY_OK);
+		return;
+	}
+
+	dma_config_t config = {DMA_MEMORY_TO_MEMORY, width, width, (uint8_t) sourceIncrement, 1, 0, DMA_PRIORITY_LOW, DMA_INTERRUPT_TE | DMA_INTERRUPT_TC,
+			sourceIncrement ? burst : DMA_BURST_SINGLE, burst, 1, DMA_FIFO_THRESHOLD_FULL};
+
+	dma_stream_configure(dmaMemoryStream, &config, source);
+
+	dma_memory_count(&dmaMemoryStats.dmaTransfers);
+	dma_memory_next_chunk();
+}
+
+/* Runs with the stream stopped: at the start, or from the TC interrupt, where the hardware has already cleared EN */
+static void dma_memory_next_chunk(void)
+{
+	uint32_t items = (dmaMemoryRemaining > DMA_MEMORY_MAX_ITEMS) ? DMA_MEMORY_MAX_ITEMS : dmaMemoryRemaining;
+
+	/* dma_stream_start() sets the memory address only, the source of this chunk goes in DMA_SxPAR */
+	dmaMemoryStream->hw->stream->PAR = dmaMemorySource;
+	dma_stream_start(dmaMemoryStream, dmaMemoryDestination, items);
+
+	dmaMemoryDestination += items * dmaMemoryItemSize;
+
+	if(dmaMemorySourceIncrement)
+	{
+		dmaMemorySource += items * dmaMemoryItemSize;
+	}
+
+	dmaMemoryRemaining -= items;
+}
+
+/* The stream is free again before the callback, so the callback can already start the next copy */
+static void dma_memory_finish(int status)
+{
+	dma_memory_callback_t callback = dmaMemoryCallback;
+	void *context = dmaMemoryContext;
+
+	dmaMemoryCallback = 0;
+	dmaMemoryBusy = 0;
+
+	if(callback != 0)
+	{
+		callback(status, context);
+	}
+}
+
+/* Called from DMA2_Streamx_IRQHandler through dma_irq_handler() */
+static void dma_memory_stream_callback(dma_handle_t *handle, uint32_t flags, void *context)
+{
+	(void)handle;
+	(void)context;
+
+	if(flags & DMA_FLAG_TE)
+	{
+		/* The hardware has disabled the stream, the rest of the buffer is not written */
+		dma_memory_count(&dmaMemoryStats.errors);
+		dmaMemoryRemaining = 0;
+		dma_memory_finish(DMA_MEMORY_ERROR);
+		return;
+	}
+
+	if(flags & DMA_FLAG_TC)
+	{
+		if(dmaMemoryRemaining != 0)
+		{
+			dma_memory_next_chunk();
+		}
+		else
+		{
+			dma_memory_finish(DMA_MEMORY_OK);
+		}
+	}
+}
+
+/* 0 if [address, address + length) touches the CCM RAM */
+static uint32_t dma_memory_reachable(uint32_t address, uint32_t length)
+{
+	return ((address + length) <= DMA_MEMORY_CCM_START) || (address >= DMA_MEMORY_CCM_END);
+}
+
+/* The counters are incremented from thread mode (the copies done by the CPU) and from the interrupt of the stream, and a copy may be
+ * started from any interrupt: the read-modify-write of ++ must not be split */
+static void dma_memory_count(uint32_t *counter)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	(*counter)++;
+
+	__set_PRIMASK(primask);
+}
@@ -0,0 +1,36 @@
+/*
+ * dwt.c
+ *
+ *  Created on: 17 Oct 2026
+ *  Author: George Calin
+ *  Target Development Board: STM32 Nucleo F429ZI
+ */
+
+#include "dwt.h"
+
+#define COREDEBUG_DEMCR__TRCENA (1UL<<24)
+#define DWT_CTRL__CYCCNTENA (1UL<<0)
+
+/* ******************************************************************************************************************************************************************
+ * Explanation: Info taken from the ARM Cortex-M4 Generic User Guide and the ARMv7-M Architecture Reference Manual: Data Watchpoint and Trace unit (DWT)
+ * 		DWT_CYCCNT counts the clock cycles of the core, it is enabled by bit 0 CYCCNTENA of DWT_CTRL.
+ * 		The whole DWT unit is powered only when bit 24 TRCENA of the Debug Exception and Monitor Control Register (DEMCR) is set.
+ * At 16 MHz the 32 bit counter wraps around every 268 seconds, so the difference of two readings is right as long as the measured code is shorter than that.
+ * ******************************************************************************************************************************************************************
+ */
+void dwt_cycle_counter_init(void)
+{
+	CoreDebug->DEMCR |= COREDEBUG_DEMCR__TRCENA;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL__CYCCNTENA;
+}
+
+uint32_t dwt_get_cycles(void)
+{
+	return DWT->CYCCNT;
+}
+
+int dwt_cycle_counter_is_running(void)
+{
+	return ((CoreDebug->DEMCR & COREDEBUG_DEMCR__TRCENA) && (DWT->CTRL & DWT_CTRL__CYCCNTENA)) ? 1 : 0;
+}
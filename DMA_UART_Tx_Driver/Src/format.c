@@ -0,0 +1,263 @@
+/*
+ * format.c
+ *
+ *  Created on: 17 Oct 2026
+ *  Author: George Calin
+ *  Target Development Board: STM32 Nucleo F429ZI
+ */
+
+/* ******************************************************************************************************************************************************************
+ * A small replacement for printf. newlib's printf pulls in several KB of code, allocates its buffers through _sbrk and is not reentrant,
+ * so it must not be called from ADC_IRQHandler or any other interrupt. This formatter:
+ * 		- has no static state and never allocates, so the main loop and the interrupts can use it at the same time
+ * 		- formats into a buffer on the stack of the caller, which uart3_printf hands to the transmitter in one go
+ * 		- supports %d %i %u %x %X %c %s %% with the flags '-' and '0', a width, and the length modifiers h, hh, l (ignored, every integer is 32 bit)
+ * 		- prints fixed point numbers with %.Nq: the argument is an int32_t scaled by 10^N, so format_snprintf(b, s, "%.2q V", 331) gives "3.31 V"
+ * There is no floating point: on the Cortex-M4 a float goes through the FPU, but newlib formats it with double precision software routines.
+ * ******************************************************************************************************************************************************************
+ */
+
+#include "format.h"
+#include "uart.h"
+
+#define FORMAT_FLAG_LEFT (1U<<0)
+#define FORMAT_FLAG_ZERO (1U<<1)
+
+typedef struct
+{
+	char *buffer;
+	uint32_t size;
+	uint32_t length;
+} format_output_t;
+
+static void format_put(format_output_t *output, char character)
+{
+	/* One place is always kept for the terminating '\0' */
+	if((output->length + 1U) < output->size)
+	{
+		output->buffer[output->length] = character;
+	}
+	output->length++;
+}
+
+static void format_padding(format_output_t *output, char character, int32_t count)
+{
+	while(count-- > 0)
+	{
+		format_put(output, character);
+	}
+}
+
+/* Writes the digits of value in the base (10 or 16), with at least minimumDigits digits, and the sign and padding required by the flags and the width */
+static void format_number(format_output_t *output, uint32_t value, uint32_t negative, uint32_t base, uint32_t upperCase, uint32_t minimumDigits, uint32_t decimals, uint32_t flags, int32_t width)
+{
+	const char *digitCharacters = upperCase ? "0123456789ABCDEF" : "0123456789abcdef";
+	char digits[16];
+	uint32_t count = 0;
+
+	do
+	{
+		digits[count++] = digitCharacters[value % base];
+		value /= base;
+	} while((value != 0) && (count < sizeof(digits)));
+
+	while((count < minimumDigits) && (count < sizeof(digits)))
+	{
+		digits[count++] = '0';
+	}
+
+	int32_t length = (int32_t) count + (negative ? 1 : 0) + (decimals ? 1 : 0);
+
+	if(!(flags & FORMAT_FLAG_LEFT) && !(flags & FORMAT_FLAG_ZERO))
+	{
+		format_padding(output, ' ', width - length);
+	}
+
+	if(negative)
+	{
+		format_put(output, '-');
+	}
+
+	if(!(flags & FORMAT_FLAG_LEFT) && (flags & FORMAT_FLAG_ZERO))
+	{
+		format_padding(output, '0', width - length);
+	}
+
+	while(count > 0)
+	{
+		count--;
+		format_put(output, digits[count]);
+
+		/* The decimal point of the fixed point numbers goes before the last 'decimals' digits */
+		if((decimals != 0) && (count == decimals))
+		{
+			format_put(output, '.');
+		}
+	}
+
+	if(flags & FORMAT_FLAG_LEFT)
+	{
+		format_padding(output, ' ', width - length);
+	}
+}
+
+/* Returns the number of characters written in the buffer, without the terminating '\0'. What does not fit is cut away */
+int format_vsnprintf(char *buffer, uint32_t size, const char *format, va_list arguments)
+{
+	format_output_t output = {buffer, size, 0};
+
+	while(*format != '\0')
+	{
+		if(*format != '%')
+		{
+			format_put(&output, *format++);
+			continue;
+		}
+
+		format++;
+
+		uint32_t flags = 0;
+		int32_t width = 0;
+		int32_t precision = -1;
+
+		/* Flags */
+		while((*format == '-') || (*format == '0'))
+		{
+			flags |= (*format == '-') ? FORMAT_FLAG_LEFT : FORMAT_FLAG_ZERO;
+			format++;
+		}
+
+		/* Width */
+		while((*format >= '0') && (*format <= '9'))
+		{
+			width = (width * 10) + (*format++ - '0');
+		}
+
+		/* Precision */
+		if(*format == '.')
+		{
+			format++;
+			precision = 0;
+
+			while((*format >= '0') && (*format <= '9'))
+			{
+				precision = (precision * 10) + (*format++ - '0');
+			}
+		}
+
+		/* Length modifiers, every integer is 32 bit on the Cortex-M4 */
+		while((*format == 'l') || (*format == 'h'))
+		{
+			format++;
+		}
+
+		switch(*format)
+		{
+			case 'd':
+			case 'i':
+			{
+				int32_t value = va_arg(arguments, int32_t);
+				uint32_t magnitude = (value < 0) ? (0U - (uint32_t) value) : (uint32_t) value;
+				format_number(&output, magnitude, (value < 0), 10U, 0, 1U, 0, flags, width);
+				break;
+			}
+
+			case 'u':
+				format_number(&output, va_arg(arguments, uint32_t), 0, 10U, 0, 1U, 0, flags, width);
+				break;
+
+			case 'x':
+			case 'X':
+				format_number(&output, va_arg(arguments, uint32_t), 0, 16U, (*format == 'X'), 1U, 0, flags, width);
+				break;
+
+			case 'q':
+			{
+				/* Fixed point: the integer part needs at least one digit, so "0.05" and not ".05" */
+				uint32_t decimals = (precision < 0) ? 3U : (uint32_t) precision;
+				int32_t value = va_arg(arguments, int32_t);
+				uint32_t magnitude = (value < 0) ? (0U - (uint32_t) value) : (uint32_t) value;
+				format_number(&output, magnitude, (value < 0), 10U, 0, decimals + 1U, decimals, flags, width);
+				break;
+			}
+
+			case 'c':
+				format_padding(&output, ' ', (flags & FORMAT_FLAG_LEFT) ? 0 : width - 1);
+				format_put(&output, (char) va_arg(arguments, int));
+				format_padding(&output, ' ', (flags & FORMAT_FLAG_LEFT) ? width - 1 : 0);
+				break;
+
+			case 's':
+			{
+				const char *string = va_arg(arguments, const char *);
+				int32_t length = 0;
+
+				if(string == 0)
+				{
+					string = "(null)";
+				}
+
+				while((string[length] != '\0') && ((precision < 0) || (length < precision)))
+				{
+					length++;
+				}
+
+				format_padding(&output, ' ', (flags & FORMAT_FLAG_LEFT) ? 0 : width - length);
+				for(int32_t i = 0; i < length; i++)
+				{
+					format_put(&output, string[i]);
+				}
+				format_padding(&output, ' ', (flags & FORMAT_FLAG_LEFT) ? width - length : 0);
+				break;
+			}
+
+			case '%':
+				format_put(&output, '%');
+				break;
+
+			case '\0':
+				/* A lonely '%' at the end of the format */
+				format--;
+				break;
+
+			default:
+				/* Unknown conversion: print it as it is so the mistake is visible */
+				format_put(&output, '%');
+				format_put(&output, *format);
+				break;
+		}
+
+		format++;
+	}
+
+	if(size != 0)
+	{
+		buffer[(output.length < size) ? output.length : (size - 1U)] = '\0';
+	}
+
+	return (int) ((output.length < size) ? output.length : ((size != 0) ? (size - 1U) : 0));
+}
+
+int format_snprintf(char *buffer, uint32_t size, const char *format, ...)
+{
+	va_list arguments;
+
+	va_start(arguments, format);
+	int length = format_vsnprintf(buffer, size, format, arguments);
+	va_end(arguments);
+
+	return length;
+}
+
+/* Formats on the stack and hands the whole line to the transmitter selected for USART3 (polled, interrupt, DMA...). Safe to call from interrupts */
+int uart3_printf(const char *format, ...)
+{
+	char buffer[FORMAT_UART_BUFFER_SIZE];
+	va_list arguments;
+
+	va_start(arguments, format);
+	int length = format_vsnprintf(buffer, sizeof(buffer), format, arguments);
+	va_end(arguments);
+
+	return uart3_write_buffer(buffer, length);
+}
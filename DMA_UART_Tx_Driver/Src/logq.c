@@ -0,0 +1,267 @@
+/*
+ * logq.c
+ *
+ *  Created on: 17 Oct 2026
+ *  Author: George Calin
+ *  Target Development Board: STM32 Nucleo F429ZI
+ */
+
+/* ******************************************************************************************************************************************************************
+ * A log queue with many producers (main loop, EXTI15_10_IRQHandler, TIM2_IRQHandler, ADC_IRQHandler...) and one consumer (logq_drain() in the main loop).
+ * Instead of every context printing on the UART on its own, with the lines mixed up and the interrupts waiting on the wire, every producer:
+ * 		1. reserves a slot by moving the head forward with LDREX/STREX. If an interrupt reserves a slot between our LDREX and STREX, the STREX fails
+ * 		   (the exception return clears the exclusive monitor) and we simply try again with the new head. No interrupt is ever masked.
+ * 		2. writes its record in the slot, which belongs only to it
+ * 		3. commits the slot by setting its state, after a DMB so the consumer never sees the flag before the text.
+ * The consumer sends the slots in the order they were reserved. A slot reserved but not committed yet (its producer was preempted) stops the drain
+ * until the producer finishes, the records behind it stay in order.
+ * When the queue is full the record is dropped and counted for its level, a producer never waits.
+ * Records are formatted with format_vsnprintf() (format.c), which has no static state and can run in any interrupt.
+ * ******************************************************************************************************************************************************************
+ */
+
+#include <stdarg.h>
+#include "logq.h"
+#include "format.h"
+
+#define LOGQ_SLOTS_MASK (LOGQ_SLOTS - 1U)
+#define LOGQ_TAG_LENGTH (2U) // "E " in front of every record
+
+#define LOGQ_SLOT_FREE (0U)
+#define LOGQ_SLOT_COMMITTED (1U)
+
+typedef struct
+{
+	volatile uint32_t state;
+	uint32_t length;
+	char text[LOGQ_SLOT_SIZE];
+} logq_slot_t;
+
+static logq_slot_t logqSlots[LOGQ_SLOTS];
+static volatile uint32_t logqHead;			// next slot to reserve, moved by the producers with LDREX/STREX
+static volatile uint32_t logqTail;			// next slot to send, moved only by the consumer
+static uint32_t logqTailOffset;				// characters of the tail slot the sink has already accepted
+static volatile uint32_t logqCommitted;
+static volatile uint32_t logqSent;
+static volatile uint32_t logqDropped[LOGQ_LEVEL_COUNT];
+static volatile uint32_t logqHighWater;
+static logq_sink_t logqSink;
+
+static const char logqTags[LOGQ_LEVEL_COUNT] = {'E', 'W', 'I', 'D'};
+
+static logq_slot_t *logq_reserve(logq_level_t level);
+static void logq_commit(logq_slot_t *slot);
+static void logq_atomic_increment(volatile uint32_t *counter);
+static void logq_atomic_maximum(volatile uint32_t *value, uint32_t candidate);
+
+void logq_init(logq_sink_t sink)
+{
+	logqSink = sink;
+	logqHead = 0;
+	logqTail = 0;
+	logqTailOffset = 0;
+	logqCommitted = 0;
+	logqSent = 0;
+	logqHighWater = 0;
+
+	for(uint32_t i = 0; i < LOGQ_LEVEL_COUNT; i++)
+	{
+		logqDropped[i] = 0;
+	}
+
+	for(uint32_t i = 0; i < LOGQ_SLOTS; i++)
+	{
+		logqSlots[i].state = LOGQ_SLOT_FREE;
+	}
+}
+
+/* Formats the record straight into its slot. Returns the number of characters queued, or 0 if the record was dropped. Longer records are cut */
+int logq_printf(logq_level_t level, const char *format, ...)
+{
+	logq_slot_t *slot = logq_reserve(level);
+
+	if(slot == 0)
+	{
+		return 0;
+	}
+
+	va_list arguments;
+	va_start(arguments, format);
+	int length = format_vsnprintf(&slot->text[LOGQ_TAG_LENGTH], LOGQ_SLOT_SIZE - LOGQ_TAG_LENGTH, format, arguments);
+	va_end(arguments);
+
+	if(length < 0)
+	{
+		length = 0;
+	}
+
+	if((uint32_t) length > (LOGQ_SLOT_SIZE - LOGQ_TAG_LENGTH - 1U))
+	{
+		length = (int) (LOGQ_SLOT_SIZE - LOGQ_TAG_LENGTH - 1U);
+	}
+
+	slot->length = LOGQ_TAG_LENGTH + (uint32_t) length;
+	logq_commit(slot);
+
+	return (int) slot->length;
+}
+
+/* Queues text as it is. Returns the number of characters queued, or 0 if the record was dropped */
+int logq_write(logq_level_t level, const char *text, uint32_t length)
+{
+	logq_slot_t *slot = logq_reserve(level);
+
+	if(slot == 0)
+	{
+		return 0;
+	}
+
+	if(length > (LOGQ_SLOT_SIZE - LOGQ_TAG_LENGTH))
+	{
+		length = LOGQ_SLOT_SIZE - LOGQ_TAG_LENGTH;
+	}
+
+	for(uint32_t i = 0; i < length; i++)
+	{
+		slot->text[LOGQ_TAG_LENGTH + i] = text[i];
+	}
+
+	slot->length = LOGQ_TAG_LENGTH + length;
+	logq_commit(slot);
+
+	return (int) slot->length;
+}
+
+/* ******************************************************************************************************************************************************************
+ * Explanation: the only consumer. It has to be called from one context only, normally the main loop. It hands the committed records to the sink
+ * in order and returns the number of records completely sent. If the sink accepts only a part of a record (the transmitter is full),
+ * the rest stays in the slot and the next call continues from there, so nothing is lost and nothing is sent twice.
+ * ******************************************************************************************************************************************************************
+ */
+uint32_t logq_drain(void)
+{
+	uint32_t sent = 0;
+
+	if(logqSink == 0)
+	{
+		return 0;
+	}
+
+	while(logqTail != logqHead)
+	{
+		logq_slot_t *slot = &logqSlots[logqTail & LOGQ_SLOTS_MASK];
+
+		if(slot->state != LOGQ_SLOT_COMMITTED)
+		{
+			/* Reserved but still being written by a producer that was preempted */
+			break;
+		}
+
+		/* Read the text only after having seen the flag */
+		__DMB();
+
+		int remaining = (int) (slot->length - logqTailOffset);
+		int accepted = logqSink(&slot->text[logqTailOffset], remaining);
+
+		if(accepted < 0)
+		{
+			accepted = 0;
+		}
+
+		if(accepted < remaining)
+		{
+			logqTailOffset += (uint32_t) accepted;
+			break;
+		}
+
+		logqTailOffset = 0;
+
+		/* The slot is free again only after the sink is done with its text */
+		slot->state = LOGQ_SLOT_FREE;
+		__DMB();
+		logqTail++;
+
+		logq_atomic_increment(&logqSent);
+		sent++;
+	}
+
+	return sent;
+}
+
+void logq_get_stats(logq_stats_t *stats)
+{
+	stats->committed = logqCommitted;
+	stats->sent = logqSent;
+	stats->highWater = logqHighWater;
+
+	for(uint32_t i = 0; i < LOGQ_LEVEL_COUNT; i++)
+	{
+		stats->dropped[i] = logqDropped[i];
+	}
+}
+
+/* Returns the slot that now belongs to the caller, or 0 if the queue is full */
+static logq_slot_t *logq_reserve(logq_level_t level)
+{
+	uint32_t head;
+
+	if((uint32_t) level >= LOGQ_LEVEL_COUNT)
+	{
+		level = LOGQ_LEVEL_DEBUG;
+	}
+
+	do
+	{
+		head = __LDREXW(&logqHead);
+
+		if((head - logqTail) >= LOGQ_SLOTS)
+		{
+			__CLREX();
+			logq_atomic_increment(&logqDropped[level]);
+			return 0;
+		}
+	} while(__STREXW(head + 1U, &logqHead) != 0);
+
+	logq_atomic_maximum(&logqHighWater, head + 1U - logqTail);
+
+	logq_slot_t *slot = &logqSlots[head & LOGQ_SLOTS_MASK];
+	slot->text[0] = logqTags[level];
+	slot->text[1] = ' ';
+
+	return slot;
+}
+
+static void logq_commit(logq_slot_t *slot)
+{
+	/* The text has to be in memory before the consumer can see the flag */
+	__DMB();
+	slot->state = LOGQ_SLOT_COMMITTED;
+
+	logq_atomic_increment(&logqCommitted);
+}
+
+static void logq_atomic_increment(volatile uint32_t *counter)
+{
+	uint32_t value;
+
+	do
+	{
+		value = __LDREXW(counter);
+	} while(__STREXW(value + 1U, counter) != 0);
+}
+
+static void logq_atomic_maximum(volatile uint32_t *value, uint32_t candidate)
+{
+	uint32_t current;
+
+	do
+	{
+		current = __LDREXW(value);
+
+		if(candidate <= current)
+		{
+			__CLREX();
+			return;
+		}
+	} while(__STREXW(candidate, value) != 0);
+}
@@ -13,20 +13,21 @@
 #include <stdio.h>
 #include "uart.h"
 #include "timer.h"
+#include "exti.h"
+#include "logq.h"
 
 #define GPIOB_ENABLE (1UL<<1)
 #define PIN7	(1UL<<7)
 #define LED_PIN	PIN7
 
-#define DMA_LISR__TCIF3 (1UL<<27)
-#define DMA_LIFCR__CTCIF3 (1UL<<27)
+#define EXTI_PR_LINE_13 (1UL<<13)
 
-static void dma1_callback();
+static const uint8_t messageHeader[] = "MSG ";
+static uint8_t sensorBuffer[8] = {'0', '1', '2', '3', '4', '5', '6', '7'};
+static const uint8_t messageTrailer[] = " END\n\r";
 
 int main(void)
 {
-	char message[50] = "Good day, Alligator from DMA UART TX\n\r";
-
 	/* Enable the clock access via AHB1 to GPIO B */
 	RCC->AHB1ENR|=GPIOB_ENABLE;
 
@@ -34,44 +35,76 @@ int main(void)
 	GPIOB->MODER &=~(1UL<<15); //'0'
 	GPIOB->MODER |=(1UL<<14); //'1'
 
-	uart3_tx_init();
-	dma1_stream3_init((uint32_t) message, (uint32_t) &USART3->DR, 50);
+	/* printf is going to hand every line to DMA1 Stream3 in a single transfer */
+	uart3_dma_tx_init();
+
+	printf("Good day, Alligator from DMA UART TX\n\r");
+
+	/* The same kind of message, built from three pieces that are sent where they are, without copying them into one buffer first */
+	uart_segment_t message[3] =
+	{
+		{messageHeader, sizeof(messageHeader) - 1},
+		{sensorBuffer, sizeof(sensorBuffer)},
+		{messageTrailer, sizeof(messageTrailer) - 1}
+	};
+
+	uart3_writev(message, 3);
+
+	/* Wait (at most 100 ms) until both are on the wire. From an interrupt use uart3_write_async() with a callback instead */
+	uart3_flush(100);
+
+	/* stdin is fed by DMA1 Stream1, getchar never stalls the main loop */
+	uart3_stdin_init(UART3_READ_NONBLOCKING);
+
+	/* The interrupts only queue their messages, the main loop is the one that hands them to the transmitter */
+	logq_init(uart3_write_partial);
+	pc13_exti_init();
+
+	logq_printf(LOGQ_LEVEL_INFO, "logging through the queue\r\n");
 
 	for(;;)
 	{
+		logq_drain();
 
+		int key = getchar();
 
+		if(key == EOF)
+		{
+			/* Nothing received, the error flag of stdin has to be cleared before the next read */
+			clearerr(stdin);
+		}
+		else if(key == '1')
+		{
+			GPIOB->ODR ^=LED_PIN;
+		}
 	}
 
 }
 
-static void dma1_callback()
+/* The user button B1 on PC13 */
+void EXTI15_10_IRQHandler(void)
 {
-	/* Light the user LED */
-	GPIOB->ODR |=LED_PIN;
+	static uint32_t presses;
+
+	if(EXTI->PR & EXTI_PR_LINE_13)
+	{
+		/* Clear the PR Flag */
+		EXTI->PR |=(EXTI_PR_LINE_13);
+
+		presses++;
+		logq_printf(LOGQ_LEVEL_INFO, "button pressed %u times\r\n", presses);
+	}
 }
 
-void DMA1_Stream3_IRQHandler(void)
+/* Called from the interrupt of the USART3_TX stream (uart3_dma_tx_callback() in uart.c) once the whole message of uart3_writev() has been sent, sensorBuffer can be written again */
+void uart3_writev_callback(void)
 {
-	/* Check for transfer complete interrupt for Stream 3 */
-	/* ***********************************************************************************************************************************************
-	 * Explanation: This info is taken from RM0090: DMA low interrupt status register (DMA_LISR) (because we refer to channel 3)
-	 * We are going to be interested in bit no.27 TCIFx: Stream x transfer complete interrupt flag (x = 3..0)
-	 * 	This bit is set by hardware. It is cleared by software writing 1 to the corresponding bit in the DMA_LIFCR register.
-	 * 	0: No transfer complete event on stream x
-	 * 	1: A transfer complete event occurred on stream x
-	 * 	********************************************************************************************************************************************* */
-	 if(DMA1->LISR & DMA_LISR__TCIF3)
-	 {
-		 /* Clear the flag */
-		 /* *******************************************************************************************************************************************
-		  * Explanation: This info is taken from RM0090: DMA low interrupt flag clear register (DMA_LIFCR) as it said above when in need to clear the flag
-		  * We are going to be interested in bit no.27 which refers to CTCIFx: Stream x clear transfer complete interrupt flag (x = 3..0)
-		  * 	Writing 1 to this bit clears the corresponding TCIFx flag in the DMA_LISR register
-		  * ***************************************************************************************************************************************** */
-		 DMA1->LIFCR |= DMA_LIFCR__CTCIF3;
-
-		 /* Do something */
-		 dma1_callback();
-	 }
+	sensorBuffer[0]++;
+}
+
+/* Called from the interrupt of the USART3_TX stream (uart3_dma_tx_callback() in uart.c) once everything that was queued has been sent */
+void dma1_callback(void)
+{
+	/* Light the user LED */
+	GPIOB->ODR |=LED_PIN;
 }
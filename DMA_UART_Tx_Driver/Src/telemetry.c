@@ -0,0 +1,285 @@
+/*
+ * telemetry.c
+ *
+ *  Created on: 17 Oct 2026
+ *  Author: George Calin
+ *  Target Development Board: STM32 Nucleo F429ZI
+ */
+
+/* ******************************************************************************************************************************************************************
+ * Binary telemetry instead of printf("Sensor value: %d \n\r"): a 12 bit ADC sample costs 2 bytes instead of about 20 characters and no newlib formatting at all.
+ * Every record goes on the line as one frame:
+ * 		type (1 byte) | sequence (1 byte) | payload length (2 bytes, little endian) | payload | CRC32 (4 bytes, little endian)
+ * The frame is encoded with COBS (Consistent Overhead Byte Stuffing), which removes every 0x00 from it at the cost of at most 1 byte every 254,
+ * and then a 0x00 is sent as delimiter. This way the host finds the beginning of the next frame even after it lost some bytes.
+ * The CRC is computed by the CRC calculation unit of the STM32F4, the host decoder is in Tools/telemetry_decode.py.
+ * ******************************************************************************************************************************************************************
+ */
+
+#include "telemetry.h"
+#include "dwt.h"
+
+#define RCC_AHB1ENR__CRCEN (1UL<<12)
+#define CRC_CR__RESET (1UL<<0)
+
+#define TELEMETRY_HEADER_SIZE (4U)
+#define TELEMETRY_CRC_SIZE (4U)
+#define TELEMETRY_FRAME_MAX (TELEMETRY_HEADER_SIZE + TELEMETRY_MAX_PAYLOAD + TELEMETRY_CRC_SIZE)
+#define TELEMETRY_ENCODED_MAX (TELEMETRY_FRAME_MAX + (TELEMETRY_FRAME_MAX / 254U) + 2U) // COBS overhead plus the 0x00 delimiter
+
+static telemetry_sink_t telemetrySink;
+static uint8_t telemetrySequence;
+static uint8_t telemetryFrame[TELEMETRY_FRAME_MAX + 3U]; // room for the zero padding of the CRC, see crc32_hw_compute
+static uint8_t telemetryEncoded[TELEMETRY_ENCODED_MAX];
+static uint8_t telemetryDelta[TELEMETRY_MAX_PAYLOAD];
+static uint32_t telemetryCompression;
+static uint32_t telemetrySamples;
+static uint32_t telemetryRawBytes;
+static uint32_t telemetrySentBytes;
+static uint32_t telemetryCycles;
+
+static int telemetry_send_samples(uint8_t type, uint8_t deltaType, const int16_t *samples, uint32_t count, uint32_t channels);
+static uint32_t telemetry_delta_encode(const int16_t *samples, uint32_t count, uint32_t channels, uint8_t *destination, uint32_t size);
+
+void telemetry_init(telemetry_sink_t sink)
+{
+	/* Enable clock access to the CRC calculation unit, info taken from RM0090: RCC AHB1 peripheral clock register (RCC_AHB1ENR), bit 12 CRCEN */
+	RCC->AHB1ENR |= RCC_AHB1ENR__CRCEN;
+
+	telemetrySink = sink;
+	telemetrySequence = 0;
+	telemetryCompression = 0;
+	telemetrySamples = 0;
+	telemetryRawBytes = 0;
+	telemetrySentBytes = 0;
+	telemetryCycles = 0;
+
+	/* The encoder is timed with the cycle counter */
+	if(!dwt_cycle_counter_is_running())
+	{
+		dwt_cycle_counter_init();
+	}
+}
+
+/* Returns the number of bytes handed to the sink, or -1 if the payload is too long. Not reentrant: call it from one context only */
+int telemetry_send(uint8_t type, const void *payload, uint16_t length)
+{
+	if(length > TELEMETRY_MAX_PAYLOAD)
+	{
+		return -1;
+	}
+
+	const uint8_t *bytes = (const uint8_t *) payload;
+
+	telemetryFrame[0] = type;
+	telemetryFrame[1] = telemetrySequence++;
+	telemetryFrame[2] = (uint8_t) (length & 0xFFU);
+	telemetryFrame[3] = (uint8_t) (length >> 8);
+
+	for(uint32_t i = 0; i < length; i++)
+	{
+		telemetryFrame[TELEMETRY_HEADER_SIZE + i] = bytes[i];
+	}
+
+	uint32_t frameLength = TELEMETRY_HEADER_SIZE + length;
+	uint32_t crc = crc32_hw_compute(telemetryFrame, frameLength);
+
+	telemetryFrame[frameLength++] = (uint8_t) (crc);
+	telemetryFrame[frameLength++] = (uint8_t) (crc >> 8);
+	telemetryFrame[frameLength++] = (uint8_t) (crc >> 16);
+	telemetryFrame[frameLength++] = (uint8_t) (crc >> 24);
+
+	uint32_t encodedLength = cobs_encode(telemetryFrame, frameLength, telemetryEncoded);
+	telemetryEncoded[encodedLength++] = 0x00; // the delimiter
+
+	return telemetrySink((const char *) telemetryEncoded, (int) encodedLength);
+}
+
+/* The samples are sent as they are in memory, little endian, which is what the decoder expects. The 12 bit samples fit in an int16_t for the delta encoder */
+int telemetry_send_adc(const uint16_t *samples, uint16_t count)
+{
+	return telemetry_send_samples(TELEMETRY_TYPE_ADC, TELEMETRY_TYPE_ADC_DELTA, (const int16_t *) samples, count, 1U);
+}
+
+int telemetry_send_accel(const int16_t *xyz, uint16_t count)
+{
+	return telemetry_send_samples(TELEMETRY_TYPE_ACCEL, TELEMETRY_TYPE_ACCEL_DELTA, xyz, count * 3U, 3U);
+}
+
+/* 1: telemetry_send_adc() and telemetry_send_accel() send delta encoded records whenever they come out smaller than the raw ones */
+void telemetry_set_compression(uint32_t enabled)
+{
+	telemetryCompression = enabled ? 1U : 0U;
+}
+
+void telemetry_get_stats(telemetry_stats_t *stats)
+{
+	stats->samples = telemetrySamples;
+	stats->rawBytes = telemetryRawBytes;
+	stats->sentBytes = telemetrySentBytes;
+	stats->ratioPercent = (telemetrySentBytes != 0) ? (uint32_t) (((uint64_t) telemetryRawBytes * 100U) / telemetrySentBytes) : 0U;
+	stats->cyclesPerSample = (telemetrySamples != 0) ? (telemetryCycles / telemetrySamples) : 0U;
+}
+
+/* The statistics go on the line as a record of their own, the 5 fields of telemetry_stats_t in their order, little endian */
+int telemetry_send_stats(void)
+{
+	telemetry_stats_t stats;
+
+	telemetry_get_stats(&stats);
+
+	return telemetry_send(TELEMETRY_TYPE_STATS, &stats, sizeof(stats));
+}
+
+/* Sends count values (channels interleaved) as a delta record if compression is on and it is shorter, otherwise as they are.
+ * With compression a record can carry more samples than TELEMETRY_MAX_PAYLOAD / 2, as long as they fit once encoded. Returns -1 if they do not fit */
+static int telemetry_send_samples(uint8_t type, uint8_t deltaType, const int16_t *samples, uint32_t count, uint32_t channels)
+{
+	uint32_t rawLength = count * sizeof(int16_t);
+	uint32_t deltaLength = 0;
+
+	if(telemetryCompression)
+	{
+		uint32_t start = dwt_get_cycles();
+		deltaLength = telemetry_delta_encode(samples, count, channels, telemetryDelta, TELEMETRY_MAX_PAYLOAD);
+		telemetryCycles += dwt_get_cycles() - start;
+	}
+
+	int result;
+	uint32_t sentLength;
+
+	if((deltaLength != 0) && (deltaLength < rawLength))
+	{
+		result = telemetry_send(deltaType, telemetryDelta, (uint16_t) deltaLength);
+		sentLength = deltaLength;
+	}
+	else if(rawLength <= TELEMETRY_MAX_PAYLOAD)
+	{
+		result = telemetry_send(type, samples, (uint16_t) rawLength);
+		sentLength = rawLength;
+	}
+	else
+	{
+		return -1;
+	}
+
+	telemetrySamples += count;
+	telemetryRawBytes += rawLength;
+	telemetrySentBytes += sentLength;
+
+	return result;
+}
+
+/* ******************************************************************************************************************************************************************
+ * Explanation: two samples in a row of the ADC or of the accelerometer are almost the same, so instead of the sample we send its difference from the
+ * previous sample of the same channel (delta encoding):
+ * 		- zig-zag: the difference d is mapped to an unsigned number, (d << 1) ^ (d >> 31): 0, -1, 1, -2, 2... become 0, 1, 2, 3, 4...
+ * 		  so a small negative difference is a small number too, and not 0xFFFFFFFF
+ * 		- varint: that number is sent 7 bits per byte, low bits first, bit 7 set in every byte but the last.
+ * 		  A difference between -64 and 63 takes 1 byte instead of 2, one up to +-8191 takes 2 bytes, the worst case (16 bit jumps) is 3 bytes.
+ * The previous samples start from 0 in every record, so a record lost on the line only costs its own samples.
+ * Returns the length written in destination, or 0 if it does not fit in size.
+ * ******************************************************************************************************************************************************************
+ */
+static uint32_t telemetry_delta_encode(const int16_t *samples, uint32_t count, uint32_t channels, uint8_t *destination, uint32_t size)
+{
+	int32_t previous[3] = {0, 0, 0};
+	uint32_t length = 0;
+	uint32_t channel = 0;
+
+	for(uint32_t i = 0; i < count; i++)
+	{
+		int32_t delta = (int32_t) samples[i] - previous[channel];
+		uint32_t value = ((uint32_t) delta << 1) ^ (uint32_t) (delta >> 31);
+
+		previous[channel] = samples[i];
+
+		if(++channel == channels)
+		{
+			channel = 0;
+		}
+
+		/* Room for the longest varint of a 16 bit difference */
+		if((length + 3U) > size)
+		{
+			return 0;
+		}
+
+		while(value >= 0x80U)
+		{
+			destination[length++] = (uint8_t) (value | 0x80U);
+			value >>= 7;
+		}
+
+		destination[length++] = (uint8_t) value;
+	}
+
+	return length;
+}
+
+/* ******************************************************************************************************************************************************************
+ * Explanation: Info taken from RM0090: CRC calculation unit
+ * 		The unit uses the polynomial 0x4C11DB7 of CRC-32 (Ethernet) and processes one 32 bit word every time it is written into CRC_DR, in 4 AHB clock cycles.
+ * 		Bit 0 RESET of CRC_CR resets the calculation unit and sets the data register to 0xFFFFFFFF.
+ * 		There is no bit reversal and no final XOR, so the result is the CRC-32/MPEG-2 of the words written, most significant bit first.
+ * The frame is fed as little endian words, as they are in memory, and a length that is not a multiple of 4 is padded with zeros (the padding is not sent).
+ * The buffer has to have room for up to 3 bytes of padding after length.
+ * ******************************************************************************************************************************************************************
+ */
+uint32_t crc32_hw_compute(const uint8_t *data, uint32_t length)
+{
+	uint8_t *padding = (uint8_t *) data + length;
+
+	while(length & 3U)
+	{
+		*padding++ = 0;
+		length++;
+	}
+
+	CRC->CR = CRC_CR__RESET;
+
+	for(uint32_t i = 0; i < length; i += 4U)
+	{
+		CRC->DR = (uint32_t) data[i] | ((uint32_t) data[i + 1U] << 8) | ((uint32_t) data[i + 2U] << 16) | ((uint32_t) data[i + 3U] << 24);
+	}
+
+	return CRC->DR;
+}
+
+/* ******************************************************************************************************************************************************************
+ * Explanation: COBS replaces every 0x00 with the distance to the next 0x00. The output starts with a code byte n: the next n - 1 bytes are copied as they are
+ * and are followed by a 0x00, except when n is 0xFF (254 bytes without any zero, no zero follows). Returns the length of the encoded data, without delimiter.
+ * ******************************************************************************************************************************************************************
+ */
+uint32_t cobs_encode(const uint8_t *source, uint32_t length, uint8_t *destination)
+{
+	uint32_t codeIndex = 0;
+	uint32_t out = 1;
+	uint8_t code = 1;
+
+	for(uint32_t i = 0; i < length; i++)
+	{
+		if(source[i] == 0)
+		{
+			destination[codeIndex] = code;
+			codeIndex = out++;
+			code = 1;
+		}
+		else
+		{
+			destination[out++] = source[i];
+			code++;
+
+			if(code == 0xFF)
+			{
+				destination[codeIndex] = code;
+				codeIndex = out++;
+				code = 1;
+			}
+		}
+	}
+
+	destination[codeIndex] = code;
+
+	return out;
+}
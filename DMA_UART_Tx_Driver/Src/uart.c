@@ -12,38 +12,144 @@
  * ***************************** */
 
 
+#include <errno.h>
 #include "uart.h"
+#include "dwt.h"
+#include "dma.h"
 
 #define GPIODEN (1UL<<3)
 #define UART3EN (1UL<<18)
 
-#define SYSTEM_FREQ (16000000)
-#define APB1_CLOCK	SYSTEM_FREQ
-
 #define UART_BAUDRATE (115200)
 
 #define CR1_TE (1UL<<3)
 #define CR1_RE	(1UL<<2)
 
 #define CR1_UE (1UL<<13)
+#define CR1_WAKE (1UL<<11)
 
 #define USART_SRTXE (1UL<<7)
 #define SR_RXNE (1UL<<5)
+#define DR_ADDRESS_MARK (1UL<<8)
 
 #define USART_CR1TXEIE	(1UL<<7)
 
-#define RCC_AHB1ENR__DMA1ENR (1UL<<21)
-#define DMA_SxCR__EN (1UL<<0)
-#define DMA_SxCR__CHSEL (1UL<<27)
-#define DMA_SxCR__MINC (1UL<<10)
-#define DMA_SxCR__DIR (1UL<<6)
-#define DMA_SxCR__TCIE (1UL<<4)
 #define DMA_SxCR__EN (1UL<<0)
 #define USART_CR3__DMAT (1UL<<7)
 
+#define DMA_SxCR__CIRC (1UL<<8)
+#define DMA_SxCR__DBM (1UL<<18)
+#define DMA_SxCR__CT (1UL<<19)
+
+#define UART3_DMA_MAX_TRANSFER (0xFFFFU) // DMA_SxNDTR is 16 bits wide
+
+#define USART_CR3__DMAR (1UL<<6)
+#define USART_CR1__IDLEIE (1UL<<4)
+#define USART_SR__IDLE (1UL<<4)
+#define USART_SR__TC (1UL<<6)
+
+#define UART3_TX_BUFFER_MASK (UART3_TX_BUFFER_SIZE - 1U)
+
+/* The ring buffer of the interrupt driven transmitter: the producers (__io_putchar) write at the head, the USART3 interrupt reads from the tail */
+static volatile uint8_t uart3TxBuffer[UART3_TX_BUFFER_SIZE];
+static volatile uint32_t uart3TxHead;
+static volatile uint32_t uart3TxTail;
+static volatile uart_tx_backend_t uart3TxBackend = UART_TX_BACKEND_POLLED;
+static uart_tx_full_policy_t uart3TxFullPolicy = UART_TX_FULL_DROP;
+static volatile uart_tx_stats_t uart3TxStats;
+static uint32_t uart3Baudrate = UART_BAUDRATE;
+
+#define UART3_DMA_TX_BUFFER_MASK (UART3_DMA_TX_BUFFER_SIZE - 1U)
+
+/* The staging buffer of the DMA transmitter: _write copies at the head, the DMA reads from the tail.
+ * The region [tail, tail + uart3DmaTxInFlight) is being read by the DMA right now and must not be touched */
+static uint8_t uart3DmaTxBuffer[UART3_DMA_TX_BUFFER_SIZE] __attribute__((aligned(16)));
+static volatile uint32_t uart3DmaTxHead;
+static volatile uint32_t uart3DmaTxTail;
+static volatile uint32_t uart3DmaTxInFlight;
+
+/* The message queued by uart3_writev(). The DMA reads the segments where they are, only the list of the segments is copied.
+ * The characters staged before the message (head of the staging buffer when it was queued, uart3DmaTxVectorMark) are sent first */
+static uart_segment_t uart3DmaTxVector[UART3_WRITEV_MAX_SEGMENTS];
+static volatile uint32_t uart3DmaTxVectorCount;		// 0 while no message is queued
+static volatile uint32_t uart3DmaTxVectorIndex;		// the segment being sent
+static volatile uint32_t uart3DmaTxVectorOffset;	// characters of that segment already sent
+static volatile uint32_t uart3DmaTxVectorMark;
+static volatile uint32_t uart3DmaTxVectorActive;	// 1 while the transfer in flight reads a segment instead of the staging buffer
+
+/* The two halves of the double buffer logger. The DMA sends one of them (the one selected by CT) while the application fills the other one */
+static uint8_t uart3DbmBuffer[2][UART3_DBM_HALF_SIZE];
+static volatile uint32_t uart3DbmFillIndex;		// the half the application is filling
+static volatile uint32_t uart3DbmFillLevel;		// characters already placed in that half
+static volatile uint32_t uart3DbmPayloadBytes;
+static volatile uint32_t uart3DbmSentBytes;
+static volatile uint32_t uart3DbmDropped;
+
+#define UART3_DMA_RX_BUFFER_MASK (UART3_DMA_RX_BUFFER_SIZE - 1U)
+
+/* The receiver ring is the DMA buffer itself: the DMA writes at SIZE - NDTR and wraps around on its own because of the circular mode.
+ * The counters below are absolute (they are never wrapped), so that "written - read" is always the number of characters waiting */
+static uint8_t uart3DmaRxBuffer[UART3_DMA_RX_BUFFER_SIZE];
+static volatile uint32_t uart3DmaRxLastPosition;	// SIZE - NDTR seen by the last update
+static volatile uint32_t uart3DmaRxWritten;
+static volatile uint32_t uart3DmaRxRead;
+static volatile uint32_t uart3DmaRxFrameEnds[UART3_DMA_RX_MAX_FRAMES];
+static volatile uint32_t uart3DmaRxFrameHead;
+static volatile uint32_t uart3DmaRxFrameTail;
+static volatile uart_rx_stats_t uart3RxStats;
+static volatile uint32_t uart3DmaRxRunning;
+
+/* How long _read and __io_getchar wait for the first character, see uart3_stdin_init() */
+static uint32_t uart3StdinTimeout = UART3_READ_FOREVER;
+
+/* A timeout in milliseconds measured with the DWT cycle counter */
+typedef struct
+{
+	uint32_t remaining;
+	uint32_t cyclesPerMs;
+	uint32_t last;
+	uint32_t elapsed;
+} uart3_timeout_t;
+
+#define UART3_TX_CALLBACKS_MASK (UART3_TX_MAX_CALLBACKS - 1U)
 
-static uint16_t compute_uart_bd(uint32_t PeriphClock, uint32_t BaudRate);
-static void uart_set_baudrate(USART_TypeDef *USARTx, uint32_t PeriphClock, uint32_t BaudRate );
+/* The completions waited for by uart3_write_async(): the callback is due once the tail of the staging buffer reaches the mark */
+typedef struct
+{
+	uint32_t mark;
+	uart_tx_callback_t callback;
+	void *context;
+} uart3_tx_completion_t;
+
+static uart3_tx_completion_t uart3TxCompletions[UART3_TX_MAX_CALLBACKS];
+static volatile uint32_t uart3TxCompletionHead;
+static volatile uint32_t uart3TxCompletionTail;
+
+/* The streams given by dma_stream_open() to USART3_TX (DMA1 Stream 3, or Stream 4 if it is taken) and USART3_RX (DMA1 Stream 1).
+ * Their interrupts are served by dma.c, which calls uart3_dma_tx_callback() and uart3_dma_rx_callback() through the handles */
+static dma_handle_t *uart3DmaTxStream;
+static dma_handle_t *uart3DmaRxStream;
+
+
+static void uart_set_baudrate(USART_TypeDef *USARTx, uint32_t BaudRate);
+static void uart3_tx_ring_send_oldest_polled(void);
+static void dma1_stream3_start(uint32_t source, uint32_t length);
+static void uart3_dma_tx_callback(dma_handle_t *handle, uint32_t flags, void *context);
+static void uart3_dma_tx_start_next(void);
+static uint32_t uart3_dma_tx_start_segment(void);
+static void uart3_dbm_logger_swap(void);
+static void uart3_dbm_logger_close_half(void);
+static void uart3_dbm_logger_restart(void);
+static void uart3_rx_pin_init(void);
+static void uart3_dma_rx_update(void);
+static void uart3_dma_rx_drop_overrun(void);
+static void uart3_dma_rx_idle(void);
+static void uart3_dma_rx_resync(void);
+static void uart3_dma_rx_callback(dma_handle_t *handle, uint32_t flags, void *context);
+static void uart3_dma_rx_error_callback(dma_handle_t *handle, uint32_t errors, void *context);
+static void uart3_timeout_start(uart3_timeout_t *timeout, uint32_t timeoutMs);
+static int uart3_timeout_expired(uart3_timeout_t *timeout);
+static void uart3_tx_run_completions(void);
 
 /* Create a new function to handle the specific DMA module and the stream of DMA that refers to UART Tx */
 /* ********************************************************************************************************************************************************************************
@@ -51,148 +157,45 @@ static void uart_set_baudrate(USART_TypeDef *USARTx, uint32_t PeriphClock, uint3
  * In our case we wish to use USART3_TX that works with this Nucleo 144 board, hence we are going to address to Stream 3(on column) and its Channel 4(on row).
  * ********************************************************************************************************************************************************************************
  */
-void dma1_stream3_init(uint32_t source, uint32_t destination, uint32_t length)
-{
-	/* Enable clock access to DMA1 */
-	/* *****************************************************************************************************************************************************************************
-	 * Explanations: Information taken from STM32Fxx Datasheet: Block Diagram that DMA1 is connected to AHB1
-	 * Information taken from RM0090: RCC AHB1 peripheral clock register (RCC_AHB1ENR)
-	 * We are interested into the bit 21 of this registry which bit refers to DMA1EN as it says
-	 * 		DMA1EN: DMA1 clock enable
-	 * 		0: DMA1 clock disabled, 1: DMA1 clock enabled
-	 * ******************************************************************************************************************************************************************************
-	 */
-	RCC->AHB1ENR |= RCC_AHB1ENR__DMA1ENR;
-
-	/* Disable DMA1 Stream3 */
-	/* ******************************************************************************************************************************************************************************
-	 * Explanation: Info is taken from RM0090: DMA stream x configuration register (DMA_SxCR) (x = 0..7)
-	 * We are interested in bit 0 which corresponds to EN: Stream enable / flag stream ready when read low
-	 * 		This bit is set and cleared by software.
-	 * 		0: Stream disabled, 1: Stream enabled
-	 * ******************************************************************************************************************************************************************************
-	 */
-	DMA1_Stream3->CR &=~DMA_SxCR__EN;
-
-	/* Clear all interrupt flags of Stream 3 */
-	/* **********************************************************************************************************************************************************************************
-	 * Explanation: Info taken from RM0090: DMA high interrupt flag clear register (DMA_HIFCR) (for streams 4..7) or DMA low interrupt flag clear register (DMA_LIFCR) (for streams 0..3)
-	 * In this registry that comprises 32 bits, and we are interested in particular to clear out the bits that refers to stream 3 (so they will be located in DMA_LIFCR
-	 * Note: Pay attention to the description of the bits in RM0090, we find out that writing 1 to the bits clears the corresponding flags ( and not writing 0 as one normally would think)
-	 * **********************************************************************************************************************************************************************************
-	 */
-	DMA1->LIFCR |=(1UL<<22); //bit 22 of CFEIF3
-	DMA1->LIFCR |=(1UL<<24); //bit 24 of CDMEIF3
-	DMA1->LIFCR |=(1UL<<25); //bit 25 of CTEIF3
-	DMA1->LIFCR |=(1UL<<26); //bit 26 of CHTIF3
-	DMA1->LIFCR |=(1UL<<27); //bit 27 of CTCIF3
-
-	/* Set the destination buffer */
-	/* **************************************************************************************************************************************************************************************
-	 * Explanation: Info comes from RM0090: DMA stream x peripheral address register (DMA_SxPAR) (x = 0..7)
-	 * 		Bits 31:0 PAR[31:0]: Peripheral address
-	 * 		in this case the destination is UART which is a peripheral
-	 * **************************************************************************************************************************************************************************************
-	 */
-	DMA1_Stream3->PAR=destination;
-
-	/* Set the source buffer */
-	/* **************************************************************************************************************************************************************************************
-	 * Explanation: Info taken from RM0090: DMA stream x memory 0 address register (DMA_SxM0AR) (x = 0..7)
-	 * 		Bits 31:0 M0A[31:0]: Memory 0 address
-	 * 		in this case the source is a memory address
-	 * **************************************************************************************************************************************************************************************
-	 */
-	DMA1_Stream3->M0AR=source;
-
-	/* Set the length */
-	/* **************************************************************************************************************************************************************************************
-	 * Explanation: Info taken from RM0090:DMA stream x number of data register (DMA_SxNDTR) (x = 0..7)
-	 * 		Bits 15:0 NDT[15:0]: Number of data items to transfer
-	 * **************************************************************************************************************************************************************************************
-	 */
-	DMA1_Stream3->NDTR=length;
-
-	/* Select Stream 3 Channel 4 */
-	/* *************************************************************************************************************************************************************************************
-	 * Explanation: Info taken from RM0090: DMA stream x configuration register (DMA_SxCR) (x = 0..7)
-	 * We are going to pay attention to bits 25,26,27 which refer to CHSEL[2:0]: Channel selection
-	 * 		...
-	 * 		100: channel 4 selected
-	 * 		...
-	 * ************************************************************************************************************************************************************************************
-	 */
-	DMA1_Stream3->CR = DMA_SxCR__CHSEL; // we assigned it to erase all other bits and start from scratch
-
-	/* Enable memory increment */
-	/* *************************************************************************************************************************************************************************************
-	 * Explanation: Info taken from RM0090: DMA stream x configuration register (DMA_SxCR) (x = 0..7)
-	 * We are going to pay attention to bit 10 MINC: Memory increment mode
-	 * 		This bit is set and cleared by software.
-	 * 		0: Memory address pointer is fixed, 1: Memory address pointer is incremented after each data transfer (increment is done according to MSIZE)
-	 * 		This bit is protected and can be written only if bit 0 EN is ‘0’.
-	 ************************************************************************************************************************************************************************************
-	*/
-	DMA1_Stream3->CR |=DMA_SxCR__MINC;
-
-	/* Configure transfer direction */
-	/* *************************************************************************************************************************************************************************************
-	 * Explanation: Info taken from RM0090: DMA stream x configuration register (DMA_SxCR) (x = 0..7)
-	 * We are going to be interested in the bits 7 and 6 which make the DIR
-	 * 		DIR[1:0]: Data transfer direction. These bits are set and cleared by software.
-	 * 		00: Peripheral-to-memory
-	 * 		01: Memory-to-peripheral (this is the case of UART TX DMA driver)
-	 * 		10: Memory-to-memory
-	 * 		11: reserved
-	 * 		These bits are protected and can be written only if EN is ‘0’.
-	 * *************************************************************************************************************************************************************************************
-	 */
-	DMA1_Stream3->CR |=DMA_SxCR__DIR;
-
-	/* Enable DMA transfer complete interrupt */
-	/* *************************************************************************************************************************************************************************************
-	 * Explanation: Info taken from RM0090: DMA stream x configuration register (DMA_SxCR) (x = 0..7)
-	 * We are going to be interested in the one of the bits whose description ends in "IE", as it goes from "interrupt enable"
-	 * Particularly we are to be interested in bit no 4 which stands for TCIE: Transfer complete interrupt enable
-	 * 		This bit is set and cleared by software.
-	 * 		0: TC interrupt disabled, 1: TC interrupt enabled
-	 * ************************************************************************************************************************************************************************************ */
-	DMA1_Stream3->CR |=DMA_SxCR__TCIE;
-
-	/* Enable direct mode and disable FIFO mode*/
-	/* ***************************************************************************************************************************************************************************************
-	 * Explanation: Info taken from RM0090: DMA stream x FIFO control register (DMA_SxFCR) (x = 0..7)
-	 * We need to write 0 to all the bits in this register because this way it will set bit 7 FEIE FIFO error interrupt enable to 0
-	 * 		This bit is set and cleared by software. 0: FE interrupt disabled. 1: FE interrupt enabled
-	 * 	And simultaneously it will set Bit 2 DMDIS: Direct mode disable to 0
-	 * 		This bit is set and cleared by software. It can be set by hardware.
-	 * 		0: Direct mode enabled. 1: Direct mode disabled.
-	 * 		This bit is protected and can be written only if EN is ‘0’.
-	 *  ***************************************************************************************************************************************************************************************
-	 */
-	DMA1_Stream3->FCR = 0x0;
-
-	/* Enable DMA1 stream 3 */
-	/* ****************************************************************************************************************************************************************************************
-	 * Explanation: Info taken from RM0090: DMA stream x configuration register (DMA_SxCR) (x = 0..7)
-	 * We are going to mind the bit 0 which is EN: Stream enable / flag stream ready when read low
-	 * 		This bit is set and cleared by software.
-	 * 		0: Stream disabled, 1: Stream enabled
-	 * **************************************************************************************************************************************************************************************** */
-	 DMA1_Stream3->CR |=DMA_SxCR__EN;
+/* Returns 0, or -1 if both streams that can serve USART3_TX are taken by other requests */
+int dma1_stream3_init(uint32_t source, uint32_t destination, uint32_t length)
+{
+	/* Memory to peripheral, byte transfers, memory increment, transfer complete and error interrupts, direct mode.
+	 * dma_stream_open() (dma.c) looks USART3_TX up in the request mapping, enables the clock of DMA1, stops the stream, clears its flags in DMA_LIFCR,
+	 * writes DMA_SxPAR and DMA_SxCR and enables the interrupt in NVIC. USART3_TX is served by Stream 3, or by Stream 4 when Stream 3 is taken */
+	const dma_config_t config = {DMA_MEMORY_TO_PERIPHERAL, DMA_WIDTH_BYTE, DMA_WIDTH_BYTE, 0, 1, 0, DMA_PRIORITY_LOW,
+			(DMA_INTERRUPT_TC | DMA_INTERRUPT_TE | DMA_INTERRUPT_DME), DMA_BURST_SINGLE, DMA_BURST_SINGLE, 0, DMA_FIFO_THRESHOLD_QUARTER};
+
+	uart3DmaTxStream = dma_stream_open(DMA_REQUEST_USART3_TX, &config, destination);
+
+	if(uart3DmaTxStream == 0)
+	{
+		return -1;
+	}
+
+	/* Whichever stream it is, its interrupt ends in dma_irq_handler(), which calls uart3_dma_tx_callback() */
+	dma_stream_set_callback(uart3DmaTxStream, uart3_dma_tx_callback, 0);
+
+	/* With a length of 0 there is nothing to send yet: the stream is only configured and dma1_stream3_start() is going to enable it later */
+	if(length != 0)
+	{
+		dma_stream_start(uart3DmaTxStream, source, length);
+	}
+	else
+	{
+		uart3DmaTxStream->hw->stream->M0AR = source;
+	}
 
 	/* Enable UART3 Transmitter DMA*/
-	/* ****************************************************************************************************************************************************************************************
+	/* ****************************************************************************************************************************************************************
 	 * Explanation: Info taken from RM0090: Control register 3 (USART_CR3)
 	 * We are going to be interested in bit no. 7 as it refers to DMAT: DMA enable transmitter
 	 * 		This bit is set/reset by software
 	 * 		1: DMA mode is enabled for transmission. 0: DMA mode is disabled for transmission.
-	 * *************************************************************************************************************************************************************************************** */
+	 * *************************************************************************************************************************************************************** */
 	 USART3->CR3 |=USART_CR3__DMAT;
 
-	/* DMA Interrupt enable in NVIC*/
-	 NVIC_EnableIRQ(DMA1_Stream3_IRQn);
-
+	 return 0;
 }
 
 void uart3_rxtx_init(void)
@@ -227,13 +230,12 @@ void uart3_rxtx_init(void)
 	/* Enable clock access to UART2 */
 	RCC->APB1ENR |= UART3EN;
 
-	/* Configure baudrate */
-	uart_set_baudrate(USART3, APB1_CLOCK, UART_BAUDRATE);
-
-
 	/* Configure the transfer direction */
 	USART3->CR1 = (CR1_TE | CR1_RE); // Set for both TX and RX
 
+	/* Configure baudrate. It comes after CR1 was overwritten, because the oversampling mode (OVER8) is a bit of CR1 */
+	uart_set_baudrate(USART3, UART_BAUDRATE);
+
 	/* Enable the UART module */
 	USART3->CR1 |= CR1_UE; // |= so to say, write only that particular bit, and leave the others unchanged cause we already set the bit 3 at the previous line of code
 }
@@ -271,13 +273,12 @@ void uart3_tx_interrupt_init(void)
 	/* Enable clock access to UART3 */
 	RCC->APB1ENR |= UART3EN;
 
-	/* Configure baudrate */
-	uart_set_baudrate(USART3, APB1_CLOCK, UART_BAUDRATE);
-
-
 	/* Configure the transfer direction */
 	USART3->CR1 = (CR1_TE | CR1_RE); // Set for both TX and RX
 
+	/* Configure baudrate. It comes after CR1 was overwritten, because the oversampling mode (OVER8) is a bit of CR1 */
+	uart_set_baudrate(USART3, UART_BAUDRATE);
+
 	/* Enable the TXEIE interrupt */
 	/* *******************************************************************************************************************************************************************
 	 * Explanations: The info is taken from RM0090: Control register 1 (USART_CR1)
@@ -322,27 +323,1380 @@ void uart3_tx_init(void)
 	/* Enable clock access to UART2 */
 	RCC->APB1ENR |= UART3EN;
 
-	/* Configure baudrate */
-	uart_set_baudrate(USART3, APB1_CLOCK, UART_BAUDRATE);
-
-
 	/* Configure the transfer direction */
 	USART3->CR1 = CR1_TE; // this overwrites all bits to 0, except the one in the desired position (3) => thus all the parameters of the communication are set as per CR1 bits values
 
+	/* Configure baudrate. It comes after CR1 was overwritten, because the oversampling mode (OVER8) is a bit of CR1 */
+	uart_set_baudrate(USART3, UART_BAUDRATE);
+
 	/* Enable the UART module */
 	USART3->CR1 |= CR1_UE; // |= so to say, write only that particular bit, and leave the others unchanged cause we already set the bit 3 at the previous line of code
+
+	/* Back to uart3_write() for every character. uart3_tx_ring_init() and uart3_dma_tx_init() select their own backend after this call */
+	uart3TxBackend = UART_TX_BACKEND_POLLED;
 }
 
 
 
+/* *** INTERRUPT DRIVEN TRANSMITTER WITH RING BUFFER *** */
+/* ******************************************************************************************************************************************************************
+ * Explanation: with uart3_write() the CPU waits on the TXE flag for every single character, which at 115200 baud means about 87 us per character (10 bits per frame).
+ * Instead we are going to place the characters in a ring buffer and let the USART3 interrupt move them into the data register whenever TXE is raised.
+ * The TXEIE interrupt is enabled only while there is something in the buffer, otherwise the interrupt would fire continuously because the data register stays empty.
+ * ******************************************************************************************************************************************************************
+ */
+void uart3_tx_ring_init(void)
+{
+	/* Configure PD8 and the USART3 module as a transmitter */
+	uart3_tx_init();
+
+	/* Start with an empty buffer */
+	uart3TxHead = 0;
+	uart3TxTail = 0;
+	uart3_tx_reset_stats();
+
+	/* Enable UART3 interrupt in NVIC. The TXEIE bit is going to be set once the first character is placed in the buffer */
+	NVIC_EnableIRQ(USART3_IRQn);
+
+	/* From now on __io_putchar is going to place the characters in the buffer */
+	uart3TxBackend = UART_TX_BACKEND_INTERRUPT;
+}
+
+void uart3_tx_set_full_policy(uart_tx_full_policy_t policy)
+{
+	uart3TxFullPolicy = policy;
+}
+
+/* Returns 1 if the character was placed in the buffer and 0 if it was dropped */
+int uart3_tx_ring_put(char character)
+{
+	/* The buffer is shared between the main loop and the interrupts that print (timer, systick, adc...), hence the update of the indexes has to happen with the interrupts masked.
+	 * We save PRIMASK instead of calling __enable_irq() at the end, so that a caller which already runs with the interrupts disabled keeps them disabled */
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	while((uart3TxHead - uart3TxTail) >= UART3_TX_BUFFER_SIZE)
+	{
+		if(uart3TxFullPolicy == UART_TX_FULL_DROP)
+		{
+			uart3TxStats.dropped++;
+			__set_PRIMASK(primask);
+			return 0;
+		}
+
+		if(uart3TxFullPolicy == UART_TX_FULL_OVERWRITE)
+		{
+			/* Forget the oldest character to make room for the new one */
+			uart3TxTail++;
+			uart3TxStats.dropped++;
+			break;
+		}
+
+		/* UART_TX_FULL_BLOCK */
+		if((__get_IPSR() == 0) && (primask == 0))
+		{
+			/* Thread mode with the interrupts enabled: let the USART3 interrupt empty a slot and try again */
+			__set_PRIMASK(primask);
+			__ISB(); // give the pending USART3 interrupt the chance to be taken before we mask the interrupts again
+			__disable_irq();
+		}
+		else if(!usart_cts_is_clear(USART_PORT_3))
+		{
+			/* The host holds nCTS high: the character cannot leave now and spinning inside an interrupt until the host is ready would stall everything else */
+			uart3TxStats.dropped++;
+			__set_PRIMASK(primask);
+			return 0;
+		}
+		else
+		{
+			/* We are inside an interrupt (or the interrupts are masked), so USART3_IRQHandler cannot run and waiting for it would hang forever.
+			 * Send the oldest character ourselves, this keeps the order of the characters and frees one slot */
+			uart3_tx_ring_send_oldest_polled();
+		}
+	}
+
+	uart3TxBuffer[uart3TxHead & UART3_TX_BUFFER_MASK] = (uint8_t) character;
+	uart3TxHead++;
+
+	if((uart3TxHead - uart3TxTail) > uart3TxStats.highWater)
+	{
+		uart3TxStats.highWater = uart3TxHead - uart3TxTail;
+	}
+
+	/* Enable the TXEIE interrupt so that the interrupt starts (or keeps) draining the buffer */
+	USART3->CR1 |= USART_CR1TXEIE;
+
+	__set_PRIMASK(primask);
+
+	return 1;
+}
+
+void uart3_tx_get_stats(uart_tx_stats_t *stats)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	stats->highWater = uart3TxStats.highWater;
+	stats->dropped = uart3TxStats.dropped;
+
+	__set_PRIMASK(primask);
+}
+
+void uart3_tx_reset_stats(void)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	uart3TxStats.highWater = 0;
+	uart3TxStats.dropped = 0;
+
+	__set_PRIMASK(primask);
+}
+
+/* Has to be called with the interrupts disabled */
+static void uart3_tx_ring_send_oldest_polled(void)
+{
+	/* Make sure the transmit data register is empty */
+	while(!(USART3->SR & USART_SRTXE));
+
+	USART3->DR = uart3TxBuffer[uart3TxTail & UART3_TX_BUFFER_MASK];
+	uart3TxTail++;
+}
+
+/* ***********************************************************************************************************************************
+ * Explanations: The name of the ISR has to exist in the vector table from Startup > startup_stm32f429zitx.s
+ * We check the TXEIE bit as well as the TXE flag, because TXE is set most of the time and does not mean that we asked for the interrupt
+ * *************************************************************************************************************************************
+ */
+void USART3_IRQHandler(void)
+{
+	/* IDLE line after a frame received by the DMA. Reading SR and then DR clears the flag */
+	if((USART3->CR1 & USART_CR1__IDLEIE) && (USART3->SR & USART_SR__IDLE))
+	{
+		(void) USART3->DR;
+		uart3_dma_rx_idle();
+	}
+
+	if((uart3TxBackend == UART_TX_BACKEND_INTERRUPT) && (USART3->CR1 & USART_CR1TXEIE) && (USART3->SR & USART_SRTXE))
+	{
+		if(uart3TxHead != uart3TxTail)
+		{
+			/* Writing the data register clears the TXE flag */
+			USART3->DR = uart3TxBuffer[uart3TxTail & UART3_TX_BUFFER_MASK];
+			uart3TxTail++;
+		}
+		else
+		{
+			/* Nothing left to send, stop the interrupt until the next character is placed in the buffer */
+			USART3->CR1 &=~USART_CR1TXEIE;
+		}
+	}
+
+	/* USART3 opened through the generic driver (usart_open(USART_PORT_3, ...)) */
+	usart_irq_handler(USART_PORT_3);
+}
+
+
+/* *** DMA DRIVEN TRANSMITTER *** */
+/* ******************************************************************************************************************************************************************
+ * Explanation: the transmitter based on the interrupt still costs one interrupt for every character. With the DMA the whole buffer of a printf (one call of _write)
+ * is sent with a single transfer: the CPU only copies the characters in the staging buffer and programs the stream once, then the DMA feeds USART3 on its own.
+ * The copy is needed because newlib reuses the buffer of stdout as soon as _write returns.
+ * If a transfer is still running, the new characters only wait in the staging buffer and uart3_dma_tx_callback() chains the next transfer when the current one completes.
+ * Returns 0, or -1 if there is no stream left for USART3_TX: the transmitter then stays on uart3_write().
+ * Returns -1 as well, without touching anything, while USART3 is in multiprocessor mode (see uart3_multiprocessor_init())
+ * ******************************************************************************************************************************************************************
+ */
+int uart3_dma_tx_init(void)
+{
+	if(USART3->CR1 & CR1_WAKE)
+	{
+		return -1;
+	}
+
+	/* Configure PD8 and the USART3 module as a transmitter */
+	uart3_tx_init();
+
+	/* Start with an empty staging buffer */
+	uart3DmaTxHead = 0;
+	uart3DmaTxTail = 0;
+	uart3DmaTxInFlight = 0;
+	uart3DmaTxVectorCount = 0;
+	uart3DmaTxVectorActive = 0;
+	uart3TxCompletionHead = 0;
+	uart3TxCompletionTail = 0;
+	uart3_tx_reset_stats();
+
+	/* Configure DMA1 Stream3 Channel4 for USART3_TX, memory to peripheral, with the transfer complete interrupt.
+	 * No transfer is started because the length is 0, dma1_stream3_start() is going to program the source and the length of every transfer */
+	if(dma1_stream3_init((uint32_t) uart3DmaTxBuffer, (uint32_t) &USART3->DR, 0) != 0)
+	{
+		return -1;
+	}
+
+	/* Then through the FIFO: the memory side reads 4 characters per access, in bursts of 4 words, and the USART still gets one byte per request.
+	 * dma_stream_start() steps down to single words or bytes for the chunks that do not start and end on such a boundary (dma.c).
+	 * The double buffer logger stays in direct mode: the FIFO would read ahead in the next half while the application is still writing in it */
+	const dma_config_t packed = {DMA_MEMORY_TO_PERIPHERAL, DMA_WIDTH_BYTE, DMA_WIDTH_WORD, 0, 1, 0, DMA_PRIORITY_LOW,
+			(DMA_INTERRUPT_TC | DMA_INTERRUPT_TE | DMA_INTERRUPT_FE), DMA_BURST_SINGLE, DMA_BURST_INCR4, 1, DMA_FIFO_THRESHOLD_FULL};
+
+	/* A refused configuration leaves the stream stopped: give it back and stay on uart3_write() */
+	if(dma_stream_configure(uart3DmaTxStream, &packed, (uint32_t) &USART3->DR) != 0)
+	{
+		USART3->CR3 &=~USART_CR3__DMAT;
+		dma_stream_close(uart3DmaTxStream);
+		uart3DmaTxStream = 0;
+		return -1;
+	}
+
+	/* From now on _write and __io_putchar are going to place the characters in the staging buffer */
+	uart3TxBackend = UART_TX_BACKEND_DMA;
+
+	return 0;
+}
+
+uart_tx_backend_t uart3_tx_get_backend(void)
+{
+	return uart3TxBackend;
+}
+
+/* Characters accepted by the interrupt or the DMA transmitter that have not been handed to USART3 yet.
+ * When it reaches 0 only the last character may still be in the shift register, the TC flag tells when the line is really idle */
+uint32_t uart3_tx_pending(void)
+{
+	if(uart3TxBackend == UART_TX_BACKEND_INTERRUPT)
+	{
+		return uart3TxHead - uart3TxTail;
+	}
+
+	if(uart3TxBackend == UART_TX_BACKEND_DMA)
+	{
+		uint32_t primask = __get_PRIMASK();
+		__disable_irq();
+
+		uint32_t pending = uart3DmaTxHead - uart3DmaTxTail;
+
+		/* Plus what is left of the message queued by uart3_writev() */
+		for(uint32_t i = uart3DmaTxVectorIndex; i < uart3DmaTxVectorCount; i++)
+		{
+			pending += uart3DmaTxVector[i].length;
+		}
+
+		if(uart3DmaTxVectorIndex < uart3DmaTxVectorCount)
+		{
+			pending -= uart3DmaTxVectorOffset;
+		}
+
+		__set_PRIMASK(primask);
+
+		return pending;
+	}
+
+	return 0;
+}
+
+/* Returns the number of characters accepted. If the staging buffer is full the behaviour follows uart3_tx_set_full_policy(),
+ * with the exception of UART_TX_FULL_OVERWRITE which behaves as UART_TX_FULL_DROP, because the oldest characters may be already in the hands of the DMA */
+int uart3_dma_write(const char *ptr, int len)
+{
+	int accepted = 0;
+
+	while(accepted < len)
+	{
+		uint32_t primask = __get_PRIMASK();
+		__disable_irq();
+
+		uint32_t space = UART3_DMA_TX_BUFFER_SIZE - (uart3DmaTxHead - uart3DmaTxTail);
+		uint32_t count = (uint32_t) (len - accepted);
+
+		if(count > space)
+		{
+			count = space;
+		}
+
+		/* Copy the characters in the staging buffer */
+		for(uint32_t i = 0; i < count; i++)
+		{
+			uart3DmaTxBuffer[(uart3DmaTxHead + i) & UART3_DMA_TX_BUFFER_MASK] = (uint8_t) ptr[accepted + i];
+		}
+		uart3DmaTxHead += count;
+		accepted += (int) count;
+
+		if((uart3DmaTxHead - uart3DmaTxTail) > uart3TxStats.highWater)
+		{
+			uart3TxStats.highWater = uart3DmaTxHead - uart3DmaTxTail;
+		}
+
+		/* If the DMA is idle start it, otherwise the interrupt is going to chain the new characters */
+		if(uart3DmaTxInFlight == 0)
+		{
+			uart3_dma_tx_start_next();
+		}
+
+		__set_PRIMASK(primask);
+
+		if(accepted < len)
+		{
+			/* The staging buffer is full. We can wait for uart3_dma_tx_callback() to free some room only in thread mode with the interrupts enabled */
+			if((uart3TxFullPolicy != UART_TX_FULL_BLOCK) || (__get_IPSR() != 0) || (primask != 0))
+			{
+				uart3TxStats.dropped += (uint32_t) (len - accepted);
+				break;
+			}
+
+			while((uart3DmaTxHead - uart3DmaTxTail) >= UART3_DMA_TX_BUFFER_SIZE);
+		}
+	}
+
+	return accepted;
+}
+
+/* *** ASYNCHRONOUS WRITE AND FLUSH *** */
+/* ******************************************************************************************************************************************************************
+ * Explanation: fflush(stdout) in systick_callback() or tim2_callback() waits until the characters are gone, inside the interrupt.
+ * uart3_write_async() only copies the characters in the staging buffer of the DMA transmitter and returns, from any context: it never waits on the wire,
+ * if there is no room the characters that do not fit are dropped (and counted in uart_tx_stats_t). The optional callback runs in uart3_dma_tx_callback()
+ * once all the accepted characters have been handed to USART3, at the same place dma1_callback() is called from.
+ * uart3_flush() is the blocking counterpart for thread mode: it waits, at most timeoutMs, until every queued character has left the shift register.
+ * ******************************************************************************************************************************************************************
+ */
+/* Returns the number of characters accepted, or -1 if the DMA transmitter is not selected or too many callbacks are waiting */
+int uart3_write_async(const char *ptr, int len, uart_tx_callback_t callback, void *context)
+{
+	if(uart3TxBackend != UART_TX_BACKEND_DMA)
+	{
+		return -1;
+	}
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	if((callback != 0) && ((uart3TxCompletionHead - uart3TxCompletionTail) >= UART3_TX_MAX_CALLBACKS))
+	{
+		__set_PRIMASK(primask);
+		return -1;
+	}
+
+	/* Called with the interrupts masked uart3_dma_write() never waits for room, whatever the policy: what does not fit is dropped */
+	int accepted = uart3_dma_write(ptr, len);
+
+	if(callback != 0)
+	{
+		uart3_tx_completion_t *completion = &uart3TxCompletions[uart3TxCompletionHead & UART3_TX_CALLBACKS_MASK];
+		completion->mark = uart3DmaTxHead;
+		completion->callback = callback;
+		completion->context = context;
+		uart3TxCompletionHead++;
+	}
+
+	uint32_t idle = (uart3DmaTxInFlight == 0) && (uart3DmaTxHead == uart3DmaTxTail);
+
+	__set_PRIMASK(primask);
+
+	/* Nothing was accepted and nothing is in flight, there will be no interrupt to call the callback */
+	if((callback != 0) && idle)
+	{
+		uart3_tx_run_completions();
+	}
+
+	return accepted;
+}
+
+/* Thread mode only. Returns 0 once everything queued is on the wire, or -1 if the timeout expired first or if it was called from an interrupt.
+ * Not supported by the double buffer logger: its circular stream never stops, so TC never rises and the line is never idle. It returns -1 at once */
+int uart3_flush(uint32_t timeoutMs)
+{
+	uart3_timeout_t timeout;
+
+	if((__get_IPSR() != 0) || (uart3TxBackend == UART_TX_BACKEND_DMA_DOUBLE_BUFFER))
+	{
+		return -1;
+	}
+
+	uart3_timeout_start(&timeout, timeoutMs);
+
+	while(uart3_tx_pending() != 0)
+	{
+		if(uart3_timeout_expired(&timeout))
+		{
+			return -1;
+		}
+	}
+
+	/* The last character may still be in the shift register */
+	if(USART3->CR1 & CR1_UE)
+	{
+		while(!(USART3->SR & USART_SR__TC))
+		{
+			if(uart3_timeout_expired(&timeout))
+			{
+				return -1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/* Calls, in order, the callbacks whose characters are all gone. Every entry is taken out of the queue with the interrupts disabled,
+ * but its callback runs with the interrupts as they were, so a long callback does not delay the other interrupts */
+static void uart3_tx_run_completions(void)
+{
+	for(;;)
+	{
+		uint32_t primask = __get_PRIMASK();
+		__disable_irq();
+
+		if(uart3TxCompletionTail == uart3TxCompletionHead)
+		{
+			__set_PRIMASK(primask);
+			return;
+		}
+
+		uart3_tx_completion_t completion = uart3TxCompletions[uart3TxCompletionTail & UART3_TX_CALLBACKS_MASK];
+
+		if((int32_t) (completion.mark - uart3DmaTxTail) > 0)
+		{
+			__set_PRIMASK(primask);
+			return;
+		}
+
+		uart3TxCompletionTail++;
+		__set_PRIMASK(primask);
+
+		completion.callback(completion.context);
+	}
+}
+
+/* *** ZERO COPY SCATTER GATHER WRITE *** */
+/* ******************************************************************************************************************************************************************
+ * Explanation: a message made of a header, a payload that lives in a sensor buffer and a trailer CRC does not have to be copied into one buffer first.
+ * uart3_writev() takes the list of the segments and the DMA reads every segment from where it is, one transfer per segment:
+ * uart3_dma_tx_callback() chains the next segment at every transfer complete, exactly like it chains the chunks of the staging buffer.
+ * Only the list is copied (at most UART3_WRITEV_MAX_SEGMENTS entries), so it can live on the stack of the caller, but the memory of the segments
+ * belongs to the DMA until uart3_writev_callback() is called, once, after the last character of the whole message has been handed to USART3.
+ * The segments can be in flash or SRAM, but not in the CCM RAM (0x10000000), which is not connected to the DMA.
+ * Only one message can be queued at a time. The characters printed meanwhile wait in the staging buffer and are sent after the message.
+ * ******************************************************************************************************************************************************************
+ */
+/* Returns the number of characters queued or -1 if the DMA transmitter is not selected, the list is empty or too long, or the previous message is not complete yet */
+int uart3_writev(const uart_segment_t *segments, uint32_t count)
+{
+	int total = 0;
+
+	if((uart3TxBackend != UART_TX_BACKEND_DMA) || (count == 0) || (count > UART3_WRITEV_MAX_SEGMENTS))
+	{
+		return -1;
+	}
+
+	for(uint32_t i = 0; i < count; i++)
+	{
+		total += (int) segments[i].length;
+	}
+
+	if(total == 0)
+	{
+		return -1;
+	}
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	if(uart3DmaTxVectorCount != 0)
+	{
+		__set_PRIMASK(primask);
+		return -1;
+	}
+
+	for(uint32_t i = 0; i < count; i++)
+	{
+		uart3DmaTxVector[i] = segments[i];
+	}
+
+	uart3DmaTxVectorIndex = 0;
+	uart3DmaTxVectorOffset = 0;
+	uart3DmaTxVectorMark = uart3DmaTxHead;
+	uart3DmaTxVectorCount = count;
+
+	if(uart3DmaTxInFlight == 0)
+	{
+		uart3_dma_tx_start_next();
+	}
+
+	__set_PRIMASK(primask);
+
+	return total;
+}
+
+/* 1 while the message of uart3_writev() has not been completely sent */
+int uart3_writev_busy(void)
+{
+	return (uart3DmaTxVectorCount != 0);
+}
+
+/* Called from uart3_dma_tx_callback() once the whole message of uart3_writev() has been handed to USART3, the segments can be reused */
+__attribute__((weak)) void uart3_writev_callback(void)
+{
+}
+
+/* Has to be called with the interrupts disabled and with the DMA idle */
+static void uart3_dma_tx_start_next(void)
+{
+	uint32_t pending = uart3DmaTxHead - uart3DmaTxTail;
+
+	if(uart3DmaTxVectorCount != 0)
+	{
+		/* The characters staged before the message go first */
+		pending = uart3DmaTxVectorMark - uart3DmaTxTail;
+
+		if(pending == 0)
+		{
+			if(uart3_dma_tx_start_segment())
+			{
+				return;
+			}
+
+			/* The last segment is gone: the message is complete */
+			uart3DmaTxVectorCount = 0;
+			uart3_writev_callback();
+
+			/* The callback may have queued the next message and started the DMA already */
+			if(uart3DmaTxInFlight != 0)
+			{
+				return;
+			}
+
+			pending = uart3DmaTxHead - uart3DmaTxTail;
+		}
+	}
+
+	if(pending == 0)
+	{
+		return;
+	}
+
+	/* The DMA reads a contiguous memory area, so the transfer stops at the end of the staging buffer and the rest is sent by the next transfer */
+	uint32_t offset = uart3DmaTxTail & UART3_DMA_TX_BUFFER_MASK;
+
+	if(pending > (UART3_DMA_TX_BUFFER_SIZE - offset))
+	{
+		pending = UART3_DMA_TX_BUFFER_SIZE - offset;
+	}
+
+	uart3DmaTxInFlight = pending;
+	dma1_stream3_start((uint32_t) &uart3DmaTxBuffer[offset], pending);
+}
+
+/* Starts the next non empty segment of the message. Returns 1 if a transfer was started and 0 if there is nothing left to send */
+static uint32_t uart3_dma_tx_start_segment(void)
+{
+	while(uart3DmaTxVectorIndex < uart3DmaTxVectorCount)
+	{
+		const uart_segment_t *segment = &uart3DmaTxVector[uart3DmaTxVectorIndex];
+		uint32_t remaining = segment->length - uart3DmaTxVectorOffset;
+
+		if(remaining != 0)
+		{
+			/* NDTR has only 16 bits, a longer segment is sent in pieces */
+			if(remaining > UART3_DMA_MAX_TRANSFER)
+			{
+				remaining = UART3_DMA_MAX_TRANSFER;
+			}
+
+			uart3DmaTxInFlight = remaining;
+			uart3DmaTxVectorActive = 1;
+			dma1_stream3_start((uint32_t) (segment->data + uart3DmaTxVectorOffset), remaining);
+			return 1;
+		}
+
+		uart3DmaTxVectorIndex++;
+		uart3DmaTxVectorOffset = 0;
+	}
+
+	return 0;
+}
+
+/* Re-arm the stream of USART3_TX for a new transfer, the rest of the configuration stays as it was set by dma1_stream3_init() */
+static void dma1_stream3_start(uint32_t source, uint32_t length)
+{
+	/* The DMA writes DR without reading SR first, so TC would stay set from the previous transfer. TC is rc_w0: writing 0 clears it,
+	 * the '1's written in the other bits change nothing. uart3_flush() waits on it */
+	USART3->SR = (uint32_t) ~USART_SR__TC;
+
+	dma_stream_start(uart3DmaTxStream, source, length);
+}
+
+/* Called from dma_irq_handler() (dma.c) in the interrupt of the USART3_TX stream, with the flags it has already read and cleared (DMA_FLAG_...) and
+ * after dma_stream_handle_errors() has counted the errors. After a transfer error the hardware has stopped the stream and the transfer never completes:
+ * its characters are counted as dropped and the interrupt goes on as for a transfer complete, so the staging buffer, the message of uart3_writev()
+ * and the callbacks keep moving instead of waiting forever */
+static void uart3_dma_tx_callback(dma_handle_t *handle, uint32_t flags, void *context)
+{
+	(void)handle;
+	(void)context;
+
+	if(flags & (DMA_FLAG_TC | DMA_FLAG_TE))
+	{
+		if(uart3TxBackend == UART_TX_BACKEND_DMA_DOUBLE_BUFFER)
+		{
+			if(flags & DMA_FLAG_TE)
+			{
+				uart3_dbm_logger_restart();
+			}
+			else
+			{
+				uart3_dbm_logger_swap();
+			}
+			return;
+		}
+
+		if(flags & DMA_FLAG_TE)
+		{
+			uart3TxStats.dropped += uart3DmaTxInFlight;
+		}
+
+		if(uart3DmaTxVectorActive)
+		{
+			/* A piece of a segment of uart3_writev() */
+			uart3DmaTxVectorActive = 0;
+			uart3DmaTxVectorOffset += uart3DmaTxInFlight;
+
+			if(uart3DmaTxVectorOffset >= uart3DmaTxVector[uart3DmaTxVectorIndex].length)
+			{
+				uart3DmaTxVectorIndex++;
+				uart3DmaTxVectorOffset = 0;
+			}
+		}
+		else
+		{
+			/* The characters of the completed transfer are gone, their room can be reused */
+			uart3DmaTxTail += uart3DmaTxInFlight;
+		}
+		uart3DmaTxInFlight = 0;
+
+		/* Chain the next transfer first, so that the line does not wait for the callbacks */
+		uart3_dma_tx_start_next();
+		uart3_tx_run_completions();
+
+		if(uart3DmaTxInFlight == 0)
+		{
+			dma1_callback();
+		}
+	}
+}
+
+/* *** CONTINUOUS LOGGER WITH DMA DOUBLE BUFFER MODE *** */
+/* ******************************************************************************************************************************************************************
+ * Explanation: Info taken from RM0090: DMA stream x configuration register (DMA_SxCR) and section "Double buffer mode"
+ * 		Bit 18 DBM: Double buffer mode. 0: No buffer switching at the end of transfer, 1: Memory target switched at the end of the DMA transfer
+ * 		Bit 19 CT: Current target (only in double buffer mode). 0: The current target memory is Memory 0 (DMA_SxM0AR), 1: ... Memory 1 (DMA_SxM1AR)
+ * 		When DBM is set the circular mode is enabled automatically and at the end of every transfer the stream starts again with the other memory.
+ * 		Bits 31:0 of DMA_SxM1AR: Memory 1 address, used only in double buffer mode.
+ * This way the DMA never stops between two halves and the line never goes idle. At every transfer complete interrupt the half that has just been sent
+ * goes back to the application, while the half the application was filling is the one the DMA has just started to send.
+ * Whatever the application did not fill is sent as UART3_DBM_FILL_CHARACTER, which is how we can measure the utilization of the line.
+ * The length of a transfer cannot change while the stream runs (NDTR is reloaded with the same value for both memories), so every half always sends
+ * UART3_DBM_HALF_SIZE characters and the padding goes on the line: the receiver has to discard it. It is a NUL, which terminals ignore and which the
+ * COBS decoders of Tools (telemetry_decode.py, dlog_decode.py) read as empty frames and skip, so text, telemetry and DLOG frames go through unchanged.
+ * The hardware switches halves on its own, before its interrupt runs: the writers check CT too and close the half themselves, in the same critical
+ * section as their copy, so no character is ever written in the half the DMA is sending.
+ * ******************************************************************************************************************************************************************
+ */
+/* Returns 0, or -1 if there is no stream left for USART3_TX or USART3 is in multiprocessor mode (see uart3_multiprocessor_init()) */
+int uart3_dbm_logger_init(void)
+{
+	if(USART3->CR1 & CR1_WAKE)
+	{
+		return -1;
+	}
+
+	/* Configure PD8 and the USART3 module as a transmitter */
+	uart3_tx_init();
+
+	/* Both halves start with fill characters, the DMA sends half 0 while the application fills half 1 */
+	for(uint32_t i = 0; i < UART3_DBM_HALF_SIZE; i++)
+	{
+		uart3DbmBuffer[0][i] = UART3_DBM_FILL_CHARACTER;
+		uart3DbmBuffer[1][i] = UART3_DBM_FILL_CHARACTER;
+	}
+
+	uart3DbmFillIndex = 1;
+	uart3DbmFillLevel = 0;
+	uart3DbmPayloadBytes = 0;
+	uart3DbmSentBytes = 0;
+	uart3DbmDropped = 0;
+
+	/* Configure the stream of USART3_TX (DMA1 Stream3 Channel4), without starting it */
+	if(dma1_stream3_init((uint32_t) uart3DbmBuffer[0], (uint32_t) &USART3->DR, 0) != 0)
+	{
+		return -1;
+	}
+
+	DMA_Stream_TypeDef *stream = uart3DmaTxStream->hw->stream;
+
+	stream->M0AR = (uint32_t) uart3DbmBuffer[0];
+	stream->M1AR = (uint32_t) uart3DbmBuffer[1];
+	stream->NDTR = UART3_DBM_HALF_SIZE;
+
+	/* Enable the double buffer mode starting from memory 0. The DBM and CT bits are protected and can be written only while EN is '0' */
+	stream->CR &=~DMA_SxCR__CT;
+	stream->CR |=(DMA_SxCR__DBM | DMA_SxCR__CIRC);
+
+	uart3TxBackend = UART_TX_BACKEND_DMA_DOUBLE_BUFFER;
+
+	/* Enable the stream, from now on it runs forever */
+	stream->CR |=DMA_SxCR__EN;
+
+	return 0;
+}
+
+/* Returns the number of characters accepted, what does not fit in the half being filled is dropped */
+int uart3_dbm_logger_write(const char *ptr, int len)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	/* The DMA may have switched to the half being filled before its interrupt could run */
+	uart3_dbm_logger_close_half();
+
+	uint32_t count = (uint32_t) len;
+	uint32_t space = UART3_DBM_HALF_SIZE - uart3DbmFillLevel;
+
+	if(count > space)
+	{
+		uart3DbmDropped += count - space;
+		count = space;
+	}
+
+	uint8_t *half = uart3DbmBuffer[uart3DbmFillIndex];
+
+	for(uint32_t i = 0; i < count; i++)
+	{
+		half[uart3DbmFillLevel + i] = (uint8_t) ptr[i];
+	}
+	uart3DbmFillLevel += count;
+
+	__set_PRIMASK(primask);
+
+	return (int) count;
+}
+
+void uart3_dbm_logger_get_stats(uart_dbm_stats_t *stats)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	stats->payloadBytes = uart3DbmPayloadBytes;
+	stats->sentBytes = uart3DbmSentBytes;
+	stats->dropped = uart3DbmDropped;
+
+	__set_PRIMASK(primask);
+
+	/* The line never goes idle, so sentBytes is also the time elapsed measured in characters: the ratio between payload and sent characters is the utilization */
+	stats->lineCapacity = uart3Baudrate / 10U;
+	stats->payloadPerSecond = 0;
+	stats->utilizationPermille = 0;
+
+	if(stats->sentBytes != 0)
+	{
+		stats->payloadPerSecond = (uint32_t) (((uint64_t) stats->payloadBytes * stats->lineCapacity) / stats->sentBytes);
+		stats->utilizationPermille = (uint32_t) (((uint64_t) stats->payloadBytes * 1000U) / stats->sentBytes);
+	}
+}
+
+/* Called from uart3_dma_tx_callback() on every transfer complete, that is when the DMA has switched to the other half.
+ * A writer of a higher priority interrupt may be copying into the half, so it is closed with the interrupts disabled like the writers do */
+static void uart3_dbm_logger_swap(void)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	uart3DbmSentBytes += UART3_DBM_HALF_SIZE;
+
+	/* Nothing to do if a writer already closed the half, or if the interrupt was served so late that the DMA is sending the half it has just completed again */
+	uart3_dbm_logger_close_half();
+
+	__set_PRIMASK(primask);
+}
+
+/* Has to be called with the interrupts disabled. CT tells which half the DMA is sending now: if it is the half the application is filling, that half
+ * is closed as it is. Its unused part is already padding, because a half is padded as a whole when it goes back to the application */
+static void uart3_dbm_logger_close_half(void)
+{
+	/* Before uart3_dbm_logger_init() the writers only fill the half, there is no stream to look at yet */
+	if(uart3TxBackend != UART_TX_BACKEND_DMA_DOUBLE_BUFFER)
+	{
+		return;
+	}
+
+	uint32_t sending = (uart3DmaTxStream->hw->stream->CR & DMA_SxCR__CT) ? 1U : 0U;
+
+	if(sending != uart3DbmFillIndex)
+	{
+		return;
+	}
+
+	uart3DbmPayloadBytes += uart3DbmFillLevel;
+
+	/* The half that has just been sent goes back to the application, padded before anything is written in it. The DMA is busy with the other one */
+	uint8_t *half = uart3DbmBuffer[sending ^ 1U];
+
+	for(uint32_t i = 0; i < UART3_DBM_HALF_SIZE; i++)
+	{
+		half[i] = UART3_DBM_FILL_CHARACTER;
+	}
+
+	uart3DbmFillIndex = sending ^ 1U;
+	uart3DbmFillLevel = 0;
+}
+
+/* Called from uart3_dma_tx_callback() after a transfer error, the stream is stopped. The half that was being sent starts again from its beginning,
+ * CT still points at it and the double buffer mode bits are untouched. Some characters go out twice, the logger does not stop */
+static void uart3_dbm_logger_restart(void)
+{
+	DMA_Stream_TypeDef *stream = uart3DmaTxStream->hw->stream;
+
+	stream->NDTR = UART3_DBM_HALF_SIZE;
+	stream->CR |=DMA_SxCR__EN;
+}
+
+__attribute__((weak)) void dma1_callback(void)
+{
+}
+
+/* *** DMA DRIVEN RECEIVER *** */
+/* ******************************************************************************************************************************************************************
+ * Explanation: The info is taken from RM0090: DMA1 request mapping, USART3_RX is served by Stream 1 Channel 4.
+ * With one interrupt for every character (RXNEIE) the CPU has less than 10 us to serve it at 1 Mbaud, and any longer interrupt makes the receiver overrun.
+ * Instead the DMA runs in circular mode and writes every character in a RAM ring without the CPU. We still need to know where the data is:
+ * 		- the half transfer (HTIF1) and transfer complete (TCIF1) interrupts tell that half of the ring has been filled, so we never lose track of a full lap
+ * 		- the IDLE interrupt of the USART tells that the line stayed idle for one frame after the last character, which is where a frame of variable length ends
+ * Info taken from RM0090: Status register (USART_SR), Bit 4 IDLE: IDLE line detected. It is cleared by a read to the USART_SR register followed by a read to the USART_DR register.
+ * Info taken from RM0090: Control register 1 (USART_CR1), Bit 4 IDLEIE: IDLE interrupt enable.
+ * Info taken from RM0090: Control register 3 (USART_CR3), Bit 6 DMAR: DMA enable receiver.
+ * Returns 0, or -1 if Stream 1 is taken by another request: the receiver is not started
+ * ******************************************************************************************************************************************************************
+ */
+int uart3_dma_rx_init(void)
+{
+	/* Configure PD9 and the receiver without touching a transmitter that may be already running */
+	if(!(USART3->CR1 & CR1_UE))
+	{
+		uart3_rxtx_init();
+	}
+	else
+	{
+		uart3_rx_pin_init();
+		USART3->CR1 |= CR1_RE;
+	}
+
+	uart3DmaRxRunning = 1;
+	uart3DmaRxLastPosition = 0;
+	uart3DmaRxWritten = 0;
+	uart3DmaRxRead = 0;
+	uart3DmaRxFrameHead = 0;
+	uart3DmaRxFrameTail = 0;
+	uart3RxStats.received = 0;
+	uart3RxStats.frames = 0;
+	uart3RxStats.overrun = 0;
+	uart3RxStats.framesMerged = 0;
+
+	/* The source is the data register of USART3, the destination is the ring. Peripheral to memory, byte transfers, memory increment, circular mode,
+	 * half and complete transfer interrupts. The priority is high because a late receiver loses data while a late transmitter only waits.
+	 * USART3_RX is DMA1 Stream1 Channel 4 only, the interrupt of the stream ends in dma_irq_handler() which calls the callbacks registered below.
+	 * Direct mode: through the FIFO the last characters of a frame would wait there for the threshold, while NDTR already counts them as written */
+	const dma_config_t config = {DMA_PERIPHERAL_TO_MEMORY, DMA_WIDTH_BYTE, DMA_WIDTH_BYTE, 0, 1, 1, DMA_PRIORITY_HIGH,
+			(DMA_INTERRUPT_HT | DMA_INTERRUPT_TC | DMA_INTERRUPT_TE | DMA_INTERRUPT_DME),
+			DMA_BURST_SINGLE, DMA_BURST_SINGLE, 0, DMA_FIFO_THRESHOLD_QUARTER};
+
+	uart3DmaRxStream = dma_stream_open(DMA_REQUEST_USART3_RX, &config, (uint32_t) &USART3->DR);
+
+	if(uart3DmaRxStream == 0)
+	{
+		uart3DmaRxRunning = 0;
+		return -1;
+	}
+
+	dma_stream_set_callback(uart3DmaRxStream, uart3_dma_rx_callback, 0);
+	dma_stream_set_error_callback(uart3DmaRxStream, uart3_dma_rx_error_callback, 0);
+	dma_stream_start(uart3DmaRxStream, (uint32_t) uart3DmaRxBuffer, UART3_DMA_RX_BUFFER_SIZE);
+
+	/* Let the USART hand every character to the DMA */
+	USART3->CR3 |= USART_CR3__DMAR;
+
+	/* Clear a pending IDLE flag (read SR then DR) and enable the IDLE interrupt */
+	(void) USART3->SR;
+	(void) USART3->DR;
+	USART3->CR1 |= USART_CR1__IDLEIE;
+
+	NVIC_EnableIRQ(USART3_IRQn);
+
+	return 0;
+}
+
+uint32_t uart3_dma_rx_available(void)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	uart3_dma_rx_update();
+	uart3_dma_rx_drop_overrun();
+	uint32_t available = uart3DmaRxWritten - uart3DmaRxRead;
+
+	__set_PRIMASK(primask);
+
+	return available;
+}
+
+/* Reads the characters waiting in the ring as a stream, without caring about the frames */
+uint32_t uart3_dma_rx_read(uint8_t *destination, uint32_t maxLength)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	uart3_dma_rx_update();
+	uart3_dma_rx_drop_overrun();
+
+	uint32_t count = uart3DmaRxWritten - uart3DmaRxRead;
+
+	if(count > maxLength)
+	{
+		count = maxLength;
+	}
+
+	for(uint32_t i = 0; i < count; i++)
+	{
+		destination[i] = uart3DmaRxBuffer[(uart3DmaRxRead + i) & UART3_DMA_RX_BUFFER_MASK];
+	}
+	uart3DmaRxRead += count;
+
+	/* Forget the frame ends we have already passed */
+	while((uart3DmaRxFrameHead != uart3DmaRxFrameTail) && ((int32_t) (uart3DmaRxFrameEnds[uart3DmaRxFrameTail % UART3_DMA_RX_MAX_FRAMES] - uart3DmaRxRead) <= 0))
+	{
+		uart3DmaRxFrameTail++;
+	}
+
+	__set_PRIMASK(primask);
+
+	return count;
+}
+
+/* Reads the next complete frame. Returns its length, or -1 if no frame has been closed by the IDLE line yet.
+ * If the frame is longer than maxLength the rest of it is discarded */
+int uart3_dma_rx_read_frame(uint8_t *destination, uint32_t maxLength)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	uart3_dma_rx_drop_overrun();
+
+	if(uart3DmaRxFrameHead == uart3DmaRxFrameTail)
+	{
+		__set_PRIMASK(primask);
+		return -1;
+	}
+
+	uint32_t frameEnd = uart3DmaRxFrameEnds[uart3DmaRxFrameTail % UART3_DMA_RX_MAX_FRAMES];
+	uart3DmaRxFrameTail++;
+
+	uint32_t length = frameEnd - uart3DmaRxRead;
+	uint32_t count = (length > maxLength) ? maxLength : length;
+
+	for(uint32_t i = 0; i < count; i++)
+	{
+		destination[i] = uart3DmaRxBuffer[(uart3DmaRxRead + i) & UART3_DMA_RX_BUFFER_MASK];
+	}
+	uart3DmaRxRead = frameEnd;
+
+	__set_PRIMASK(primask);
+
+	return (int) count;
+}
+
+void uart3_dma_rx_get_stats(uart_rx_stats_t *stats)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	uart3_dma_rx_update();
+
+	stats->received = uart3DmaRxWritten;
+	stats->frames = uart3RxStats.frames;
+	stats->overrun = uart3RxStats.overrun;
+	stats->framesMerged = uart3RxStats.framesMerged;
+	stats->addresses = uart3RxStats.addresses;
+
+	__set_PRIMASK(primask);
+}
+
+/* Has to be called with the interrupts disabled. Moves uart3DmaRxWritten to the position where the DMA is writing now */
+static void uart3_dma_rx_update(void)
+{
+	/* Nothing to look at before uart3_dma_rx_init() found a stream */
+	if(uart3DmaRxStream == 0)
+	{
+		return;
+	}
+
+	uint32_t position = (UART3_DMA_RX_BUFFER_SIZE - dma_stream_remaining(uart3DmaRxStream)) & UART3_DMA_RX_BUFFER_MASK;
+
+	/* The half and complete transfer interrupts guarantee that we look at the position at least every half of the ring, so the difference is never a full lap */
+	uart3DmaRxWritten += (position - uart3DmaRxLastPosition) & UART3_DMA_RX_BUFFER_MASK;
+	uart3DmaRxLastPosition = position;
+}
+
+/* Has to be called with the interrupts disabled. If the DMA went around the ring over characters nobody read, skip them */
+static void uart3_dma_rx_drop_overrun(void)
+{
+	uint32_t waiting = uart3DmaRxWritten - uart3DmaRxRead;
+
+	if(waiting > UART3_DMA_RX_BUFFER_SIZE)
+	{
+		uart3RxStats.overrun += waiting - UART3_DMA_RX_BUFFER_SIZE;
+		uart3DmaRxRead = uart3DmaRxWritten - UART3_DMA_RX_BUFFER_SIZE;
+
+		while((uart3DmaRxFrameHead != uart3DmaRxFrameTail) && ((int32_t) (uart3DmaRxFrameEnds[uart3DmaRxFrameTail % UART3_DMA_RX_MAX_FRAMES] - uart3DmaRxRead) <= 0))
+		{
+			uart3DmaRxFrameTail++;
+		}
+	}
+}
+
+/* Set PD9 as USART3_RX (AF7) */
+static void uart3_rx_pin_init(void)
+{
+	/* Enable clock access to gpioD */
+	RCC->AHB1ENR |= GPIODEN;
+
+	/* Set PD9 mode to alternate function mode */
+	GPIOD->MODER |=(1UL<<19); // '1'
+	GPIOD->MODER &=~(1UL<<18); // '0'
+
+	/* Set PD9 alternate function type to UART_RX(AF7) */
+	GPIOD->AFR[1] &=~(1UL<<7); //'0'
+	GPIOD->AFR[1] |=(1UL<<6); //'1'
+	GPIOD->AFR[1] |=(1UL<<5); //'1'
+	GPIOD->AFR[1] |=(1UL<<4);//'1'
+}
+
+/* Called from dma_irq_handler() (dma.c) in the interrupt of the USART3_RX stream with the flags it has already read and cleared:
+ * HT or TC, half of the ring has been filled. Only remember how far the DMA went, the frame is not over yet */
+static void uart3_dma_rx_callback(dma_handle_t *handle, uint32_t flags, void *context)
+{
+	(void)handle;
+	(void)flags;
+	(void)context;
+
+	uart3_dma_rx_update();
+}
+
+/* Called from dma_stream_handle_errors() before uart3_dma_rx_callback(). A stopped ring has already been started again by dma.c from its first character
+ * (DMA_EVENT_RECOVERED), or is left stopped (DMA_EVENT_ABANDONED). What arrived since the last HT or TC is lost with the rest of the ring */
+static void uart3_dma_rx_error_callback(dma_handle_t *handle, uint32_t errors, void *context)
+{
+	(void)handle;
+	(void)context;
+
+	if(errors & (DMA_EVENT_RECOVERED | DMA_EVENT_ABANDONED))
+	{
+		uart3_dma_rx_resync();
+	}
+}
+
+/* Has to be called with the interrupts disabled. The DMA writes again from the start of the ring, while uart3DmaRxWritten points somewhere in the middle of it:
+ * the characters not read yet are dropped (counted as overrun) and the counters move to the next lap, where the position of the DMA is 0 again */
+static void uart3_dma_rx_resync(void)
+{
+	uint32_t lap = (uart3DmaRxWritten + UART3_DMA_RX_BUFFER_MASK) & ~UART3_DMA_RX_BUFFER_MASK;
+
+	uart3RxStats.overrun += uart3DmaRxWritten - uart3DmaRxRead;
+	uart3DmaRxWritten = lap;
+	uart3DmaRxRead = lap;
+	uart3DmaRxLastPosition = 0;
+	uart3DmaRxFrameTail = uart3DmaRxFrameHead;
+}
+
+/* Called from USART3_IRQHandler when the IDLE line was detected */
+static void uart3_dma_rx_idle(void)
+{
+	uart3_dma_rx_update();
+
+	/* Close the frame, unless nothing arrived since the previous IDLE */
+	uint32_t lastEnd = (uart3DmaRxFrameHead != uart3DmaRxFrameTail) ? uart3DmaRxFrameEnds[(uart3DmaRxFrameHead - 1U) % UART3_DMA_RX_MAX_FRAMES] : uart3DmaRxRead;
+
+	if(uart3DmaRxWritten == lastEnd)
+	{
+		return;
+	}
+
+	if((uart3DmaRxFrameHead - uart3DmaRxFrameTail) >= UART3_DMA_RX_MAX_FRAMES)
+	{
+		/* No room to remember one more end: the oldest frame is merged with the next one */
+		uart3DmaRxFrameTail++;
+		uart3RxStats.framesMerged++;
+	}
+
+	uart3DmaRxFrameEnds[uart3DmaRxFrameHead % UART3_DMA_RX_MAX_FRAMES] = uart3DmaRxWritten;
+	uart3DmaRxFrameHead++;
+	uart3RxStats.frames++;
+
+	usart3_rx_frame_callback(uart3DmaRxWritten - lastEnd);
+}
+
+__attribute__((weak)) void usart3_rx_frame_callback(uint32_t length)
+{
+	(void)length;
+}
+
+/* *** STDIN BACKED BY THE DMA RECEIVER *** */
+/* ******************************************************************************************************************************************************************
+ * Explanation: _read in syscalls.c calls __io_getchar once for every character it was asked for, and newlib asks for a whole buffer of stdin (1024 characters),
+ * so scanf, fgets or getchar stall the main loop until that many characters arrived. The definitions below replace the weak ones of syscalls.c:
+ * the characters come from the ring of the DMA receiver (uart3_dma_rx_init()), _read waits at most uart3StdinTimeout for the first character
+ * and then returns only what is already there. The timeout is measured with the DWT cycle counter (dwt.c).
+ * 		UART3_READ_NONBLOCKING	never waits
+ * 		UART3_READ_FOREVER		waits for the first character, like before, but still returns as soon as at least one arrived
+ * When nothing arrived in time _read returns -1 with errno EAGAIN: newlib marks stdin with an error (getchar/scanf return EOF, fgets returns NULL)
+ * and the application has to call clearerr(stdin) before the next attempt.
+ * ******************************************************************************************************************************************************************
+ */
+void uart3_stdin_init(uint32_t timeoutMs)
+{
+	uart3_stdin_set_timeout(timeoutMs);
+
+	if(!uart3DmaRxRunning)
+	{
+		uart3_dma_rx_init();
+	}
+}
+
+void uart3_stdin_set_timeout(uint32_t timeoutMs)
+{
+	uart3StdinTimeout = timeoutMs;
+}
+
+/* Characters received and not read yet */
+uint32_t uart3_rx_available(void)
+{
+	if(!uart3DmaRxRunning)
+	{
+		return (USART3->SR & SR_RXNE) ? 1U : 0U;
+	}
+
+	return uart3_dma_rx_available();
+}
+
+/* Waits at most timeoutMs for the first character, then returns what is available up to maxLength. Returns 0 if nothing arrived in time */
+uint32_t uart3_read_timeout(uint8_t *destination, uint32_t maxLength, uint32_t timeoutMs)
+{
+	uart3_timeout_t timeout;
+
+	uart3_timeout_start(&timeout, timeoutMs);
+
+	if(maxLength == 0)
+	{
+		return 0;
+	}
+
+	for(;;)
+	{
+		if(uart3DmaRxRunning)
+		{
+			uint32_t count = uart3_dma_rx_read(destination, maxLength);
+
+			if(count != 0)
+			{
+				return count;
+			}
+		}
+		else if(USART3->SR & SR_RXNE)
+		{
+			destination[0] = (uint8_t) USART3->DR;
+			return 1;
+		}
+
+		if(uart3_timeout_expired(&timeout))
+		{
+			return 0;
+		}
+	}
+}
+
+static void uart3_timeout_start(uart3_timeout_t *timeout, uint32_t timeoutMs)
+{
+	/* Do not reset a cycle counter that somebody else is already using for measurements */
+	if(!dwt_cycle_counter_is_running())
+	{
+		dwt_cycle_counter_init();
+	}
+
+	timeout->remaining = timeoutMs;
+	timeout->cyclesPerMs = rcc_get_hclk_freq() / 1000U;
+	timeout->last = dwt_get_cycles();
+	timeout->elapsed = 0;
+}
+
+/* 0 (UART3_READ_NONBLOCKING) expires at once and UART3_READ_FOREVER never does */
+static int uart3_timeout_expired(uart3_timeout_t *timeout)
+{
+	if(timeout->remaining == 0)
+	{
+		return 1;
+	}
+
+	if(timeout->remaining == UART3_READ_FOREVER)
+	{
+		return 0;
+	}
+
+	/* Count whole milliseconds, so that a timeout longer than one turn of the 32 bit counter still works */
+	uint32_t now = dwt_get_cycles();
+	timeout->elapsed += now - timeout->last;
+	timeout->last = now;
+
+	while(timeout->elapsed >= timeout->cyclesPerMs)
+	{
+		timeout->elapsed -= timeout->cyclesPerMs;
+		timeout->remaining--;
+
+		if(timeout->remaining == 0)
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/* Returns the character or -1 if nothing arrived in time */
+int uart3_getchar_timeout(uint32_t timeoutMs)
+{
+	uint8_t character;
+
+	if(uart3_read_timeout(&character, 1, timeoutMs) == 0)
+	{
+		return -1;
+	}
+
+	return character;
+}
+
+int _read(int file, char *ptr, int len)
+{
+	(void)file;
+
+	if(len <= 0)
+	{
+		return 0;
+	}
+
+	uint32_t count = uart3_read_timeout((uint8_t *) ptr, (uint32_t) len, uart3StdinTimeout);
+
+	if(count == 0)
+	{
+		errno = EAGAIN;
+		return -1;
+	}
+
+	return (int) count;
+}
+
+int __io_getchar(void)
+{
+	return uart3_getchar_timeout(uart3StdinTimeout);
+}
+
+
+/* ******************************************************************************************************************************************************************
+ * Explanation: _write is declared weak in syscalls.c where it calls __io_putchar for every character. This definition replaces it,
+ * so that printf hands the whole buffer to the selected transmitter at once.
+ * ******************************************************************************************************************************************************************
+ */
+int _write(int file, char *ptr, int len)
+{
+	(void)file;
+
+	return uart3_write_buffer(ptr, len);
+}
+
+/* Hands a whole buffer to the transmitter selected at initialization. Returns the number of characters accepted */
+int uart3_write_buffer(const char *ptr, int len)
+{
+	if(uart3TxBackend == UART_TX_BACKEND_DMA)
+	{
+		return uart3_dma_write(ptr, len);
+	}
+
+	if(uart3TxBackend == UART_TX_BACKEND_DMA_DOUBLE_BUFFER)
+	{
+		return uart3_dbm_logger_write(ptr, len);
+	}
+
+	for(int DataIdx = 0; DataIdx < len; DataIdx++)
+	{
+		__io_putchar(*ptr++);
+	}
+
+	return len;
+}
+
+/* Like uart3_write_buffer(), but hands over only what fits right now: it never waits for room and what is left is not counted as dropped,
+ * because the caller keeps it and tries again later (logq_drain() is the sink this is written for). Returns the number of characters accepted */
+int uart3_write_partial(const char *ptr, int len)
+{
+	/* The polled transmitter has no buffer, it always takes everything */
+	if(uart3TxBackend == UART_TX_BACKEND_POLLED)
+	{
+		return uart3_write_buffer(ptr, len);
+	}
+
+	/* The room and the write have to be seen by the same critical section, an interrupt could take the room in between */
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	uint32_t space;
+
+	if(uart3TxBackend == UART_TX_BACKEND_DMA)
+	{
+		space = UART3_DMA_TX_BUFFER_SIZE - (uart3DmaTxHead - uart3DmaTxTail);
+	}
+	else if(uart3TxBackend == UART_TX_BACKEND_DMA_DOUBLE_BUFFER)
+	{
+		space = UART3_DBM_HALF_SIZE - uart3DbmFillLevel;
+	}
+	else
+	{
+		space = UART3_TX_BUFFER_SIZE - (uart3TxHead - uart3TxTail);
+	}
+
+	if((len > 0) && ((uint32_t) len > space))
+	{
+		len = (int) space;
+	}
+
+	int accepted = uart3_write_buffer(ptr, len);
+
+	__set_PRIMASK(primask);
+
+	return accepted;
+}
+
+
 char uart3_read(void)
 {
 	/* Make sure the receive data register is not empty */
-	while(!(USART3->SR & SR_RXNE))
+	while(!(USART3->SR & SR_RXNE));
 
 
-	/* Read data */
-	return  USART3->DR;
+	/* Read data. In multiprocessor mode the ninth bit marks the address character that woke this node up */
+	uint32_t data = USART3->DR;
+
+	if((USART3->CR1 & CR1_WAKE) && (data & DR_ADDRESS_MARK))
+	{
+		uart3RxStats.addresses++;
+	}
+
+	return (char) data;
 }
 
 void uart3_write(int charYouWantToWrite)
@@ -355,19 +1709,125 @@ void uart3_write(int charYouWantToWrite)
 }
 
 
-static void uart_set_baudrate(USART_TypeDef *USARTx, uint32_t PeriphClock, uint32_t BaudRate )
+/* The divider is computed from the real APB clock, see baudrate.c */
+static void uart_set_baudrate(USART_TypeDef *USARTx, uint32_t BaudRate)
+{
+	usart_baudrate_t result;
+
+	if(usart_set_baudrate(USARTx, BaudRate, USART_OVERSAMPLING_AUTO, &result) == 0)
+	{
+		if(USARTx == USART3)
+		{
+			uart3Baudrate = result.actual;
+		}
+	}
+}
+
+/* Change the baud rate of USART3 at runtime. Returns 0 on success and -1 if the baud rate cannot be generated from the APB1 clock, in which case nothing is changed.
+ * The result (optional, may be 0) tells the oversampling chosen, the value of BRR and the error of the baud rate that is really generated */
+int uart3_set_baudrate(uint32_t baudRate, uint32_t oversampling, usart_baudrate_t *result)
 {
-	USARTx->BRR = compute_uart_bd(PeriphClock, BaudRate);
+	usart_baudrate_t computed;
+
+	/* Let the character in the shift register finish before the clock of the line changes */
+	if(USART3->CR1 & CR1_UE)
+	{
+		while(!(USART3->SR & USART_SR__TC));
+	}
+
+	if(usart_set_baudrate(USART3, baudRate, oversampling, &computed) != 0)
+	{
+		if(result != 0)
+		{
+			*result = computed;
+		}
+		return -1;
+	}
+
+	uart3Baudrate = computed.actual;
+
+	if(result != 0)
+	{
+		*result = computed;
+	}
+
+	return 0;
 }
 
-static uint16_t compute_uart_bd(uint32_t PeriphClock, uint32_t BaudRate)
+/* RTS/CTS on PD12/PD11 (AF7), see usart_flow_control_init() in usart.c. flags is a combination of USART_FLOW_RTS and USART_FLOW_CTS */
+int uart3_flow_control_init(uint32_t flags)
 {
-	return ((PeriphClock + (BaudRate/2UL))/BaudRate);
+	return usart_flow_control_init(USART_PORT_3, flags);
+}
+
+/* ******************************************************************************************************************************************************************
+ * Explanation: USART3 as a node of a multi-drop bus with 9 bit address marks, see usart_multiprocessor_init() in usart.c.
+ * The receivers of uart.c keep working as they are (interrupt ring or DMA ring): in mute mode the USART raises neither RXNE nor the DMA request,
+ * so they only ever see the messages sent to this node, starting with the address character.
+ * The DMA transmitters cannot be used for the data: Info taken from RM0090: AHB/APB bridges, an 8 bit access to an APB register is turned into a 32 bit
+ * access with the byte copied in every lane, so a DMA byte written in DR would carry bit 0 of the data into the ninth bit and look like an address.
+ * For the same reason uart3_dma_tx_init() and uart3_dbm_logger_init() refuse to start while the mode is on (WAKE set in CR1).
+ * The DMA receiver stores bytes, so the ninth bit is lost there: the frames of uart_rx_stats_t are the messages, the address is their first character.
+ * uart3_read() sees the whole 9 bit character and counts the address characters in uart_rx_stats_t.addresses.
+ * Returns -1 while the transmitter is a DMA one, or for an address above USART_ADDRESS_MAX.
+ * ******************************************************************************************************************************************************************
+ */
+int uart3_multiprocessor_init(uint8_t address)
+{
+	if((uart3TxBackend == UART_TX_BACKEND_DMA) || (uart3TxBackend == UART_TX_BACKEND_DMA_DOUBLE_BUFFER))
+	{
+		return -1;
+	}
+
+	uart3RxStats.addresses = 0;
+
+	return usart_multiprocessor_init(USART_PORT_3, address);
+}
+
+int uart3_mute(void)
+{
+	return usart_mute(USART_PORT_3);
+}
+
+uint32_t uart3_is_muted(void)
+{
+	return usart_is_muted(USART_PORT_3);
+}
+
+/* Master side: the address goes out after everything still waiting in the ring buffer */
+int uart3_write_address(uint8_t address)
+{
+	while(uart3_tx_pending() != 0);
+
+	return usart_write_address(USART_PORT_3, address);
+}
+
+uint32_t uart3_get_baudrate(void)
+{
+	return uart3Baudrate;
 }
 
 int __io_putchar(int myCharacter)
 {
-	uart3_write(myCharacter);
+	if(uart3TxBackend == UART_TX_BACKEND_INTERRUPT)
+	{
+		uart3_tx_ring_put((char) myCharacter);
+	}
+	else if(uart3TxBackend == UART_TX_BACKEND_DMA)
+	{
+		char character = (char) myCharacter;
+		uart3_dma_write(&character, 1);
+	}
+	else if(uart3TxBackend == UART_TX_BACKEND_DMA_DOUBLE_BUFFER)
+	{
+		char character = (char) myCharacter;
+		uart3_dbm_logger_write(&character, 1);
+	}
+	else
+	{
+		uart3_write(myCharacter);
+	}
+
 	return myCharacter;
 }
 
@@ -0,0 +1,485 @@
+/*
+ * usart.c
+ *
+ *  Created on: 17 Oct 2026
+ *  Author: George Calin
+ *  Target Development Board: STM32 Nucleo F429ZI
+ */
+
+/* ******************************************************************************************************************************************************************
+ * One driver for all the 8 USART/UART modules of the STM32F429. Instead of a copy of uart.c for every module (with the pins of USART3 hard coded)
+ * every module is described by one line of usart_hw_table: the pins, the alternate function, the clock enable bit and the interrupt.
+ * Every port has its own handle with its own TX and RX ring buffers, and the interrupt of every module ends in usart_irq_handler() with the right handle.
+ * USART3_IRQHandler lives in uart.c, because the DMA transmitter and receiver of USART3 share it, and from there it calls usart_irq_handler(USART_PORT_3).
+ * ******************************************************************************************************************************************************************
+ */
+
+#include "usart.h"
+
+#define USART_CR1__RWU (1UL<<1)
+#define USART_CR1__RE (1UL<<2)
+#define USART_CR1__TE (1UL<<3)
+#define USART_CR1__RXNEIE (1UL<<5)
+#define USART_CR1__TXEIE (1UL<<7)
+#define USART_CR1__WAKE (1UL<<11)
+#define USART_CR1__M (1UL<<12)
+#define USART_CR1__UE (1UL<<13)
+
+#define USART_SR__PE (1UL<<0)
+#define USART_SR__FE (1UL<<1)
+#define USART_SR__NF (1UL<<2)
+#define USART_SR__ORE (1UL<<3)
+#define USART_SR__RXNE (1UL<<5)
+#define USART_SR__TXE (1UL<<7)
+#define USART_SR__TC (1UL<<6)
+#define USART_SR__ERRORS (USART_SR__PE | USART_SR__FE | USART_SR__NF | USART_SR__ORE)
+
+#define USART_CR2__ADD (0xFUL<<0)
+
+#define USART_CR3__RTSE (1UL<<8)
+#define USART_CR3__CTSE (1UL<<9)
+
+#define USART_TX_BUFFER_MASK (USART_TX_BUFFER_SIZE - 1U)
+#define USART_RX_BUFFER_MASK (USART_RX_BUFFER_SIZE - 1U)
+
+/* Info taken from the datasheet: Alternate function mapping, and from RM0090: RCC APB1/APB2 peripheral clock enable register */
+static const usart_hw_t usart_hw_table[USART_PORT_COUNT] =
+{
+	[USART_PORT_1] = {USART1, GPIOA, 9,  GPIOA, 10, 7, &RCC->APB2ENR, (1UL<<4),  USART1_IRQn, GPIOA, 11, GPIOA, 12},
+	[USART_PORT_2] = {USART2, GPIOD, 5,  GPIOD, 6,  7, &RCC->APB1ENR, (1UL<<17), USART2_IRQn, GPIOD, 3,  GPIOD, 4},
+	[USART_PORT_3] = {USART3, GPIOD, 8,  GPIOD, 9,  7, &RCC->APB1ENR, (1UL<<18), USART3_IRQn, GPIOD, 11, GPIOD, 12},
+	[UART_PORT_4]  = {UART4,  GPIOC, 10, GPIOC, 11, 8, &RCC->APB1ENR, (1UL<<19), UART4_IRQn,  0,     0,  0,     0},
+	[UART_PORT_5]  = {UART5,  GPIOC, 12, GPIOD, 2,  8, &RCC->APB1ENR, (1UL<<20), UART5_IRQn,  0,     0,  0,     0},
+	[USART_PORT_6] = {USART6, GPIOC, 6,  GPIOC, 7,  8, &RCC->APB2ENR, (1UL<<5),  USART6_IRQn, GPIOG, 15, GPIOG, 12},
+	[UART_PORT_7]  = {UART7,  GPIOE, 8,  GPIOE, 7,  8, &RCC->APB1ENR, (1UL<<30), UART7_IRQn,  0,     0,  0,     0},
+	[UART_PORT_8]  = {UART8,  GPIOE, 1,  GPIOE, 0,  8, &RCC->APB1ENR, (1UL<<31), UART8_IRQn,  0,     0,  0,     0},
+};
+
+static usart_handle_t usart_handles[USART_PORT_COUNT];
+
+static void usart_pin_init(GPIO_TypeDef *port, uint8_t pin, uint8_t alternateFunction);
+
+/* Returns the handle of the port, or 0 if the baud rate cannot be generated from the clock of the module */
+usart_handle_t *usart_open(usart_port_t port, uint32_t baudRate)
+{
+	if(port >= USART_PORT_COUNT)
+	{
+		return 0;
+	}
+
+	usart_handle_t *handle = &usart_handles[port];
+	const usart_hw_t *hw = &usart_hw_table[port];
+	usart_baudrate_t baudrate;
+
+	/* The baud rate is checked against the clock of the bus before the pins, the handle or the module are touched, so a refused open leaves them as they were */
+	if(usart_compute_baudrate(usart_get_clock(hw->instance), baudRate, USART_OVERSAMPLING_AUTO, &baudrate) != 0)
+	{
+		return 0;
+	}
+
+	handle->hw = hw;
+	handle->port = port;
+	handle->txHead = 0;
+	handle->txTail = 0;
+	handle->rxHead = 0;
+	handle->rxTail = 0;
+	handle->stats.txDropped = 0;
+	handle->stats.rxDropped = 0;
+	handle->stats.rxErrors = 0;
+	handle->stats.rxAddresses = 0;
+
+	/* *** CONFIGURE THE GPIO PINS *** */
+	usart_pin_init(hw->txPort, hw->txPin, hw->alternateFunction);
+	usart_pin_init(hw->rxPort, hw->rxPin, hw->alternateFunction);
+
+	/* **** Configure the USART Module *** */
+	/* Enable clock access to the module */
+	*hw->clockEnableRegister |= hw->clockEnableBit;
+
+	/* Configure the transfer direction, 8 data bits, 1 stop bit, no parity, with the receiver interrupt enabled */
+	hw->instance->CR1 = (USART_CR1__TE | USART_CR1__RE | USART_CR1__RXNEIE);
+	hw->instance->CR2 = 0;
+	hw->instance->CR3 = 0;
+
+	/* Configure the baudrate from the real clock of the bus the module sits on, it has already been checked above */
+	usart_set_baudrate(hw->instance, baudRate, USART_OVERSAMPLING_AUTO, &handle->baudrate);
+
+	handle->opened = 1;
+
+	/* Enable the interrupt in NVIC */
+	NVIC_EnableIRQ(hw->irq);
+
+	/* Enable the module */
+	hw->instance->CR1 |= USART_CR1__UE;
+
+	return handle;
+}
+
+void usart_close(usart_handle_t *handle)
+{
+	NVIC_DisableIRQ(handle->hw->irq);
+	handle->hw->instance->CR1 = 0;
+	handle->opened = 0;
+}
+
+/* Non blocking: returns the number of characters placed in the TX buffer, the interrupt sends them */
+uint32_t usart_write(usart_handle_t *handle, const uint8_t *data, uint32_t length)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	uint32_t space = USART_TX_BUFFER_SIZE - (handle->txHead - handle->txTail);
+	uint32_t count = (length > space) ? space : length;
+
+	for(uint32_t i = 0; i < count; i++)
+	{
+		handle->txBuffer[(handle->txHead + i) & USART_TX_BUFFER_MASK] = data[i];
+	}
+	handle->txHead += count;
+	handle->stats.txDropped += length - count;
+
+	/* TXEIE is set only while there is something to send */
+	if(count != 0)
+	{
+		handle->hw->instance->CR1 |= USART_CR1__TXEIE;
+	}
+
+	__set_PRIMASK(primask);
+
+	return count;
+}
+
+/* Non blocking: returns the number of characters copied from the RX buffer */
+uint32_t usart_read(usart_handle_t *handle, uint8_t *destination, uint32_t maxLength)
+{
+	uint32_t count = handle->rxHead - handle->rxTail;
+
+	if(count > maxLength)
+	{
+		count = maxLength;
+	}
+
+	/* Only the interrupt moves rxHead and only the application moves rxTail, so no masking is needed here */
+	for(uint32_t i = 0; i < count; i++)
+	{
+		destination[i] = handle->rxBuffer[(handle->rxTail + i) & USART_RX_BUFFER_MASK];
+	}
+	handle->rxTail += count;
+
+	return count;
+}
+
+uint32_t usart_rx_available(usart_handle_t *handle)
+{
+	return handle->rxHead - handle->rxTail;
+}
+
+uint32_t usart_tx_pending(usart_handle_t *handle)
+{
+	return handle->txHead - handle->txTail;
+}
+
+void usart_get_stats(usart_handle_t *handle, usart_stats_t *stats)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	stats->txDropped = handle->stats.txDropped;
+	stats->rxDropped = handle->stats.rxDropped;
+	stats->rxErrors = handle->stats.rxErrors;
+	stats->rxAddresses = handle->stats.rxAddresses;
+
+	__set_PRIMASK(primask);
+}
+
+/* ******************************************************************************************************************************************************************
+ * Explanation: This info is extracted from RM0090: Status register (USART_SR)
+ * 		Bit 5 RXNE: Read data register not empty, cleared by a read to the USART_DR register
+ * 		Bit 7 TXE: Transmit data register empty, cleared by a write to the USART_DR register
+ * 		Bits 3:0 ORE, NF, FE, PE: errors, cleared by a read to the USART_SR register followed by a read to the USART_DR register
+ * ******************************************************************************************************************************************************************
+ */
+void usart_irq_handler(usart_port_t port)
+{
+	usart_handle_t *handle = &usart_handles[port];
+
+	if(!handle->opened)
+	{
+		return;
+	}
+
+	USART_TypeDef *usart = handle->hw->instance;
+	uint32_t status = usart->SR;
+
+	if(status & (USART_SR__RXNE | USART_SR__ORE))
+	{
+		/* Reading DR clears RXNE as well as the error flags we have just read in SR */
+		uint32_t data = usart->DR;
+		uint8_t character = (uint8_t) data;
+
+		if(status & USART_SR__ERRORS)
+		{
+			handle->stats.rxErrors++;
+		}
+
+		/* Only in 9 bit mode: the address that woke us up. It is kept in the buffer, so the application sees where a message starts */
+		if((usart->CR1 & USART_CR1__M) && (data & USART_ADDRESS_MARK))
+		{
+			handle->stats.rxAddresses++;
+		}
+
+		if((handle->rxHead - handle->rxTail) < USART_RX_BUFFER_SIZE)
+		{
+			handle->rxBuffer[handle->rxHead & USART_RX_BUFFER_MASK] = character;
+			handle->rxHead++;
+		}
+		else
+		{
+			handle->stats.rxDropped++;
+		}
+	}
+
+	if((usart->CR1 & USART_CR1__TXEIE) && (status & USART_SR__TXE))
+	{
+		if(handle->txHead != handle->txTail)
+		{
+			usart->DR = handle->txBuffer[handle->txTail & USART_TX_BUFFER_MASK];
+			handle->txTail++;
+		}
+		else
+		{
+			usart->CR1 &=~USART_CR1__TXEIE;
+		}
+	}
+}
+
+/* ******************************************************************************************************************************************************************
+ * Explanation: Info taken from RM0090: Hardware flow control and Control register 3 (USART_CR3)
+ * 		Bit 9 CTSE: CTS enable. The transmitter sends a new character only while nCTS is low (asserted). If nCTS goes high while a character is being sent,
+ * 		that character is completed and the transmitter stops, TXE stays '0' and nothing else is lost.
+ * 		Bit 8 RTSE: RTS enable. nRTS is low while the receiver can take a character and goes high as soon as one is received, until it is read from DR.
+ * 		This bit is not available for UART4, UART5, UART7 and UART8.
+ * Because TXE stays '0' while nCTS is high, the DMA gets no request and the TXE interrupt does not fire: both the DMA and the interrupt transmitters simply
+ * pause with their data still in the buffers and continue when the host asserts nCTS again.
+ * Returns -1 for the ports without flow control.
+ * ******************************************************************************************************************************************************************
+ */
+int usart_flow_control_init(usart_port_t port, uint32_t flags)
+{
+	if(port >= USART_PORT_COUNT)
+	{
+		return -1;
+	}
+
+	const usart_hw_t *hw = &usart_hw_table[port];
+
+	if((hw->ctsPort == 0) && (flags != USART_FLOW_NONE))
+	{
+		return -1;
+	}
+
+	if(flags & USART_FLOW_CTS)
+	{
+		usart_pin_init(hw->ctsPort, hw->ctsPin, hw->alternateFunction);
+	}
+
+	if(flags & USART_FLOW_RTS)
+	{
+		usart_pin_init(hw->rtsPort, hw->rtsPin, hw->alternateFunction);
+	}
+
+	/* Let the last character leave before the module is stopped for the change */
+	uint32_t enabled = hw->instance->CR1 & USART_CR1__UE;
+
+	if(enabled)
+	{
+		while(!(hw->instance->SR & USART_SR__TC));
+		hw->instance->CR1 &=~USART_CR1__UE;
+	}
+
+	hw->instance->CR3 &=~(USART_CR3__RTSE | USART_CR3__CTSE);
+
+	if(flags & USART_FLOW_CTS)
+	{
+		hw->instance->CR3 |= USART_CR3__CTSE;
+	}
+
+	if(flags & USART_FLOW_RTS)
+	{
+		hw->instance->CR3 |= USART_CR3__RTSE;
+	}
+
+	hw->instance->CR1 |= enabled;
+
+	return 0;
+}
+
+/* Returns 1 when the other side lets us send (nCTS low) or when there is no flow control, 0 when the transmitter is held */
+uint32_t usart_cts_is_clear(usart_port_t port)
+{
+	const usart_hw_t *hw = &usart_hw_table[port];
+
+	if((hw->ctsPort == 0) || !(hw->instance->CR3 & USART_CR3__CTSE))
+	{
+		return 1;
+	}
+
+	return (hw->ctsPort->IDR & (1UL << hw->ctsPin)) ? 0U : 1U;
+}
+
+/* ******************************************************************************************************************************************************************
+ * Explanation: Info taken from RM0090: Multiprocessor communication, and Control registers 1 and 2 (USART_CR1, USART_CR2)
+ * 		Bit 12 M: word length, '1' = 9 data bits. The ninth bit (MSB) tells an address character ('1') from a data character ('0').
+ * 		Bit 11 WAKE: wakeup method, '1' = address mark.
+ * 		Bit 1 RWU: receiver in mute mode. While it is set no receive status bit is set: no RXNE, so neither an interrupt nor a DMA request.
+ * 		CR2 bits 3:0 ADD: the address of the node.
+ * Every node of a multi-drop bus (RS-485) listens to every character. In address mark mode the USART itself compares the 4 low bits of every address
+ * character with ADD: if they are the same it clears RWU and receives that address and the data after it normally, otherwise it sets RWU and drops
+ * everything until the next address character. A node only takes the interrupts of the messages sent to it, the messages to the other N-1 nodes
+ * cost it nothing. The node starts muted.
+ * The master sends the address with usart_write_address() and the data with usart_write(), whose characters have the ninth bit at '0'.
+ * On a PC the ninth bit is the parity bit set to mark (address) or space (data).
+ * Returns -1 for an unknown port or an address above USART_ADDRESS_MAX.
+ * ******************************************************************************************************************************************************************
+ */
+int usart_multiprocessor_init(usart_port_t port, uint8_t address)
+{
+	if((port >= USART_PORT_COUNT) || (address > USART_ADDRESS_MAX))
+	{
+		return -1;
+	}
+
+	USART_TypeDef *usart = usart_hw_table[port].instance;
+
+	/* M and WAKE can change only with the module stopped, let the last character leave first */
+	uint32_t enabled = usart->CR1 & USART_CR1__UE;
+
+	if(enabled)
+	{
+		while(!(usart->SR & USART_SR__TC));
+		usart->CR1 &=~USART_CR1__UE;
+	}
+
+	usart->CR2 &=~USART_CR2__ADD;
+	usart->CR2 |= address;
+	usart->CR1 |= (USART_CR1__M | USART_CR1__WAKE);
+
+	usart->CR1 |= enabled;
+
+	/* Wait for the first address character */
+	while(usart_mute(port) != 0)
+	{
+		(void) usart->DR;
+	}
+
+	return 0;
+}
+
+/* Ignore the rest of the current message, until the next address character for this node. The USART does it on its own when the next message
+ * is for another node, this is for a node that knows early that the message does not interest it.
+ * Returns -1 while a character is waiting in DR: with WAKE = 1 RWU cannot be written while RXNE is set */
+int usart_mute(usart_port_t port)
+{
+	USART_TypeDef *usart = usart_hw_table[port].instance;
+
+	if(usart->SR & USART_SR__RXNE)
+	{
+		return -1;
+	}
+
+	usart->CR1 |= USART_CR1__RWU;
+
+	return 0;
+}
+
+uint32_t usart_is_muted(usart_port_t port)
+{
+	return (usart_hw_table[port].instance->CR1 & USART_CR1__RWU) ? 1U : 0U;
+}
+
+/* Master side: sends an address character, after the characters still waiting in the TX buffer of the port. Blocking, returns -1 for a bad address */
+int usart_write_address(usart_port_t port, uint8_t address)
+{
+	if((port >= USART_PORT_COUNT) || (address > USART_ADDRESS_MAX))
+	{
+		return -1;
+	}
+
+	usart_handle_t *handle = &usart_handles[port];
+	USART_TypeDef *usart = usart_hw_table[port].instance;
+
+	for(;;)
+	{
+		uint32_t primask = __get_PRIMASK();
+		__disable_irq();
+
+		/* The interrupt cannot slip a data character in between the check and the write */
+		if(((!handle->opened) || (handle->txHead == handle->txTail)) && (usart->SR & USART_SR__TXE))
+		{
+			usart->DR = USART_ADDRESS_MARK | address;
+			__set_PRIMASK(primask);
+			return 0;
+		}
+
+		__set_PRIMASK(primask);
+	}
+}
+
+/* Set the pin in alternate function mode. Info taken from RM0090: GPIO port mode register (GPIOx_MODER), GPIO alternate function low/high register (GPIOx_AFRL/AFRH) */
+static void usart_pin_init(GPIO_TypeDef *port, uint8_t pin, uint8_t alternateFunction)
+{
+	/* Enable clock access to the GPIO port. The ports are 0x400 apart starting from GPIOA, in the same order as the enable bits in RCC_AHB1ENR */
+	RCC->AHB1ENR |= (1UL << (((uint32_t) port - GPIOA_BASE) >> 10));
+
+	/* Mode '10': alternate function */
+	port->MODER &=~(3UL << (pin * 2U));
+	port->MODER |= (2UL << (pin * 2U));
+
+	/* Speed '10': high speed, so that the edges stay sharp at several Mbaud */
+	port->OSPEEDR &=~(3UL << (pin * 2U));
+	port->OSPEEDR |= (2UL << (pin * 2U));
+
+	/* Pull-up, so that an RX pin left open reads as an idle line instead of noise */
+	port->PUPDR &=~(3UL << (pin * 2U));
+	port->PUPDR |= (1UL << (pin * 2U));
+
+	/* Alternate function number in AFR[0] for the pins 0..7 and in AFR[1] for the pins 8..15, 4 bits per pin */
+	port->AFR[pin >> 3] &=~(0xFUL << ((pin & 7U) * 4U));
+	port->AFR[pin >> 3] |= ((uint32_t) alternateFunction << ((pin & 7U) * 4U));
+}
+
+/* Interrupt service routines, the names come from the vector table in Startup > startup_stm32f429zitx.s */
+void USART1_IRQHandler(void)
+{
+	usart_irq_handler(USART_PORT_1);
+}
+
+void USART2_IRQHandler(void)
+{
+	usart_irq_handler(USART_PORT_2);
+}
+
+void UART4_IRQHandler(void)
+{
+	usart_irq_handler(UART_PORT_4);
+}
+
+void UART5_IRQHandler(void)
+{
+	usart_irq_handler(UART_PORT_5);
+}
+
+void USART6_IRQHandler(void)
+{
+	usart_irq_handler(USART_PORT_6);
+}
+
+void UART7_IRQHandler(void)
+{
+	usart_irq_handler(UART_PORT_7);
+}
+
+void UART8_IRQHandler(void)
+{
+	usart_irq_handler(UART_PORT_8);
+}
@@ -0,0 +1,144 @@
+#!/usr/bin/env python3
+"""
+dlog_decode.py
+
+Host side decoder for the deferred logger (Inc/dlog.h).
+
+The MCU sends, for every DLOG() call, a COBS frame terminated by 0x00 with:
+    ID (2 bytes, little endian) | arguments (4 bytes each, little endian)
+The ID is the address of the format string in the section .logstr of the ELF file,
+which starts at address 0 and is not loaded in the MCU. This script reads that section
+from the ELF file of the firmware and rebuilds the messages.
+
+Usage:
+    python3 dlog_decode.py Debug/DMA_UART_Tx_Driver.elf capture.bin
+    python3 dlog_decode.py Debug/DMA_UART_Tx_Driver.elf --port /dev/ttyACM0 --baud 115200   (needs pyserial)
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+# %[flags][width][.precision][length]conversion
+FORMAT_SPECIFIER = re.compile(r"%(%|[-+ #0]*\d*(?:\.\d+)?(?:hh|h|ll|l|z|t)?([diuxXcp]))")
+
+
+def read_logstr_section(elf_path):
+    with open(elf_path, "rb") as elf_file:
+        elf = elf_file.read()
+    if elf[:4] != b"\x7fELF" or elf[4] != 1 or elf[5] != 1:
+        raise ValueError("%s is not a 32 bit little endian ELF file" % elf_path)
+    (section_offset,) = struct.unpack_from("<I", elf, 0x20)
+    section_size, section_count, names_index = struct.unpack_from("<HHH", elf, 0x2E)
+
+    def header(index):
+        # name, type, flags, address, offset, size
+        return struct.unpack_from("<IIIIII", elf, section_offset + index * section_size)
+
+    names_offset = header(names_index)[4]
+    for index in range(section_count):
+        name, _, _, address, offset, size = header(index)
+        end = elf.index(b"\0", names_offset + name)
+        if elf[names_offset + name:end] == b".logstr":
+            return address, elf[offset:offset + size]
+    raise ValueError("no .logstr section in %s" % elf_path)
+
+
+def cobs_decode(encoded):
+    out = bytearray()
+    i = 0
+    while i < len(encoded):
+        code = encoded[i]
+        if code == 0 or i + code > len(encoded) + 1:
+            raise ValueError("corrupted COBS block")
+        out += encoded[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(encoded):
+            out.append(0)
+    return bytes(out)
+
+
+class Decoder:
+    def __init__(self, base, strings):
+        self.base = base
+        self.strings = strings
+        self.pending = bytearray()
+        self.errors = 0
+
+    def format_string(self, identifier):
+        offset = identifier - self.base
+        if offset < 0 or offset >= len(self.strings):
+            raise ValueError("unknown ID 0x%04x" % identifier)
+        end = self.strings.index(b"\0", offset)
+        return self.strings[offset:end].decode("utf-8", "replace")
+
+    def render(self, record):
+        if len(record) < 2 or (len(record) - 2) % 4:
+            raise ValueError("bad record length %d" % len(record))
+        (identifier,) = struct.unpack_from("<H", record, 0)
+        arguments = [value for (value,) in struct.iter_unpack("<I", record[2:])]
+        text = self.format_string(identifier)
+
+        def substitute(match):
+            if match.group(1) == "%":
+                return "%"
+            if not arguments:
+                raise ValueError("not enough arguments for %r" % text)
+            value = arguments.pop(0)
+            conversion = match.group(2)
+            specifier = match.group(0)
+            specifier = re.sub(r"(hh|h|ll|l|z|t)(?=[diuxXcp]$)", "", specifier)
+            if conversion in "di":
+                value = value - (1 << 32) if value & 0x80000000 else value
+                specifier = specifier[:-1] + "d"
+            elif conversion == "u":
+                specifier = specifier[:-1] + "d"
+            elif conversion == "p":
+                specifier = "0x%08x"
+            return specifier % value
+
+        return FORMAT_SPECIFIER.sub(substitute, text)
+
+    def feed(self, data):
+        for byte in data:
+            if byte != 0:
+                self.pending.append(byte)
+                continue
+            if self.pending:
+                try:
+                    sys.stdout.write(self.render(cobs_decode(bytes(self.pending))))
+                    sys.stdout.flush()
+                except ValueError as error:
+                    self.errors += 1
+                    print("# bad frame: %s" % error, file=sys.stderr)
+            self.pending.clear()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("elf", help="ELF file of the firmware that produced the log")
+    parser.add_argument("file", nargs="?", help="binary capture, standard input if omitted")
+    parser.add_argument("--port", help="serial port to read from")
+    parser.add_argument("--baud", type=int, default=115200)
+    args = parser.parse_args()
+
+    base, strings = read_logstr_section(args.elf)
+    decoder = Decoder(base, strings)
+    try:
+        if args.port:
+            import serial
+            with serial.Serial(args.port, args.baud, timeout=1) as port:
+                while True:
+                    decoder.feed(port.read(4096))
+        else:
+            stream = open(args.file, "rb") if args.file else sys.stdin.buffer
+            with stream:
+                decoder.feed(stream.read())
+    except KeyboardInterrupt:
+        pass
+    print("# frames with errors: %d" % decoder.errors, file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,168 @@
+#!/usr/bin/env python3
+"""
+telemetry_decode.py
+
+Host side decoder for the COBS framed binary telemetry sent by Src/telemetry.c.
+
+Every frame on the line is COBS encoded and terminated by 0x00. Once decoded it is:
+    type (1) | sequence (1) | payload length (2, little endian) | payload | CRC32 (4, little endian)
+The CRC is the one of the STM32F4 CRC unit: polynomial 0x04C11DB7, initial value 0xFFFFFFFF,
+no reflection, no final XOR, computed over little endian 32 bit words with zero padding.
+The _DELTA records carry the same samples as ADC and ACCEL, each one as a zig-zag varint of its difference
+from the previous sample of the same channel, starting from 0 in every record.
+A STATS record carries the counters of telemetry_get_stats(): samples, raw bytes, sent bytes,
+compression ratio in percent and cycles per sample spent in the delta encoder.
+
+Usage:
+    python3 telemetry_decode.py capture.bin          (a file captured from the serial port)
+    python3 telemetry_decode.py --port /dev/ttyACM0 --baud 115200   (needs pyserial)
+"""
+
+import argparse
+import struct
+import sys
+
+TYPE_RAW = 0x00
+TYPE_ADC = 0x01
+TYPE_ACCEL = 0x02
+TYPE_ADC_DELTA = 0x03
+TYPE_ACCEL_DELTA = 0x04
+TYPE_STATS = 0x05
+
+
+def crc32_stm32(data):
+    data = bytes(data) + bytes((-len(data)) % 4)
+    crc = 0xFFFFFFFF
+    for (word,) in struct.iter_unpack("<I", data):
+        crc ^= word
+        for _ in range(32):
+            if crc & 0x80000000:
+                crc = ((crc << 1) ^ 0x04C11DB7) & 0xFFFFFFFF
+            else:
+                crc = (crc << 1) & 0xFFFFFFFF
+    return crc
+
+
+def cobs_decode(encoded):
+    out = bytearray()
+    i = 0
+    while i < len(encoded):
+        code = encoded[i]
+        if code == 0 or i + code > len(encoded) + 1:
+            raise ValueError("corrupted COBS block")
+        out += encoded[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(encoded):
+            out.append(0)
+    return bytes(out)
+
+
+def decode_frame(encoded):
+    frame = cobs_decode(encoded)
+    if len(frame) < 8:
+        raise ValueError("frame too short")
+    record_type, sequence, length = struct.unpack_from("<BBH", frame, 0)
+    if len(frame) != 4 + length + 4:
+        raise ValueError("length mismatch")
+    payload = frame[4:4 + length]
+    (crc,) = struct.unpack_from("<I", frame, 4 + length)
+    if crc != crc32_stm32(frame[:4 + length]):
+        raise ValueError("CRC mismatch")
+    return record_type, sequence, payload
+
+
+def delta_decode(payload, channels):
+    values = []
+    previous = [0] * channels
+    value = 0
+    shift = 0
+    for byte in payload:
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if byte & 0x80:
+            continue
+        channel = len(values) % channels
+        previous[channel] += (value >> 1) ^ -(value & 1)
+        values.append(previous[channel])
+        value = 0
+        shift = 0
+    if shift != 0 or len(values) % channels != 0:
+        raise ValueError("truncated delta record")
+    return values
+
+
+def describe(record_type, payload):
+    if record_type == TYPE_ADC_DELTA:
+        return "ADC " + " ".join(str(v) for v in delta_decode(payload, 1))
+    if record_type == TYPE_ACCEL_DELTA:
+        v = delta_decode(payload, 3)
+        return "ACCEL " + " ".join("(%d,%d,%d)" % tuple(v[i:i + 3]) for i in range(0, len(v), 3))
+    if record_type == TYPE_STATS:
+        samples, raw, sent, ratio, cycles = struct.unpack("<5I", payload)
+        return "STATS samples=%d raw_bytes=%d sent_bytes=%d ratio=%d.%02d cycles_per_sample=%d" % (
+            samples, raw, sent, ratio // 100, ratio % 100, cycles)
+    if record_type == TYPE_ADC:
+        return "ADC " + " ".join(str(v) for (v,) in struct.iter_unpack("<H", payload))
+    if record_type == TYPE_ACCEL:
+        return "ACCEL " + " ".join("(%d,%d,%d)" % xyz for xyz in struct.iter_unpack("<hhh", payload))
+    return "RAW " + payload.hex()
+
+
+class Decoder:
+    def __init__(self):
+        self.pending = bytearray()
+        self.expected_sequence = None
+        self.errors = 0
+        self.lost = 0
+
+    def feed(self, data):
+        for byte in data:
+            if byte != 0:
+                self.pending.append(byte)
+                continue
+            if self.pending:
+                self.handle(bytes(self.pending))
+            self.pending.clear()
+
+    def handle(self, encoded):
+        try:
+            record_type, sequence, payload = decode_frame(encoded)
+        except ValueError as error:
+            self.errors += 1
+            print("# bad frame: %s" % error, file=sys.stderr)
+            return
+        if self.expected_sequence is not None and sequence != self.expected_sequence:
+            self.lost += (sequence - self.expected_sequence) & 0xFF
+        self.expected_sequence = (sequence + 1) & 0xFF
+        try:
+            print("%3d %s" % (sequence, describe(record_type, payload)))
+        except ValueError as error:
+            self.errors += 1
+            print("# bad record: %s" % error, file=sys.stderr)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("file", nargs="?", help="binary capture, standard input if omitted")
+    parser.add_argument("--port", help="serial port to read from")
+    parser.add_argument("--baud", type=int, default=115200)
+    args = parser.parse_args()
+
+    decoder = Decoder()
+    try:
+        if args.port:
+            import serial
+            with serial.Serial(args.port, args.baud, timeout=1) as port:
+                while True:
+                    decoder.feed(port.read(4096))
+        else:
+            stream = open(args.file, "rb") if args.file else sys.stdin.buffer
+            with stream:
+                decoder.feed(stream.read())
+    except KeyboardInterrupt:
+        pass
+    print("# frames with errors: %d, records lost: %d" % (decoder.errors, decoder.lost), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,51 @@
+/*
+ * modbus.h
+ *
+ *  Created on: 17 Oct 2026
+ *  Author: George Calin
+ *  Target Development Board: STM32 Nucleo F429ZI
+ */
+
+#ifndef MODBUS_H_
+#define MODBUS_H_
+
+#include <stm32f429xx.h>
+#include <stdint.h>
+
+#define MODBUS_FRAME_SIZE (256U)				// the longest RTU frame: address, PDU of 253 bytes, CRC
+#define MODBUS_COILS (32U)						// function codes 0x01, 0x05, 0x0F
+#define MODBUS_HOLDING_REGISTERS (32U)			// function codes 0x03, 0x06, 0x10
+#define MODBUS_INPUT_REGISTERS (16U)			// function code 0x04
+#define MODBUS_BROADCAST_ADDRESS (0U)			// executed by every slave, never answered
+
+/* Exception codes of the Modbus application protocol */
+#define MODBUS_EXCEPTION_ILLEGAL_FUNCTION (0x01)
+#define MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS (0x02)
+#define MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE (0x03)
+
+typedef struct
+{
+	uint32_t frames;			// frames closed by the 3.5 character silence
+	uint32_t crcErrors;
+	uint32_t otherAddress;		// frames for another slave, dropped
+	uint32_t exceptions;		// answered with an exception
+	uint32_t overruns;			// frames longer than MODBUS_FRAME_SIZE, dropped
+	uint32_t lastLatencyCycles;	// from the end of the silence until the answer was handed to the DMA
+	uint32_t worstLatencyCycles;
+} modbus_stats_t;
+
+int modbus_init(uint8_t address, uint32_t baudRate);
+void modbus_get_stats(modbus_stats_t *stats);
+
+/* The register map lives in static tables inside modbus.c, the application reaches it through these */
+void modbus_set_input_register(uint32_t index, uint16_t value);
+uint16_t modbus_get_holding_register(uint32_t index);
+void modbus_set_holding_register(uint32_t index, uint16_t value);
+uint32_t modbus_get_coil(uint32_t index);
+void modbus_set_coil(uint32_t index, uint32_t value);
+
+/* Called from TIM2_IRQHandler after the master wrote coils or holding registers [first, first + count) */
+void modbus_coils_written_callback(uint32_t first, uint32_t count);
+void modbus_holding_registers_written_callback(uint32_t first, uint32_t count);
+
+#endif /* MODBUS_H_ */
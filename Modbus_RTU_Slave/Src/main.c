@@ -0,0 +1,88 @@
+/**
+ ******************************************************************************
+ * @file           : main.c
+ * @author         : George Calin
+ * @brief          : Main program body
+ * Target board: Nucleo 144 family
+ *
+ * Notes: User LD3: a red user LED is connected to PB14 on the Nucleo 144 family boards
+ * User LD2: a blue user LED is connected to PB7.
+ * Modbus RTU slave with address 1 on USART3 (the virtual COM port of the ST-LINK), 115200 baud, 8 data bits, even parity, 1 stop bit.
+ * 		coil 0: the blue user LED LD2
+ * 		input registers 0 to 5: frames, CRC errors, exceptions, overruns, last and worst latency in cycles of the CPU
+ * 		input register 6: counts the turns of the main loop, it shows that the main loop is free while the frames are handled
+ * 		holding registers: free for the master, they are written and read back
+ * Test from a PC, for example: mbpoll -m rtu -b 115200 -P even -a 1 -t 3 -r 1 -c 7 /dev/ttyACM0
+ * Only modbus.c and this file belong to the project: the USART3 and DMA drivers, the startup file and the linker scripts are those of
+ * DMA_UART_Tx_Driver, linked in the Drivers folder (.project).
+ ******************************************************************************
+ */
+
+#include "modbus.h"
+
+#define GPIOB_ENABLE (1UL<<1)
+#define PIN7	(1UL<<7)
+#define LED_PIN	PIN7
+
+#define MODBUS_SLAVE_ADDRESS (1U)
+#define MODBUS_BAUDRATE (115200U)
+#define MODBUS_LED_COIL (0U)
+
+static uint16_t clamp16(uint32_t value);
+
+int main(void)
+{
+	modbus_stats_t stats;
+	uint32_t loops = 0;
+
+	/* Enable clock access to GPIOB */
+	RCC->AHB1ENR |= GPIOB_ENABLE;
+
+	/* Set the mode in the MODER registry to output for port B7 */
+	GPIOB->MODER &=~(1UL<<15); //'0'
+	GPIOB->MODER |=(1UL<<14); //'1'
+
+	if(modbus_init(MODBUS_SLAVE_ADDRESS, MODBUS_BAUDRATE) != 0)
+	{
+		/* The baud rate cannot be generated from this clock: the LED stays on */
+		GPIOB->ODR |= LED_PIN;
+		for(;;);
+	}
+
+	for(;;)
+	{
+		/* The frames are handled in TIM2_IRQHandler, the main loop only publishes the counters */
+		modbus_get_stats(&stats);
+
+		modbus_set_input_register(0, clamp16(stats.frames));
+		modbus_set_input_register(1, clamp16(stats.crcErrors));
+		modbus_set_input_register(2, clamp16(stats.exceptions));
+		modbus_set_input_register(3, clamp16(stats.overruns));
+		modbus_set_input_register(4, clamp16(stats.lastLatencyCycles));
+		modbus_set_input_register(5, clamp16(stats.worstLatencyCycles));
+		modbus_set_input_register(6, (uint16_t) loops++);
+	}
+}
+
+/* Runs in TIM2_IRQHandler, right after the master wrote the coils */
+void modbus_coils_written_callback(uint32_t first, uint32_t count)
+{
+	if((MODBUS_LED_COIL < first) || (MODBUS_LED_COIL >= (first + count)))
+	{
+		return;
+	}
+
+	if(modbus_get_coil(MODBUS_LED_COIL))
+	{
+		GPIOB->ODR |= LED_PIN;
+	}
+	else
+	{
+		GPIOB->ODR &=~(LED_PIN);
+	}
+}
+
+static uint16_t clamp16(uint32_t value)
+{
+	return (value > 0xFFFFU) ? 0xFFFFU : (uint16_t) value;
+}
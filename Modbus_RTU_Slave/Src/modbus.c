@@ -0,0 +1,486 @@
+/*
+ * modbus.c
+ *
+ *  Created on: 17 Oct 2026
+ *  Author: George Calin
+ *  Target Development Board: STM32 Nucleo F429ZI
+ */
+
+/* ******************************************************************************************************************************************************************
+ * Modbus RTU slave on USART3 (PD8 TX, PD9 RX), built on the DMA driver of uart.c:
+ * 		- reception: DMA1 Stream1 fills the ring of uart3_dma_rx_init(), the CPU does not see the single characters
+ * 		- end of frame: in RTU a frame ends with a silence of 3.5 characters. The IDLE interrupt of USART3 tells that the line has been silent for
+ * 		  one character, usart3_rx_frame_callback() then starts TIM2 in one pulse mode for the rest of the silence. If no character arrived meanwhile
+ * 		  when TIM2 expires, the frame is complete. Above 19200 baud the specification fixes the silence at 1750 us instead of 3.5 characters.
+ * 		- the request is checked and answered inside TIM2_IRQHandler, from static buffers, and the answer goes out through the DMA transmitter.
+ * 		  The work depends only on the length of the frame (at most 256 bytes, CRC with a table), so the latency from the end of the silence
+ * 		  to the first character of the answer is bounded and small, it is measured with the DWT cycle counter (modbus_stats_t).
+ * The characters are 8 data bits, even parity, 1 stop bit: the default of the Modbus serial line specification (11 bits per character).
+ * ******************************************************************************************************************************************************************
+ */
+
+#include "modbus.h"
+#include "uart.h"
+#include "dwt.h"
+
+#define RCC_APB1ENR__TIM2EN (1UL<<0)
+#define RCC_CFGR__PPRE1_DIVIDED (1UL<<12) // PPRE1 = 1xx: APB1 clock divided, the timers then run at twice PCLK1
+#define TIM_CR1__CEN (1UL<<0)
+#define TIM_CR1__URS (1UL<<2)
+#define TIM_CR1__OPM (1UL<<3)
+#define TIM_DIER__UIE (1UL<<0)
+#define TIM_SR__UIF (1UL<<0)
+#define TIM_EGR__UG (1UL<<0)
+
+#define CR1_UE (1UL<<13)
+#define USART_CR1__M (1UL<<12)
+#define USART_CR1__PCE (1UL<<10)
+#define USART_SR__TC (1UL<<6)
+
+#define MODBUS_BITS_PER_CHARACTER (11U)			// start, 8 data, parity, stop
+#define MODBUS_FIXED_SILENCE_US (1750U)			// t3.5 above 19200 baud
+#define MODBUS_CRC_POLYNOMIAL (0xA001U)			// 0x8005 reflected
+#define MODBUS_MAX_READ_REGISTERS (125U)
+#define MODBUS_MAX_WRITE_REGISTERS (123U)
+#define MODBUS_MAX_READ_COILS (2000U)
+#define MODBUS_MAX_WRITE_COILS (1968U)
+
+#define MODBUS_READ_COILS (0x01)
+#define MODBUS_READ_HOLDING_REGISTERS (0x03)
+#define MODBUS_READ_INPUT_REGISTERS (0x04)
+#define MODBUS_WRITE_SINGLE_COIL (0x05)
+#define MODBUS_WRITE_SINGLE_REGISTER (0x06)
+#define MODBUS_WRITE_MULTIPLE_COILS (0x0F)
+#define MODBUS_WRITE_MULTIPLE_REGISTERS (0x10)
+
+/* The register map */
+static uint8_t modbusCoils[(MODBUS_COILS + 7U) / 8U];
+static uint16_t modbusHoldingRegisters[MODBUS_HOLDING_REGISTERS];
+static uint16_t modbusInputRegisters[MODBUS_INPUT_REGISTERS];
+
+static uint8_t modbusRequest[MODBUS_FRAME_SIZE];
+static uint8_t modbusResponse[MODBUS_FRAME_SIZE];
+static uint16_t modbusCrcTable[256];
+static uint8_t modbusAddress;
+static volatile uint32_t modbusMark;	// characters waiting in the ring when the IDLE line started the silence timer
+static volatile modbus_stats_t modbusStats;
+
+static void modbus_crc_table_init(void);
+static uint16_t modbus_crc(const uint8_t *data, uint32_t length);
+static void modbus_silence_timer_init(uint32_t baudRate);
+static void modbus_process(uint32_t length, uint32_t start);
+static uint32_t modbus_execute(const uint8_t *request, uint32_t length, uint8_t *response);
+static uint32_t modbus_exception(uint8_t function, uint8_t code, uint8_t *response);
+static uint16_t modbus_get16(const uint8_t *data);
+static void modbus_put16(uint8_t *data, uint16_t value);
+
+/* Returns 0, or -1 if the baud rate cannot be generated (see uart3_set_baudrate()) */
+int modbus_init(uint8_t address, uint32_t baudRate)
+{
+	modbusAddress = address;
+	modbus_crc_table_init();
+
+	if(!dwt_cycle_counter_is_running())
+	{
+		dwt_cycle_counter_init();
+	}
+
+	/* The answers go out through DMA1 Stream3, the requests come in through DMA1 Stream1 */
+	uart3_dma_tx_init();
+	uart3_dma_rx_init();
+
+	if(uart3_set_baudrate(baudRate, USART_OVERSAMPLING_AUTO, 0) != 0)
+	{
+		return -1;
+	}
+
+	/* 9 bit words with the parity in the ninth bit: 8 data bits, even parity (PS = 0). M and PCE can change only with the USART disabled */
+	USART3->CR1 &=~CR1_UE;
+	USART3->CR1 |= (USART_CR1__M | USART_CR1__PCE);
+	USART3->CR1 |= CR1_UE;
+
+	modbus_silence_timer_init(baudRate);
+
+	return 0;
+}
+
+void modbus_get_stats(modbus_stats_t *stats)
+{
+	stats->frames = modbusStats.frames;
+	stats->crcErrors = modbusStats.crcErrors;
+	stats->otherAddress = modbusStats.otherAddress;
+	stats->exceptions = modbusStats.exceptions;
+	stats->overruns = modbusStats.overruns;
+	stats->lastLatencyCycles = modbusStats.lastLatencyCycles;
+	stats->worstLatencyCycles = modbusStats.worstLatencyCycles;
+}
+
+void modbus_set_input_register(uint32_t index, uint16_t value)
+{
+	if(index < MODBUS_INPUT_REGISTERS)
+	{
+		modbusInputRegisters[index] = value;
+	}
+}
+
+uint16_t modbus_get_holding_register(uint32_t index)
+{
+	return (index < MODBUS_HOLDING_REGISTERS) ? modbusHoldingRegisters[index] : 0U;
+}
+
+void modbus_set_holding_register(uint32_t index, uint16_t value)
+{
+	if(index < MODBUS_HOLDING_REGISTERS)
+	{
+		modbusHoldingRegisters[index] = value;
+	}
+}
+
+uint32_t modbus_get_coil(uint32_t index)
+{
+	if(index >= MODBUS_COILS)
+	{
+		return 0;
+	}
+
+	return (modbusCoils[index / 8U] >> (index % 8U)) & 1U;
+}
+
+void modbus_set_coil(uint32_t index, uint32_t value)
+{
+	if(index >= MODBUS_COILS)
+	{
+		return;
+	}
+
+	if(value)
+	{
+		modbusCoils[index / 8U] |= (uint8_t) (1U << (index % 8U));
+	}
+	else
+	{
+		modbusCoils[index / 8U] &= (uint8_t) ~(1U << (index % 8U));
+	}
+}
+
+__attribute__((weak)) void modbus_coils_written_callback(uint32_t first, uint32_t count)
+{
+	(void)first;
+	(void)count;
+}
+
+__attribute__((weak)) void modbus_holding_registers_written_callback(uint32_t first, uint32_t count)
+{
+	(void)first;
+	(void)count;
+}
+
+/* ******************************************************************************************************************************************************************
+ * Explanation: Info taken from RM0090: TIM2 to TIM5
+ * 		TIMx_CR1 bit 3 OPM: one pulse mode, the counter stops (CEN is cleared) at the next update event.
+ * 		TIMx_CR1 bit 2 URS: only an overflow generates the update interrupt, not the UG bit we use to load the prescaler.
+ * 		TIMx_DIER bit 0 UIE: update interrupt enable.
+ * The timer counts microseconds and expires once after the part of the silence that the IDLE line did not cover yet (3.5 - 1 characters).
+ * ******************************************************************************************************************************************************************
+ */
+static void modbus_silence_timer_init(uint32_t baudRate)
+{
+	uint32_t timerClock = rcc_get_pclk1_freq();
+	uint32_t characterUs = (MODBUS_BITS_PER_CHARACTER * 1000000U + baudRate - 1U) / baudRate;
+	uint32_t silenceUs = (baudRate > 19200U) ? MODBUS_FIXED_SILENCE_US : ((characterUs * 7U) / 2U);
+
+	if(RCC->CFGR & RCC_CFGR__PPRE1_DIVIDED)
+	{
+		timerClock *= 2U;
+	}
+
+	RCC->APB1ENR |= RCC_APB1ENR__TIM2EN;
+
+	TIM2->CR1 = (TIM_CR1__OPM | TIM_CR1__URS);
+	TIM2->PSC = (timerClock / 1000000U) - 1U;
+	TIM2->ARR = (silenceUs > characterUs) ? (silenceUs - characterUs) : 1U;
+	TIM2->CNT = 0;
+
+	/* Load the prescaler now, without an interrupt because of URS */
+	TIM2->EGR = TIM_EGR__UG;
+	TIM2->SR = 0;
+
+	TIM2->DIER = TIM_DIER__UIE;
+	NVIC_EnableIRQ(TIM2_IRQn);
+}
+
+/* Called from USART3_IRQHandler (uart.c): the line has been silent for one character. Every new IDLE starts the silence again */
+void usart3_rx_frame_callback(uint32_t length)
+{
+	(void)length;
+
+	modbusMark = uart3_dma_rx_available();
+
+	TIM2->CR1 &=~TIM_CR1__CEN;
+	TIM2->CNT = 0;
+	TIM2->SR = 0;
+	TIM2->CR1 |= TIM_CR1__CEN;
+}
+
+void TIM2_IRQHandler(void)
+{
+	uint32_t start = dwt_get_cycles();
+
+	TIM2->SR = (uint32_t) ~TIM_SR__UIF;
+
+	uint32_t length = uart3_dma_rx_available();
+
+	/* Characters arrived during the silence: the frame goes on, the next IDLE starts the timer again */
+	if(length != modbusMark)
+	{
+		return;
+	}
+
+	if(length > MODBUS_FRAME_SIZE)
+	{
+		/* Not a Modbus frame, throw everything away */
+		while(uart3_dma_rx_read(modbusRequest, MODBUS_FRAME_SIZE) != 0);
+		modbusStats.overruns++;
+		return;
+	}
+
+	uart3_dma_rx_read(modbusRequest, length);
+	modbus_process(length, start);
+}
+
+static void modbus_process(uint32_t length, uint32_t start)
+{
+	/* Address, function and CRC at least */
+	if(length < 4U)
+	{
+		return;
+	}
+
+	uint16_t crc = modbus_crc(modbusRequest, length - 2U);
+
+	if((modbusRequest[length - 2U] != (uint8_t) crc) || (modbusRequest[length - 1U] != (uint8_t) (crc >> 8)))
+	{
+		modbusStats.crcErrors++;
+		return;
+	}
+
+	uint8_t address = modbusRequest[0];
+
+	if((address != modbusAddress) && (address != MODBUS_BROADCAST_ADDRESS))
+	{
+		modbusStats.otherAddress++;
+		return;
+	}
+
+	modbusStats.frames++;
+
+	/* The PDU, without address and CRC */
+	uint32_t responseLength = modbus_execute(&modbusRequest[1], length - 3U, &modbusResponse[1]);
+
+	if(address == MODBUS_BROADCAST_ADDRESS)
+	{
+		return;
+	}
+
+	modbusResponse[0] = modbusAddress;
+	responseLength++;
+
+	crc = modbus_crc(modbusResponse, responseLength);
+	modbusResponse[responseLength++] = (uint8_t) crc;
+	modbusResponse[responseLength++] = (uint8_t) (crc >> 8);
+
+	/* Copied in the staging buffer and started at once, the DMA sends it while this interrupt returns */
+	uart3_dma_write((const char *) modbusResponse, (int) responseLength);
+
+	uint32_t latency = dwt_get_cycles() - start;
+	modbusStats.lastLatencyCycles = latency;
+
+	if(latency > modbusStats.worstLatencyCycles)
+	{
+		modbusStats.worstLatencyCycles = latency;
+	}
+}
+
+/* Executes the request PDU and writes the response PDU, returns its length */
+static uint32_t modbus_execute(const uint8_t *request, uint32_t length, uint8_t *response)
+{
+	uint8_t function = request[0];
+	uint32_t first = (length >= 3U) ? modbus_get16(&request[1]) : 0U;
+	uint32_t count = (length >= 5U) ? modbus_get16(&request[3]) : 0U;
+
+	response[0] = function;
+
+	switch(function)
+	{
+	case MODBUS_READ_COILS:
+		if((length != 5U) || (count == 0) || (count > MODBUS_MAX_READ_COILS))
+		{
+			return modbus_exception(function, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE, response);
+		}
+		if((first + count) > MODBUS_COILS)
+		{
+			return modbus_exception(function, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS, response);
+		}
+		response[1] = (uint8_t) ((count + 7U) / 8U);
+		for(uint32_t i = 0; i < response[1]; i++)
+		{
+			response[2U + i] = 0;
+		}
+		for(uint32_t i = 0; i < count; i++)
+		{
+			response[2U + (i / 8U)] |= (uint8_t) (modbus_get_coil(first + i) << (i % 8U));
+		}
+		return 2U + response[1];
+
+	case MODBUS_READ_HOLDING_REGISTERS:
+	case MODBUS_READ_INPUT_REGISTERS:
+	{
+		const uint16_t *table = (function == MODBUS_READ_HOLDING_REGISTERS) ? modbusHoldingRegisters : modbusInputRegisters;
+		uint32_t size = (function == MODBUS_READ_HOLDING_REGISTERS) ? MODBUS_HOLDING_REGISTERS : MODBUS_INPUT_REGISTERS;
+
+		if((length != 5U) || (count == 0) || (count > MODBUS_MAX_READ_REGISTERS))
+		{
+			return modbus_exception(function, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE, response);
+		}
+		if((first + count) > size)
+		{
+			return modbus_exception(function, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS, response);
+		}
+		response[1] = (uint8_t) (count * 2U);
+		for(uint32_t i = 0; i < count; i++)
+		{
+			modbus_put16(&response[2U + (i * 2U)], table[first + i]);
+		}
+		return 2U + response[1];
+	}
+
+	case MODBUS_WRITE_SINGLE_COIL:
+		if((length != 5U) || ((count != 0xFF00U) && (count != 0x0000U)))
+		{
+			return modbus_exception(function, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE, response);
+		}
+		if(first >= MODBUS_COILS)
+		{
+			return modbus_exception(function, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS, response);
+		}
+		modbus_set_coil(first, (count == 0xFF00U));
+		modbus_coils_written_callback(first, 1);
+		/* The answer repeats the request */
+		for(uint32_t i = 1; i < 5U; i++)
+		{
+			response[i] = request[i];
+		}
+		return 5U;
+
+	case MODBUS_WRITE_SINGLE_REGISTER:
+		if(length != 5U)
+		{
+			return modbus_exception(function, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE, response);
+		}
+		if(first >= MODBUS_HOLDING_REGISTERS)
+		{
+			return modbus_exception(function, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS, response);
+		}
+		modbusHoldingRegisters[first] = (uint16_t) count;
+		modbus_holding_registers_written_callback(first, 1);
+		for(uint32_t i = 1; i < 5U; i++)
+		{
+			response[i] = request[i];
+		}
+		return 5U;
+
+	case MODBUS_WRITE_MULTIPLE_COILS:
+		if((length < 6U) || (count == 0) || (count > MODBUS_MAX_WRITE_COILS) || (request[5] != ((count + 7U) / 8U)) || (length != (6U + request[5])))
+		{
+			return modbus_exception(function, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE, response);
+		}
+		if((first + count) > MODBUS_COILS)
+		{
+			return modbus_exception(function, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS, response);
+		}
+		for(uint32_t i = 0; i < count; i++)
+		{
+			modbus_set_coil(first + i, (request[6U + (i / 8U)] >> (i % 8U)) & 1U);
+		}
+		modbus_coils_written_callback(first, count);
+		/* The answer is the start address and the quantity */
+		for(uint32_t i = 1; i < 5U; i++)
+		{
+			response[i] = request[i];
+		}
+		return 5U;
+
+	case MODBUS_WRITE_MULTIPLE_REGISTERS:
+		if((length < 6U) || (count == 0) || (count > MODBUS_MAX_WRITE_REGISTERS) || (request[5] != (count * 2U)) || (length != (6U + request[5])))
+		{
+			return modbus_exception(function, MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE, response);
+		}
+		if((first + count) > MODBUS_HOLDING_REGISTERS)
+		{
+			return modbus_exception(function, MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS, response);
+		}
+		for(uint32_t i = 0; i < count; i++)
+		{
+			modbusHoldingRegisters[first + i] = modbus_get16(&request[6U + (i * 2U)]);
+		}
+		modbus_holding_registers_written_callback(first, count);
+		for(uint32_t i = 1; i < 5U; i++)
+		{
+			response[i] = request[i];
+		}
+		return 5U;
+
+	default:
+		return modbus_exception(function, MODBUS_EXCEPTION_ILLEGAL_FUNCTION, response);
+	}
+}
+
+static uint32_t modbus_exception(uint8_t function, uint8_t code, uint8_t *response)
+{
+	modbusStats.exceptions++;
+
+	response[0] = (uint8_t) (function | 0x80U);
+	response[1] = code;
+
+	return 2U;
+}
+
+/* CRC-16/MODBUS: polynomial 0x8005 reflected, initial value 0xFFFF, sent low byte first. One table lookup per byte instead of 8 shifts */
+static void modbus_crc_table_init(void)
+{
+	for(uint32_t i = 0; i < 256U; i++)
+	{
+		uint16_t crc = (uint16_t) i;
+
+		for(uint32_t bit = 0; bit < 8U; bit++)
+		{
+			crc = (crc & 1U) ? (uint16_t) ((crc >> 1) ^ MODBUS_CRC_POLYNOMIAL) : (uint16_t) (crc >> 1);
+		}
+
+		modbusCrcTable[i] = crc;
+	}
+}
+
+static uint16_t modbus_crc(const uint8_t *data, uint32_t length)
+{
+	uint16_t crc = 0xFFFFU;
+
+	for(uint32_t i = 0; i < length; i++)
+	{
+		crc = (uint16_t) ((crc >> 8) ^ modbusCrcTable[(crc ^ data[i]) & 0xFFU]);
+	}
+
+	return crc;
+}
+
+/* Modbus sends the registers big endian */
+static uint16_t modbus_get16(const uint8_t *data)
+{
+	return (uint16_t) ((data[0] << 8) | data[1]);
+}
+
+static void modbus_put16(uint8_t *data, uint16_t value)
+{
+	data[0] = (uint8_t) (value >> 8);
+	data[1] = (uint8_t) value;
+}
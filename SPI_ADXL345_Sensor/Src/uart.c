@@ -338,7 +338,7 @@ void uart3_tx_init(void)
 char uart3_read(void)
 {
 	/* Make sure the receive data register is not empty */
-	while(!(USART3->SR & SR_RXNE))
+	while(!(USART3->SR & SR_RXNE));
 
 
 	/* Read data */
@@ -7,10 +7,11 @@
  *
  * Notes: User LD3: a red user LED is connected to PB14 on the Nucleo 144 family boards
  * User LD2: a blue user LED is connected to PB7.
+ * The USART3 driver is the one of DMA_UART_Tx_Driver, linked in the Drivers folder (.project). SysTick_Handler only queues its message
+ * for the DMA transmitter with uart3_write_async(), the LED toggles in the completion callback once the message has been handed to USART3.
  ******************************************************************************
  */
 
-#include <stdio.h>
 #include "uart.h"
 #include "systick.h"
 
@@ -20,7 +21,10 @@
 
 
 
+#define MESSAGE "A second just passed......\n\r"
+
 static void systick_callback();
+static void message_sent(void *context);
 
 int main(void)
 {
@@ -31,7 +35,7 @@ int main(void)
 	GPIOB->MODER &=~(1UL<<15); //'0'
 	GPIOB->MODER |=(1UL<<14); //'1'
 
-	uart3_tx_init();
+	uart3_dma_tx_init();
 	systick_1Hz_interrupt();
 
 	while(1)
@@ -60,8 +64,16 @@ void SysTick_Handler(void)
 
 static void systick_callback()
 {
+	/* printf and fflush(stdout) would wait here, inside the interrupt, until the characters are on the wire.
+	 * uart3_write_async() only copies them in the staging buffer and returns */
+	uart3_write_async(MESSAGE, sizeof(MESSAGE) - 1U, message_sent, 0);
+}
+
+/* Runs in the interrupt of the USART3_TX stream once the message has been handed to USART3 */
+static void message_sent(void *context)
+{
+	(void)context;
+
 	/* Toggle the user LED */
 	GPIOB->ODR ^=LED_PIN;
-	printf("A second just passed......\n\r");
-	fflush(stdout);
 }
@@ -15,5 +15,8 @@ void pa1_adc_init(void);
 void start_conversion(void);
 uint32_t adc_read(void);
 
+void pa1_adc_dma_init(uint16_t *buffer, uint32_t length);
+void tim2_adc_trigger_init(uint32_t sampleRate);
+
 
 #endif /* ADC_H_ */
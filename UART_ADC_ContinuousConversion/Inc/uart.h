@@ -19,4 +19,8 @@ int __io_putchar(int myCharacter);
 char uart3_rx_read(void);
 void uart3_rxtx_init(void);
 
+void uart3_dma_tx_init(uint32_t baudRate);
+int uart3_dma_send(const void *source, uint32_t length);
+uint32_t uart3_dma_busy(void);
+
 #endif /* UART_H_ */
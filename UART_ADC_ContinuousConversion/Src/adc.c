@@ -17,6 +17,31 @@
 #define SR_EOC (1UL<<1)
 #define CR2_CONT (1UL<<1)
 
+#define CR2_DMA (1UL<<8)
+#define CR2_DDS (1UL<<9)
+#define CR2_EXTSEL_TIM2_TRGO (6UL<<24)
+#define CR2_EXTEN_RISING (1UL<<28)
+#define SMPR2_SMP1_84_CYCLES (4UL<<3)
+#define SMPR2_SMP1_MASK (7UL<<3)
+
+#define RCC_AHB1ENR__DMA2EN (1UL<<22)
+#define RCC_APB1ENR__TIM2EN (1UL<<0)
+#define DMA_SxCR__EN (1UL<<0)
+#define DMA_SxCR__HTIE (1UL<<3)
+#define DMA_SxCR__TCIE (1UL<<4)
+#define DMA_SxCR__CIRC (1UL<<8)
+#define DMA_SxCR__MINC (1UL<<10)
+#define DMA_SxCR__PSIZE_16 (1UL<<11)
+#define DMA_SxCR__MSIZE_32 (2UL<<13)
+#define DMA_SxCR__MBURST_INCR4 (1UL<<23)
+#define DMA_SxFCR__FTH_FULL (3UL<<0)
+#define DMA_SxFCR__DMDIS (1UL<<2)
+#define DMA_SxCR__PL_HIGH (1UL<<17)
+#define DMA_LIFCR__STREAM0_ALL ((1UL<<0)|(1UL<<2)|(1UL<<3)|(1UL<<4)|(1UL<<5)) // CFEIF0, CDMEIF0, CTEIF0, CHTIF0, CTCIF0
+#define TIM_CR1_CEN_BIT (1UL<<0)
+#define TIM_CR2_MMS_UPDATE (2UL<<4)
+#define APB1_CLOCK (16000000)
+
 void pa1_adc_init(void)
 {
 	/* *** CONFIGURE THE ADC GPIO PIN *** */
@@ -62,3 +87,82 @@ uint32_t adc_read(void)
 	/*Read the result of the conversion*/
 	return (ADC1->DR);
 }
+
+/* *** ADC1 TO MEMORY WITH DMA, TRIGGERED BY TIM2 *** */
+/* ******************************************************************************************************************************************************************
+ * Explanation: Info taken from RM0090: DMA2 request mapping, ADC1 is Channel 0 of DMA2 Stream 0.
+ * 		ADC_CR2 bit 8 DMA: the ADC asks the DMA to read DR after every conversion. Bit 9 DDS: the requests go on after the last transfer of the DMA (circular mode).
+ * 		ADC_CR2 bits 27:24 EXTSEL = 0110: Timer 2 TRGO event starts a conversion, bits 29:28 EXTEN = 01 on its rising edge.
+ * 		DMA_SxCR bit 8 CIRC: when NDTR reaches 0 it is reloaded and the stream starts again at the beginning of the buffer.
+ * 		DMA_SxCR bit 3 HTIE / bit 4 TCIE: an interrupt when the first half / the second half of the buffer has been filled.
+ * The samples are 12 bit wide, right aligned, and the DMA reads them as half words, so the buffer is an array of uint16_t.
+ * Info taken from RM0090: DMA stream x FIFO control register (DMA_SxFCR), bit 2 DMDIS: the samples go through the FIFO of the stream instead of direct mode.
+ * The FIFO packs two half words in a word (PSIZE 16, MSIZE 32) and is drained to SRAM, once it is full (FTH = 11), with one burst of 4 words (MBURST = INCR4):
+ * one request of the memory port every 8 samples instead of one every sample. At 40 kS/s the writes to SRAM drop from 40000 single half word accesses
+ * to 5000 bursts per second, and the bus matrix is arbitrated 8 times less often for this stream.
+ * The buffer has to be aligned on 16 bytes (a burst never crosses a 1 KB boundary then) and its length a multiple of 8 samples. Each half ends with
+ * a complete burst, so the half is in SRAM by the time of the half transfer or transfer complete interrupt.
+ * DMA2_Stream0_IRQHandler is left to the application (main.c), the halves are handed to it there.
+ * ******************************************************************************************************************************************************************
+ */
+void pa1_adc_dma_init(uint16_t *buffer, uint32_t length)
+{
+	/* *** CONFIGURE THE ADC GPIO PIN *** */
+	/* Enable clock access to ADC GPIO pin which is PA1 and set it to analog */
+	RCC->AHB1ENR |= GPIOA_ENR;
+	GPIOA->MODER |= (1UL<<3); // '1'
+	GPIOA->MODER |= (1UL<<2); // '1'
+
+	/* *** CONFIGURE THE ADC Module *** */
+	RCC->APB2ENR |= ADC1EN;
+
+	/* One conversion of channel 1 for every trigger */
+	ADC1->SQR3 = ADC_SQR3;
+	ADC1->SQR1 = ADC_SQR1_LEN;
+
+	/* 84 cycles of sampling plus 12 of conversion, 12 us at the 8 MHz ADC clock (PCLK2 / 2): shorter than the period of the trigger */
+	ADC1->SMPR2 = (ADC1->SMPR2 & ~SMPR2_SMP1_MASK) | SMPR2_SMP1_84_CYCLES;
+
+	/* *** CONFIGURE DMA2 Stream0 *** */
+	RCC->AHB1ENR |= RCC_AHB1ENR__DMA2EN;
+
+	DMA2_Stream0->CR &=~DMA_SxCR__EN;
+	while(DMA2_Stream0->CR & DMA_SxCR__EN);
+
+	DMA2->LIFCR = DMA_LIFCR__STREAM0_ALL;
+
+	DMA2_Stream0->PAR = (uint32_t) &ADC1->DR;
+	DMA2_Stream0->M0AR = (uint32_t) buffer;
+	DMA2_Stream0->NDTR = length;
+
+	/* Channel 0 (CHSEL = 000), peripheral to memory (DIR = 00), half words from the ADC, bursts of words to memory, circular, half and complete transfer interrupts */
+	DMA2_Stream0->CR = (DMA_SxCR__PSIZE_16 | DMA_SxCR__MSIZE_32 | DMA_SxCR__MBURST_INCR4 | DMA_SxCR__MINC | DMA_SxCR__CIRC | DMA_SxCR__HTIE | DMA_SxCR__TCIE | DMA_SxCR__PL_HIGH);
+
+	/* FIFO mode, drained at full */
+	DMA2_Stream0->FCR = (DMA_SxFCR__DMDIS | DMA_SxFCR__FTH_FULL);
+
+	DMA2_Stream0->CR |= DMA_SxCR__EN;
+	NVIC_EnableIRQ(DMA2_Stream0_IRQn);
+
+	/* Conversions started by TIM2, every result taken by the DMA */
+	ADC1->CR2 = (CR2_DMA | CR2_DDS | CR2_EXTSEL_TIM2_TRGO | CR2_EXTEN_RISING);
+
+	/* Enable ADC module */
+	ADC1->CR2 |= CR2_ADON;
+}
+
+/* TIM2 sends a TRGO at every update event, sampleRate times per second. The conversions start as soon as the timer runs */
+void tim2_adc_trigger_init(uint32_t sampleRate)
+{
+	RCC->APB1ENR |= RCC_APB1ENR__TIM2EN;
+
+	TIM2->CR1 = 0;
+	TIM2->PSC = 0;
+	TIM2->ARR = (APB1_CLOCK / sampleRate) - 1U;
+	TIM2->CNT = 0;
+
+	/* Bits 6:4 MMS = 010: the update event is the trigger output (TRGO) */
+	TIM2->CR2 = TIM_CR2_MMS_UPDATE;
+
+	TIM2->CR1 |= TIM_CR1_CEN_BIT;
+}
@@ -13,20 +13,83 @@
 #include "uart.h"
 #include "adc.h"
 
-uint32_t sensor_val;
+#define ADC_STREAM_SAMPLES (512U)			// both halves of the circular buffer
+#define ADC_STREAM_HALF (ADC_STREAM_SAMPLES / 2U)
+#define ADC_STREAM_SAMPLE_RATE (40000U)		// 80 KB/s of samples, 80% of what the line carries at UART_STREAM_BAUDRATE
+#define UART_STREAM_BAUDRATE (1000000U)		// 16 MHz / 16: BRR = 16, no error; 10 bits per byte => 100 KB/s
+#define ADC_STREAM_SYNC (0xFFFFU)			// replaces the first sample of every half, no 12 bit sample can take this value
 
+#define DMA_LISR__HTIF0 (1UL<<4)
+#define DMA_LISR__TCIF0 (1UL<<5)
+#define DMA_LIFCR__CHTIF0 (1UL<<4)
+#define DMA_LIFCR__CTCIF0 (1UL<<5)
+#define DMA_LIFCR__ERRORS0 ((1UL<<0)|(1UL<<2)|(1UL<<3)) // CFEIF0, CDMEIF0, CTEIF0
+
+/* Aligned on 16 bytes for the bursts of both DMA streams, see pa1_adc_dma_init() and uart3_dma_send() */
+static uint16_t adcSamples[ADC_STREAM_SAMPLES] __attribute__((aligned(16)));
+
+volatile uint32_t halvesSent;
+volatile uint32_t halvesDropped;
+
+static void adc_stream_half_ready(uint16_t *half);
+
+/* ******************************************************************************************************************************************************************
+ * Explanation: adc_read() and printf gave a few hundred samples per second. Here the CPU does not touch the samples at all:
+ * 		ADC1 (triggered by TIM2) -> DMA2 Stream0 -> adcSamples[] (circular) -> DMA1 Stream3 -> USART3
+ * When the ADC has filled one half of the buffer (half transfer or transfer complete interrupt), that half is given as it is to the UART DMA,
+ * while the ADC goes on filling the other half. The UART sends one half (512 bytes, 5.1 ms) faster than the ADC fills the other one (6.4 ms),
+ * so a half is never overwritten while it is being sent. If it happens anyway (a lower baud rate, a higher sample rate) that half is skipped and counted.
+ * The stream is raw binary: every sample is 2 bytes, little endian. The first sample of every half is replaced by ADC_STREAM_SYNC (bytes 0xFF 0xFF),
+ * so the host can find where a half, and so a sample, starts if it starts listening in the middle of the stream. The upper byte of a 12 bit sample
+ * is at most 0x0F, so two 0xFF bytes in a row never appear in the samples: the first 0xFF 0xFF pair is always the marker.
+ * The price is one sample every ADC_STREAM_HALF (0.4%), the host sees a gap of one sample period after every marker.
+ * ******************************************************************************************************************************************************************
+ */
 int main(void)
 {
-	uart3_tx_init();
-	pa1_adc_init();
-	start_conversion();
+	uart3_dma_tx_init(UART_STREAM_BAUDRATE);
+	pa1_adc_dma_init(adcSamples, ADC_STREAM_SAMPLES);
+
+	/* The first conversion starts with the first TRGO */
+	tim2_adc_trigger_init(ADC_STREAM_SAMPLE_RATE);
 
 	for(;;)
 	{
-		sensor_val = adc_read();
-		printf("Sensor value: %d \n\r", (int) sensor_val);
+		/* Nothing to do here, the whole stream runs on the two DMA controllers */
 	}
 
 }
 
+void DMA2_Stream0_IRQHandler(void)
+{
+	/* The first half has been filled, the ADC is now writing in the second one */
+	if(DMA2->LISR & DMA_LISR__HTIF0)
+	{
+		DMA2->LIFCR = DMA_LIFCR__CHTIF0;
+		adc_stream_half_ready(&adcSamples[0]);
+	}
 
+	/* The second half has been filled, the ADC started again from the beginning */
+	if(DMA2->LISR & DMA_LISR__TCIF0)
+	{
+		DMA2->LIFCR = DMA_LIFCR__CTCIF0;
+		adc_stream_half_ready(&adcSamples[ADC_STREAM_HALF]);
+	}
+
+	DMA2->LIFCR = DMA_LIFCR__ERRORS0;
+}
+
+static void adc_stream_half_ready(uint16_t *half)
+{
+	/* The ADC is filling the other half now, this one can be written */
+	half[0] = ADC_STREAM_SYNC;
+
+	if(uart3_dma_send(half, ADC_STREAM_HALF * sizeof(uint16_t)) == 0)
+	{
+		halvesSent++;
+	}
+	else
+	{
+		halvesDropped++;
+	}
+}
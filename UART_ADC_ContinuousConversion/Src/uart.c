@@ -29,6 +29,21 @@
 
 #define SR_TXE (1UL<<7)
 #define SR_RXNE (1UL<<5)
+#define SR_TC (1UL<<6)
+
+#define RCC_AHB1ENR__DMA1ENR (1UL<<21)
+#define DMA_SxCR__EN (1UL<<0)
+#define DMA_SxCR__CHSEL (1UL<<27) // channel 4
+#define DMA_SxCR__MINC (1UL<<10)
+#define DMA_SxCR__DIR (1UL<<6) // memory to peripheral
+#define DMA_SxCR__MSIZE_MASK (3UL<<13)
+#define DMA_SxCR__MSIZE_32 (2UL<<13)
+#define DMA_SxCR__MBURST_MASK (3UL<<23)
+#define DMA_SxCR__MBURST_INCR4 (1UL<<23)
+#define DMA_SxFCR__FTH_FULL (3UL<<0)
+#define DMA_SxFCR__DMDIS (1UL<<2)
+#define DMA_LIFCR__STREAM3_ALL ((1UL<<22)|(1UL<<24)|(1UL<<25)|(1UL<<26)|(1UL<<27)) // CFEIF3, CDMEIF3, CTEIF3, CHTIF3, CTCIF3
+#define USART_CR3__DMAT (1UL<<7)
 
 static uint16_t compute_uart_bd(uint32_t PeriphClock, uint32_t BaudRate);
 static void uart_set_baudrate(USART_TypeDef *USARTx, uint32_t PeriphClock, uint32_t BaudRate );
@@ -111,6 +126,78 @@ void uart3_tx_init(void)
 
 
 
+/* *** DMA DRIVEN TRANSMITTER FOR BINARY BLOCKS *** */
+/* ******************************************************************************************************************************************************************
+ * Explanation: Info taken from RM0090: DMA1 request mapping, USART3_TX is Channel 4 of DMA1 Stream 3.
+ * uart3_dma_send() points the stream straight at the block of the caller, nothing is copied, and returns. There is no interrupt:
+ * at the end of the transfer the hardware clears the EN bit of DMA_SxCR by itself, so EN tells whether the previous block is still being sent.
+ * The stream runs through its FIFO (DMA_SxFCR bit 2 DMDIS): USART3 still takes one byte per request (PSIZE 8), but a block aligned on 16 bytes
+ * and made of whole 16 byte pieces is read from SRAM as words (MSIZE 32) in bursts of 4 (MBURST = INCR4), one request of the memory port for 16 characters.
+ * Any other block is read byte by byte as before, MSIZE and MBURST can be changed only while EN is '0', that is in uart3_dma_send().
+ * ******************************************************************************************************************************************************************
+ */
+void uart3_dma_tx_init(uint32_t baudRate)
+{
+	/* Configure PD8 and the USART3 module as a transmitter, then the baud rate of the stream */
+	uart3_tx_init();
+	uart_set_baudrate(USART3, APB1_CLOCK, baudRate);
+
+	/* Let the USART ask the DMA for a new character every time TXE is set */
+	USART3->CR3 |= USART_CR3__DMAT;
+
+	/* Enable clock access to DMA1 */
+	RCC->AHB1ENR |= RCC_AHB1ENR__DMA1ENR;
+
+	/* Disable DMA1 Stream3 and wait until it is really stopped */
+	DMA1_Stream3->CR &=~DMA_SxCR__EN;
+	while(DMA1_Stream3->CR & DMA_SxCR__EN);
+
+	/* The destination is the data register of USART3 */
+	DMA1_Stream3->PAR = (uint32_t) &USART3->DR;
+
+	/* Channel 4, byte transfers, memory increment, memory to peripheral */
+	DMA1_Stream3->CR = (DMA_SxCR__CHSEL | DMA_SxCR__MINC | DMA_SxCR__DIR);
+
+	/* FIFO mode, filled again once it is empty enough for a whole burst */
+	DMA1_Stream3->FCR = (DMA_SxFCR__DMDIS | DMA_SxFCR__FTH_FULL);
+}
+
+/* Starts sending length bytes from source. Returns 0, or -1 if the previous block is still being sent (then nothing is started) */
+int uart3_dma_send(const void *source, uint32_t length)
+{
+	if(DMA1_Stream3->CR & DMA_SxCR__EN)
+	{
+		return -1;
+	}
+
+	/* Clear all interrupt flags of Stream 3, the stream cannot be enabled while any of them is set */
+	DMA1->LIFCR = DMA_LIFCR__STREAM3_ALL;
+
+	uint32_t cr = DMA1_Stream3->CR & ~(DMA_SxCR__MSIZE_MASK | DMA_SxCR__MBURST_MASK);
+
+	if((((uint32_t) source & 0xFU) == 0) && ((length & 0xFU) == 0))
+	{
+		cr |= (DMA_SxCR__MSIZE_32 | DMA_SxCR__MBURST_INCR4);
+	}
+	DMA1_Stream3->CR = cr;
+
+	DMA1_Stream3->M0AR = (uint32_t) source;
+	DMA1_Stream3->NDTR = length;
+
+	/* TC is rc_w0: writing 0 clears it, the '1's in the other bits change nothing */
+	USART3->SR = (uint32_t) ~SR_TC;
+
+	DMA1_Stream3->CR |= DMA_SxCR__EN;
+
+	return 0;
+}
+
+uint32_t uart3_dma_busy(void)
+{
+	return (DMA1_Stream3->CR & DMA_SxCR__EN) ? 1U : 0U;
+}
+
+
 char uart3_rx_read(void)
 {
 	/* Make sure the receive data register is not empty */
@@ -6,27 +6,70 @@
  * Target board: Nucleo 144 family
  *
  * Notes: User LD3: a red user LED is connected to PB14 on the Nucleo 144 family boards
+ * The UART drivers, the telemetry framing, the startup file and the linker scripts are those of DMA_UART_Tx_Driver,
+ * linked in the Drivers folder of the project (.project). Decode the stream with DMA_UART_Tx_Driver/Tools/telemetry_decode.py
  ******************************************************************************
  */
 
-#include <stdio.h>
 #include "uart.h"
 #include "adc.h"
+#include "dwt.h"
+#include "telemetry.h"
 
-uint32_t sensor_val;
+#define ADC_BATCH_SAMPLES (TELEMETRY_MAX_PAYLOAD / sizeof(uint16_t))	// 120 samples, the most one raw ADC record carries
 
+static uint16_t adcBatch[ADC_BATCH_SAMPLES];
+
+volatile uint32_t samplesSent;
+volatile uint32_t samplesPerSecond;		// updated once per second, watch it with the debugger
+
+/* ******************************************************************************************************************************************************************
+ * Explanation: printf("Sensor value: %d \n\r") put about 20 characters on the line for every sample, so at 115200 baud (11520 characters per second)
+ * no more than about 570 samples per second could leave the board, and the CPU spent its time in newlib formatting them.
+ * Now the samples are collected in batches of ADC_BATCH_SAMPLES and every batch goes out as one binary telemetry record (telemetry.c):
+ * 2 bytes per sample plus about 11 bytes of header, CRC, COBS and delimiter per record, which is about 2.1 bytes per sample, about 5500 samples per second.
+ * The record is copied into the staging buffer of the DMA transmitter, which waits for room (UART_TX_FULL_BLOCK) rather than losing samples.
+ * With compression on, a record carries the difference of every sample from the previous one (zig-zag varint, see telemetry.c), 1 byte instead of 2
+ * as long as the input moves by less than 64 LSB between two samples. Once per second a TELEMETRY_TYPE_STATS record reports how much that saved.
+ * The ADC is in single conversion mode, so every sample is started with start_conversion().
+ * ******************************************************************************************************************************************************************
+ */
 int main(void)
 {
-	uart3_tx_init();
+	uart3_dma_tx_init();
+	uart3_tx_set_full_policy(UART_TX_FULL_BLOCK);
+	telemetry_init(uart3_dma_write);
+	telemetry_set_compression(1);
+
 	pa1_adc_init();
-	start_conversion();
+
+	uint32_t hclk = rcc_get_hclk_freq();
+	uint32_t secondStart = dwt_get_cycles();
+	uint32_t secondSamples = 0;
 
 	for(;;)
 	{
-		sensor_val = adc_read();
-		printf("Sensor value: %d \n\r", (int) sensor_val);
-	}
+		for(uint32_t i = 0; i < ADC_BATCH_SAMPLES; i++)
+		{
+			start_conversion();
+			adcBatch[i] = (uint16_t) adc_read();
+		}
 
-}
+		if(telemetry_send_adc(adcBatch, ADC_BATCH_SAMPLES) > 0)
+		{
+			samplesSent += ADC_BATCH_SAMPLES;
+		}
 
+		/* The cycle counter was started by telemetry_init() */
+		if((dwt_get_cycles() - secondStart) >= hclk)
+		{
+			secondStart += hclk;
+			samplesPerSecond = samplesSent - secondSamples;
+			secondSamples = samplesSent;
 
+			/* The decoder prints it as "STATS ... ratio=... cycles_per_sample=..." */
+			telemetry_send_stats();
+		}
+	}
+
+}
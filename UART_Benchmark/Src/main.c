@@ -0,0 +1,396 @@
+/**
+ ******************************************************************************
+ * @file           : main.c
+ * @author         : George Calin
+ * @brief          : Main program body
+ * Target board: Nucleo 144 family
+ *
+ * Notes: throughput and latency benchmark of the USART3 transmitters (uart.c):
+ * polled uart3_write(), interrupt driven ring buffer and DMA1 Stream3, each of them at several baud rates.
+ * The drivers, the startup file and the linker scripts are those of DMA_UART_Tx_Driver, linked in the Drivers folder of the project (.project),
+ * so the benchmark always measures the current uart.c.
+ * Then format_snprintf()/uart3_printf() (format.c) against snprintf()/printf() of newlib, in cycles per call.
+ * User LD2: a blue user LED is connected to PB7, it is lit once the table has been printed.
+ ******************************************************************************
+ */
+
+#include <stdio.h>
+#include "uart.h"
+#include "dwt.h"
+#include "format.h"
+
+#define GPIOB_ENABLE (1UL<<1)
+#define PIN7	(1UL<<7)
+#define LED_PIN	PIN7
+
+#define USART_SR__TXE (1UL<<7)
+#define USART_SR__TC (1UL<<6)
+
+#define BENCHMARK_LINES (64U)				// printf calls of every run, about 4 KB, more than the biggest software buffer so the throughput is sustained
+#define BENCHMARK_LINE_MAX (80U)			// the longest line printed by benchmark_run(), a run waits for this much room before every printf
+#define BENCHMARK_REPORT_BAUDRATE (115200U)	// the table is always printed at this baud rate, with the polled transmitter
+#define BENCHMARK_VERSION (1U)				// bump it when the columns or the workload change, the results are not comparable anymore
+#define BENCHMARK_FORMAT_CALLS (64U)		// calls of every formatter
+#define BENCHMARK_FORMAT_BAUDRATE (2000000U)	// uart3_printf and printf send through the DMA transmitter at this baud rate
+#define BENCHMARK_FORMAT "Sensor value: %d 0x%08x %s\r\n"	// understood the same way by format.c and newlib
+
+typedef struct
+{
+	uart_tx_backend_t backend;
+	uint32_t baudrate;			// requested
+	uint32_t actualBaudrate;	// generated by BRR, see baudrate.c
+	uint32_t bytes;				// characters printed by the run
+	uint32_t elapsedCycles;		// from the first printf until the last stop bit left the line
+	uint32_t idleCycles;		// spent waiting in benchmark_wait_pending(), without the interrupts that hit the wait
+	uint32_t worstLatency;		// the longest printf, in cycles
+	uint32_t dropped;
+} benchmark_result_t;
+
+static const uint32_t benchmarkBaudrates[] = {115200U, 460800U, 1000000U, 2000000U};
+static const uart_tx_backend_t benchmarkBackends[] = {UART_TX_BACKEND_POLLED, UART_TX_BACKEND_INTERRUPT, UART_TX_BACKEND_DMA};
+
+#define BENCHMARK_BAUDRATE_COUNT (sizeof(benchmarkBaudrates) / sizeof(benchmarkBaudrates[0]))
+#define BENCHMARK_BACKEND_COUNT (sizeof(benchmarkBackends) / sizeof(benchmarkBackends[0]))
+
+static benchmark_result_t benchmarkResults[BENCHMARK_BAUDRATE_COUNT * BENCHMARK_BACKEND_COUNT];
+
+typedef enum
+{
+	BENCHMARK_FORMATTER_FORMAT_SNPRINTF = 0,
+	BENCHMARK_FORMATTER_NEWLIB_SNPRINTF,
+	BENCHMARK_FORMATTER_UART3_PRINTF,
+	BENCHMARK_FORMATTER_NEWLIB_PRINTF,
+	BENCHMARK_FORMATTER_COUNT
+} benchmark_formatter_t;
+
+typedef struct
+{
+	uint32_t calls;
+	uint32_t bytes;				// characters produced by all the calls
+	uint32_t cycles;			// spent inside the calls only, the waits for room are left out
+	uint32_t worstCycles;
+} benchmark_format_result_t;
+
+static const char *const benchmarkFormatterNames[BENCHMARK_FORMATTER_COUNT] = {"format_snprintf", "newlib_snprintf", "uart3_printf", "newlib_printf"};
+
+static benchmark_format_result_t benchmarkFormatResults[BENCHMARK_FORMATTER_COUNT];
+
+static void benchmark_select_backend(uart_tx_backend_t backend);
+static uint32_t benchmark_capacity(uart_tx_backend_t backend);
+static uint32_t benchmark_wait_pending(uint32_t pending);
+static void benchmark_wait_line_idle(void);
+static void benchmark_run(uart_tx_backend_t backend, uint32_t baudrate, benchmark_result_t *result);
+static void benchmark_print_table(const benchmark_result_t *results, uint32_t count);
+static const char *benchmark_backend_name(uart_tx_backend_t backend);
+static void benchmark_format_run(benchmark_format_result_t *results);
+static void benchmark_print_format_table(const benchmark_format_result_t *results);
+
+int main(void)
+{
+	/* Enable the clock access via AHB1 to GPIO B */
+	RCC->AHB1ENR|=GPIOB_ENABLE;
+
+	/* Set the mode in the MODER registry to output for port B7 */
+	GPIOB->MODER &=~(1UL<<15); //'0'
+	GPIOB->MODER |=(1UL<<14); //'1'
+
+	dwt_cycle_counter_init();
+
+	uint32_t index = 0;
+
+	for(uint32_t i = 0; i < BENCHMARK_BAUDRATE_COUNT; i++)
+	{
+		for(uint32_t j = 0; j < BENCHMARK_BACKEND_COUNT; j++)
+		{
+			benchmark_run(benchmarkBackends[j], benchmarkBaudrates[i], &benchmarkResults[index]);
+			index++;
+		}
+	}
+
+	benchmark_format_run(benchmarkFormatResults);
+
+	/* The runs at the other baud rates look like garbage on the terminal, the table is printed at a fixed baud rate so the host can always read it */
+	benchmark_select_backend(UART_TX_BACKEND_POLLED);
+	uart3_set_baudrate(BENCHMARK_REPORT_BAUDRATE, USART_OVERSAMPLING_AUTO, 0);
+
+	benchmark_print_table(benchmarkResults, index);
+	benchmark_print_format_table(benchmarkFormatResults);
+
+	/* Light the user LED */
+	GPIOB->ODR |=LED_PIN;
+
+	for(;;)
+	{
+
+
+	}
+
+}
+
+/* ******************************************************************************************************************************************************************
+ * Explanation: every run prints BENCHMARK_LINES lines with printf and measures with the DWT cycle counter (dwt.c):
+ * 		- the elapsed cycles, from the first printf until the TC flag of USART3 tells that the last stop bit is gone, which gives the sustained bytes/s;
+ * 		- the CPU cycles, which are the elapsed cycles minus the time the CPU was free. The CPU is free only inside benchmark_wait_pending(),
+ * 		  where the application waits for room in the buffer of the transmitter, but the USART3 and DMA1 Stream3 interrupts steal cycles from there as well.
+ * 		  That is why the wait loop reads CYCCNT at every turn: the shortest turn is the loop itself, anything longer was an interrupt and is counted as CPU time;
+ * 		- the worst latency of a single printf, formatting included.
+ * The application waits for room before every printf, so that with the interrupt and the DMA transmitters the printf never blocks and its latency is the
+ * cost of handing the line over. With the polled transmitter there is no buffer: the CPU is busy for the whole run and printf lasts as long as the line on the wire.
+ * ******************************************************************************************************************************************************************
+ */
+static void benchmark_run(uart_tx_backend_t backend, uint32_t baudrate, benchmark_result_t *result)
+{
+	usart_baudrate_t generated;
+	uint32_t capacity = benchmark_capacity(backend);
+
+	benchmark_select_backend(backend);
+	uart3_tx_set_full_policy(UART_TX_FULL_BLOCK);
+	uart3_set_baudrate(baudrate, USART_OVERSAMPLING_AUTO, &generated);
+	uart3_tx_reset_stats();
+
+	result->backend = backend;
+	result->baudrate = baudrate;
+	result->actualBaudrate = generated.actual;
+	result->bytes = 0;
+	result->idleCycles = 0;
+	result->worstLatency = 0;
+
+	uint32_t start = dwt_get_cycles();
+
+	for(uint32_t line = 0; line < BENCHMARK_LINES; line++)
+	{
+		if(capacity != 0)
+		{
+			result->idleCycles += benchmark_wait_pending(capacity - BENCHMARK_LINE_MAX);
+		}
+
+		uint32_t before = dwt_get_cycles();
+		int printed = printf("bench %-9s %7lu line %2lu cycles %10lu 0123456789abcdef\r\n", benchmark_backend_name(backend), baudrate, line, before);
+		uint32_t latency = dwt_get_cycles() - before;
+
+		if(printed > 0)
+		{
+			result->bytes += (uint32_t) printed;
+		}
+
+		if(latency > result->worstLatency)
+		{
+			result->worstLatency = latency;
+		}
+	}
+
+	/* Everything has been handed to the transmitter, wait until it reached the line */
+	result->idleCycles += benchmark_wait_pending(0);
+	benchmark_wait_line_idle();
+
+	result->elapsedCycles = dwt_get_cycles() - start;
+
+	uart_tx_stats_t stats;
+	uart3_tx_get_stats(&stats);
+	result->dropped = stats.dropped;
+}
+
+/* Spins until at most pending characters wait in the transmitter and returns the cycles the CPU was really free meanwhile */
+static uint32_t benchmark_wait_pending(uint32_t pending)
+{
+	uint32_t turns = 0;
+	uint32_t shortestTurn = 0xFFFFFFFFU;
+	uint32_t last = dwt_get_cycles();
+
+	while(uart3_tx_pending() > pending)
+	{
+		uint32_t now = dwt_get_cycles();
+		uint32_t turn = now - last;
+		last = now;
+
+		if(turn < shortestTurn)
+		{
+			shortestTurn = turn;
+		}
+		turns++;
+	}
+
+	if(turns == 0)
+	{
+		return 0;
+	}
+
+	return turns * shortestTurn;
+}
+
+/* TXE: the last character left the data register, TC: it left the shift register as well. Not counted as idle, at most one character long */
+static void benchmark_wait_line_idle(void)
+{
+	while(!(USART3->SR & USART_SR__TXE));
+	while(!(USART3->SR & USART_SR__TC));
+}
+
+/* Every init configures USART3 again at 115200 baud, the run sets its own baud rate afterwards */
+static void benchmark_select_backend(uart_tx_backend_t backend)
+{
+	if(backend == UART_TX_BACKEND_INTERRUPT)
+	{
+		uart3_tx_ring_init();
+	}
+	else if(backend == UART_TX_BACKEND_DMA)
+	{
+		uart3_dma_tx_init();
+	}
+	else
+	{
+		uart3_tx_init();
+	}
+}
+
+/* The size of the software buffer of the transmitter, 0 if there is none */
+static uint32_t benchmark_capacity(uart_tx_backend_t backend)
+{
+	if(backend == UART_TX_BACKEND_INTERRUPT)
+	{
+		return UART3_TX_BUFFER_SIZE;
+	}
+
+	if(backend == UART_TX_BACKEND_DMA)
+	{
+		return UART3_DMA_TX_BUFFER_SIZE;
+	}
+
+	return 0;
+}
+
+static const char *benchmark_backend_name(uart_tx_backend_t backend)
+{
+	if(backend == UART_TX_BACKEND_INTERRUPT)
+	{
+		return "interrupt";
+	}
+
+	if(backend == UART_TX_BACKEND_DMA)
+	{
+		return "dma";
+	}
+
+	return "polled";
+}
+
+/* ******************************************************************************************************************************************************************
+ * Explanation: the table is CSV between the "#begin" and "#end" lines, so it can be cut out of a capture of the serial port and compared with an older one
+ * (Tools/benchmark_compare.py). No floating point: the fractional columns are printed with two decimals from integer arithmetic.
+ * 		bytes_per_s				sustained throughput of the run
+ * 		line_bytes_per_s		what the line can carry at the generated baud rate, 10 bits per character
+ * 		cpu_cycles_per_byte		CPU time of the run (printf, drivers and their interrupts) divided by the characters printed
+ * 		worst_printf_cycles/us	the longest printf of the run
+ * ******************************************************************************************************************************************************************
+ */
+static void benchmark_print_table(const benchmark_result_t *results, uint32_t count)
+{
+	uint32_t hclk = rcc_get_hclk_freq();
+
+	printf("\r\n#begin uart_benchmark version=%u hclk=%lu lines=%u\r\n", BENCHMARK_VERSION, hclk, BENCHMARK_LINES);
+	printf("backend,baudrate,actual_baudrate,bytes,elapsed_cycles,bytes_per_s,line_bytes_per_s,cpu_cycles_per_byte,worst_printf_cycles,worst_printf_us,dropped\r\n");
+
+	for(uint32_t i = 0; i < count; i++)
+	{
+		const benchmark_result_t *result = &results[i];
+		uint32_t busyCycles = result->elapsedCycles - result->idleCycles;
+		uint32_t bytesPerSecond = (uint32_t) (((uint64_t) result->bytes * hclk) / result->elapsedCycles);
+		uint32_t cyclesPerByte100 = (uint32_t) (((uint64_t) busyCycles * 100U) / result->bytes);
+		uint32_t latencyUs = (uint32_t) (((uint64_t) result->worstLatency * 1000000U) / hclk);
+
+		printf("%s,%lu,%lu,%lu,%lu,%lu,%lu,%lu.%02lu,%lu,%lu,%lu\r\n",
+				benchmark_backend_name(result->backend), result->baudrate, result->actualBaudrate, result->bytes, result->elapsedCycles,
+				bytesPerSecond, result->actualBaudrate / 10U, cyclesPerByte100 / 100U, cyclesPerByte100 % 100U,
+				result->worstLatency, latencyUs, result->dropped);
+	}
+
+	printf("#end\r\n");
+}
+
+/* ******************************************************************************************************************************************************************
+ * Explanation: the same line, with the same arguments, through the 4 formatters. snprintf only formats into a buffer, printf also hands the line to
+ * the DMA transmitter (_write for newlib, uart3_write_buffer for format.c). Before every call the application waits for room in the staging buffer,
+ * like benchmark_run() does, so the cycles are those of the call and never those of the wire.
+ * The code size is not measured here: it comes from arm-none-eabi-size on the ELF file, built once as it is and once without the newlib calls below.
+ * ******************************************************************************************************************************************************************
+ */
+static void benchmark_format_run(benchmark_format_result_t *results)
+{
+	char buffer[BENCHMARK_LINE_MAX];
+
+	benchmark_select_backend(UART_TX_BACKEND_DMA);
+	uart3_tx_set_full_policy(UART_TX_FULL_BLOCK);
+	uart3_set_baudrate(BENCHMARK_FORMAT_BAUDRATE, USART_OVERSAMPLING_AUTO, 0);
+
+	for(uint32_t formatter = 0; formatter < BENCHMARK_FORMATTER_COUNT; formatter++)
+	{
+		benchmark_format_result_t *result = &results[formatter];
+
+		result->calls = BENCHMARK_FORMAT_CALLS;
+		result->bytes = 0;
+		result->cycles = 0;
+		result->worstCycles = 0;
+
+		for(uint32_t i = 0; i < BENCHMARK_FORMAT_CALLS; i++)
+		{
+			int value = (int) (i * 37U) - 1000;
+			int printed;
+
+			benchmark_wait_pending(UART3_DMA_TX_BUFFER_SIZE - BENCHMARK_LINE_MAX);
+
+			uint32_t before = dwt_get_cycles();
+
+			if(formatter == BENCHMARK_FORMATTER_FORMAT_SNPRINTF)
+			{
+				printed = format_snprintf(buffer, sizeof(buffer), BENCHMARK_FORMAT, value, i, "ok");
+			}
+			else if(formatter == BENCHMARK_FORMATTER_NEWLIB_SNPRINTF)
+			{
+				printed = snprintf(buffer, sizeof(buffer), BENCHMARK_FORMAT, value, (unsigned int) i, "ok");
+			}
+			else if(formatter == BENCHMARK_FORMATTER_UART3_PRINTF)
+			{
+				printed = uart3_printf(BENCHMARK_FORMAT, value, i, "ok");
+			}
+			else
+			{
+				printed = printf(BENCHMARK_FORMAT, value, (unsigned int) i, "ok");
+			}
+
+			uint32_t cycles = dwt_get_cycles() - before;
+
+			if(printed > 0)
+			{
+				result->bytes += (uint32_t) printed;
+			}
+
+			result->cycles += cycles;
+
+			if(cycles > result->worstCycles)
+			{
+				result->worstCycles = cycles;
+			}
+		}
+
+		/* newlib keeps the line in the buffer of stdout until the '\n', make sure nothing of it is left for the next formatter */
+		fflush(stdout);
+		benchmark_wait_pending(0);
+	}
+
+	benchmark_wait_line_idle();
+}
+
+/* A second CSV table, after the one of the transmitters: cycles_per_call is the average of the calls of one formatter */
+static void benchmark_print_format_table(const benchmark_format_result_t *results)
+{
+	printf("\r\n#begin format_benchmark version=%u hclk=%lu calls=%u\r\n", BENCHMARK_VERSION, rcc_get_hclk_freq(), BENCHMARK_FORMAT_CALLS);
+	printf("formatter,calls,bytes,cycles_per_call,worst_cycles\r\n");
+
+	for(uint32_t i = 0; i < BENCHMARK_FORMATTER_COUNT; i++)
+	{
+		const benchmark_format_result_t *result = &results[i];
+
+		printf("%s,%lu,%lu,%lu,%lu\r\n", benchmarkFormatterNames[i], result->calls, result->bytes, result->cycles / result->calls, result->worstCycles);
+	}
+
+	printf("#end\r\n");
+}
@@ -0,0 +1,153 @@
+#!/usr/bin/env python3
+"""
+benchmark_compare.py
+
+Host side companion of UART_Benchmark. Cuts the CSV tables printed by Src/main.c out of a capture
+of the serial port (115200 baud, between the "#begin <name>" and "#end" lines; whatever the runs printed
+at the other baud rates before them is ignored) and compares them with a baseline captured earlier.
+The transmitters are in "#begin uart_benchmark", the formatters in "#begin format_benchmark".
+
+A row regresses when, for the same backend and baud rate:
+    bytes_per_s           drops by more than the tolerance
+    cpu_cycles_per_byte   grows by more than the tolerance
+    worst_printf_cycles   grows by more than the tolerance
+    dropped               is not 0 anymore
+and a formatter regresses when its cycles_per_call grows by more than the tolerance.
+The baseline is saved as two files, baseline.csv and baseline.format.csv.
+
+Usage:
+    python3 benchmark_compare.py capture.txt                      (prints the table)
+    python3 benchmark_compare.py capture.txt --save baseline.csv  (keeps it as the baseline)
+    python3 benchmark_compare.py capture.txt --baseline baseline.csv --tolerance 5
+The exit code is 1 if anything regressed, so it can run after flashing the board in a script.
+"""
+
+import argparse
+import csv
+import io
+import sys
+
+HIGHER_IS_BETTER = ("bytes_per_s",)
+LOWER_IS_BETTER = ("cpu_cycles_per_byte", "worst_printf_cycles")
+
+
+def extract_table(text, name="uart_benchmark", required=True):
+    header = None
+    lines = []
+    inside = False
+    for line in text.splitlines():
+        line = line.strip()
+        if line.startswith("#begin " + name):
+            header = line
+            lines = []
+            inside = True
+        elif line.startswith("#end"):
+            inside = False
+        elif inside and line:
+            lines.append(line)
+    if header is None:
+        if required:
+            raise ValueError("no #begin %s line, is the capture taken at 115200 baud?" % name)
+        return None, []
+    return header, list(csv.DictReader(io.StringIO("\n".join(lines))))
+
+
+def key(row):
+    return (row["backend"], int(row["baudrate"]))
+
+
+def compare(current, baseline, tolerance):
+    base = {key(row): row for row in baseline}
+    regressions = []
+    for row in current:
+        old = base.get(key(row))
+        if old is None:
+            continue
+        for column in HIGHER_IS_BETTER:
+            if float(row[column]) < float(old[column]) * (1.0 - tolerance / 100.0):
+                regressions.append((key(row), column, old[column], row[column]))
+        for column in LOWER_IS_BETTER:
+            if float(row[column]) > float(old[column]) * (1.0 + tolerance / 100.0):
+                regressions.append((key(row), column, old[column], row[column]))
+        if int(row["dropped"]) != 0 and int(old["dropped"]) == 0:
+            regressions.append((key(row), "dropped", old["dropped"], row["dropped"]))
+    return regressions
+
+
+def compare_formatters(current, baseline, tolerance):
+    base = {row["formatter"]: row for row in baseline}
+    regressions = []
+    for row in current:
+        old = base.get(row["formatter"])
+        if old is not None and float(row["cycles_per_call"]) > float(old["cycles_per_call"]) * (1.0 + tolerance / 100.0):
+            regressions.append((row["formatter"], old["cycles_per_call"], row["cycles_per_call"]))
+    return regressions
+
+
+def format_path(path):
+    return path[:-4] + ".format.csv" if path.endswith(".csv") else path + ".format"
+
+
+def save(path, rows):
+    with open(path, "w", newline="") as output:
+        writer = csv.DictWriter(output, fieldnames=list(rows[0].keys()))
+        writer.writeheader()
+        writer.writerows(rows)
+
+
+def print_table(rows):
+    columns = ("backend", "baudrate", "bytes_per_s", "line_bytes_per_s", "cpu_cycles_per_byte", "worst_printf_us", "dropped")
+    print("  ".join("%-19s" % column for column in columns))
+    for row in rows:
+        print("  ".join("%-19s" % row[column] for column in columns))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare UART_Benchmark results")
+    parser.add_argument("capture", help="text captured from the serial port")
+    parser.add_argument("--baseline", help="CSV saved from an earlier run")
+    parser.add_argument("--save", help="write the table of this capture as CSV")
+    parser.add_argument("--tolerance", type=float, default=5.0, help="allowed change in percent (default 5)")
+    args = parser.parse_args()
+
+    with open(args.capture, "r", errors="replace") as capture:
+        text = capture.read()
+    header, rows = extract_table(text)
+    format_header, format_rows = extract_table(text, "format_benchmark", required=False)
+
+    print(header)
+    print_table(rows)
+
+    if format_header is not None:
+        print(format_header)
+        for row in format_rows:
+            print("%-19s %10s cycles per call, worst %s" % (row["formatter"], row["cycles_per_call"], row["worst_cycles"]))
+
+    if args.save:
+        save(args.save, rows)
+        if format_rows:
+            save(format_path(args.save), format_rows)
+
+    if args.baseline:
+        with open(args.baseline, "r", newline="") as baseline_file:
+            baseline = list(csv.DictReader(baseline_file))
+        regressions = compare(rows, baseline, args.tolerance)
+        for (backend, baudrate), column, old, new in regressions:
+            print("REGRESSION %s %d: %s %s -> %s" % (backend, baudrate, column, old, new))
+        try:
+            with open(format_path(args.baseline), "r", newline="") as baseline_file:
+                format_baseline = list(csv.DictReader(baseline_file))
+        except FileNotFoundError:
+            format_baseline = []
+        for formatter, old, new in compare_formatters(format_rows, format_baseline, args.tolerance):
+            print("REGRESSION %s: cycles_per_call %s -> %s" % (formatter, old, new))
+            regressions.append(((formatter, 0), "cycles_per_call", old, new))
+        if regressions:
+            return 1
+        print("no regression beyond %.1f%%" % args.tolerance)
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
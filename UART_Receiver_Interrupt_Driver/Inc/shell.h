@@ -0,0 +1,42 @@
+/*
+ * shell.h
+ *
+ *  Created on: 17 Oct 2026
+ *  Author: George Calin
+ *  Target Development Board: STM32 Nucleo F429ZI
+ */
+
+#ifndef SHELL_H_
+#define SHELL_H_
+
+#include <stdint.h>
+
+#define SHELL_LINE_SIZE (64U)		// the longest command line, terminator included
+#define SHELL_MAX_ARGUMENTS (8U)	// the command name counts as argv[0]
+
+/* Returns 0 on success, anything else is printed as an error code */
+typedef int (*shell_handler_t)(int argc, char *argv[]);
+
+typedef struct
+{
+	const char *name;
+	const char *help;
+	shell_handler_t handler;
+} shell_command_t;
+
+/* ******************************************************************************************************************************************************************
+ * Explanation: every SHELL_COMMAND() places one shell_command_t in the section .shell_commands, which the linker script keeps in flash between
+ * __shell_commands_start and __shell_commands_end. A command is added by writing it next to the code it belongs to, there is no central table to edit.
+ * Example: SHELL_COMMAND("led", "led on|off|toggle", led_command);
+ * ******************************************************************************************************************************************************************
+ */
+#define SHELL_COMMAND(commandName, commandHelp, commandHandler) \
+	static const shell_command_t shellCommand_##commandHandler \
+	__attribute__((used, aligned(4), section(".shell_commands"))) = {commandName, commandHelp, commandHandler}
+
+void shell_init(const char *prompt);
+void shell_poll(void);
+void shell_puts(const char *text);
+void shell_put_number(int number);
+
+#endif /* SHELL_H_ */
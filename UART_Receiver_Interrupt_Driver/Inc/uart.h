@@ -20,6 +20,14 @@ void uart3_rxtx_init(void);
 void uart3_write(int charYouWantToWrite);
 int __io_putchar(int myCharacter);
 
+/* *** Receiver ring buffer filled by USART3_IRQHandler *** */
+#define UART3_RX_BUFFER_SIZE (64U) // has to be a power of 2 so the indexes can wrap around with a mask
+
+void uart3_rx_ring_put(char character);
+int uart3_rx_ring_get(char *character);
+uint32_t uart3_rx_ring_available(void);
+uint32_t uart3_rx_ring_dropped(void);
+
 
 
 #endif /* UART_H_ */
@@ -11,8 +11,10 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #include "exti.h"
 #include "uart.h"
+#include "shell.h"
 
 #define GPIOB_ENABLE (1UL<<1)
 #define PIN7	(1UL<<7)
@@ -21,8 +23,8 @@
 #define USART_SR_RXNE (1ul<<5)
 
 static void usart3_callback(void);
-
-char myKey;
+static int led_command(int argc, char *argv[]);
+static int stats_command(int argc, char *argv[]);
 
 
 int main(void)
@@ -36,9 +38,13 @@ int main(void)
 
 	uart3_rx_interrupt_init();
 
+	/* Command console for diagnostics, type help */
+	shell_init("f429> ");
+
 	for(;;)
 	{
-
+		/* The commands run here, in thread mode, never inside USART3_IRQHandler */
+		shell_poll();
 	}
 
 }
@@ -69,18 +75,56 @@ void USART3_IRQHandler()
 	}
 }
 
+/* Reading DR clears RXNE. The character only goes into the ring buffer, shell_poll() takes care of it */
 static void usart3_callback(void)
 {
-	myKey = USART3->DR;
+	uart3_rx_ring_put((char) USART3->DR);
+}
 
+/* *** SHELL COMMANDS *** */
+static int led_command(int argc, char *argv[])
+{
+	if(argc != 2)
+	{
+		shell_puts("usage: led on|off|toggle\r\n");
+		return 1;
+	}
 
-	if(myKey=='1')
-			{
-				GPIOB->ODR |= LED_PIN;
-			}
-			else
-			{
-				GPIOB->ODR &=~(LED_PIN);
-			}
+	if(strcmp(argv[1], "on") == 0)
+	{
+		GPIOB->ODR |= LED_PIN;
+	}
+	else if(strcmp(argv[1], "off") == 0)
+	{
+		GPIOB->ODR &=~(LED_PIN);
+	}
+	else if(strcmp(argv[1], "toggle") == 0)
+	{
+		GPIOB->ODR ^= LED_PIN;
+	}
+	else
+	{
+		return 2;
+	}
+
+	return 0;
 }
 
+SHELL_COMMAND("led", "led on|off|toggle, the blue user LED LD2", led_command);
+
+static int stats_command(int argc, char *argv[])
+{
+	(void)argc;
+	(void)argv;
+
+	shell_puts("rx waiting ");
+	shell_put_number((int) uart3_rx_ring_available());
+	shell_puts(", rx dropped ");
+	shell_put_number((int) uart3_rx_ring_dropped());
+	shell_puts("\r\n");
+
+	return 0;
+}
+
+SHELL_COMMAND("stats", "counters of the receiver ring buffer", stats_command);
+
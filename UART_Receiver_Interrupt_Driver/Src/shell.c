@@ -0,0 +1,275 @@
+/*
+ * shell.c
+ *
+ *  Created on: 17 Oct 2026
+ *  Author: George Calin
+ *  Target Development Board: STM32 Nucleo F429ZI
+ */
+
+#include <string.h>
+#include "shell.h"
+#include "uart.h"
+
+#define SHELL_CHARACTER_BACKSPACE (0x08)
+#define SHELL_CHARACTER_DELETE (0x7F)	// what most terminals send for the backspace key
+#define SHELL_CHARACTER_CTRL_C (0x03)	// throw the whole line away
+#define SHELL_CHARACTER_CTRL_U (0x15)	// erase the whole line on the screen
+#define SHELL_CHARACTER_BELL (0x07)		// the line is full
+
+/* Defined by the linker script around the section .shell_commands */
+extern const shell_command_t __shell_commands_start[];
+extern const shell_command_t __shell_commands_end[];
+
+/* The line being edited. Tokenization writes the terminators of the arguments into it, nothing is copied */
+static char shellLine[SHELL_LINE_SIZE];
+static uint32_t shellLength;
+static char shellPrevious;
+static const char *shellPrompt = "> ";
+
+static void shell_process(char character);
+static void shell_execute(void);
+static int shell_tokenize(char *line, char *argv[]);
+static const shell_command_t *shell_find(const char *name);
+
+/* ******************************************************************************************************************************************************************
+ * Explanation: the shell runs only in thread mode. USART3_IRQHandler puts the received characters in the ring of uart.c and returns,
+ * shell_poll() is called from the main loop and does the echo, the line editing and the commands. The output goes through uart3_write() directly,
+ * so that printf does not allocate its buffer on the heap: the shell uses no heap at all, only the fixed line buffer.
+ * ******************************************************************************************************************************************************************
+ */
+void shell_init(const char *prompt)
+{
+	if(prompt != 0)
+	{
+		shellPrompt = prompt;
+	}
+
+	shellLength = 0;
+	shellPrevious = 0;
+
+	shell_puts("\r\n");
+	shell_puts(shellPrompt);
+}
+
+/* Handles the characters received since the last call and returns as soon as the ring is empty */
+void shell_poll(void)
+{
+	char character;
+
+	while(uart3_rx_ring_get(&character))
+	{
+		shell_process(character);
+	}
+}
+
+static void shell_process(char character)
+{
+	char previous = shellPrevious;
+	shellPrevious = character;
+
+	if((character == '\r') || (character == '\n'))
+	{
+		/* "\r\n" from the terminal ends only one line */
+		if((character == '\n') && (previous == '\r'))
+		{
+			return;
+		}
+
+		shell_puts("\r\n");
+		shell_execute();
+		shellLength = 0;
+		shell_puts(shellPrompt);
+	}
+	else if((character == SHELL_CHARACTER_BACKSPACE) || (character == SHELL_CHARACTER_DELETE))
+	{
+		if(shellLength > 0)
+		{
+			shellLength--;
+			shell_puts("\b \b");
+		}
+	}
+	else if(character == SHELL_CHARACTER_CTRL_U)
+	{
+		while(shellLength > 0)
+		{
+			shellLength--;
+			shell_puts("\b \b");
+		}
+	}
+	else if(character == SHELL_CHARACTER_CTRL_C)
+	{
+		shellLength = 0;
+		shell_puts("^C\r\n");
+		shell_puts(shellPrompt);
+	}
+	else if((character >= ' ') && (character <= '~'))
+	{
+		/* Keep one place for the terminator */
+		if(shellLength < (SHELL_LINE_SIZE - 1U))
+		{
+			shellLine[shellLength++] = character;
+			uart3_write(character);
+		}
+		else
+		{
+			uart3_write(SHELL_CHARACTER_BELL);
+		}
+	}
+
+	/* Any other control character (escape sequences of the arrow keys...) is ignored */
+}
+
+static void shell_execute(void)
+{
+	char *argv[SHELL_MAX_ARGUMENTS + 1];
+
+	shellLine[shellLength] = '\0';
+
+	int argc = shell_tokenize(shellLine, argv);
+
+	if(argc == 0)
+	{
+		return;
+	}
+
+	if(argc < 0)
+	{
+		shell_puts("too many arguments\r\n");
+		return;
+	}
+
+	const shell_command_t *command = shell_find(argv[0]);
+
+	if(command == 0)
+	{
+		shell_puts("unknown command '");
+		shell_puts(argv[0]);
+		shell_puts("', type help\r\n");
+		return;
+	}
+
+	int result = command->handler(argc, argv);
+
+	if(result != 0)
+	{
+		shell_puts("error ");
+		shell_put_number(result);
+		shell_puts("\r\n");
+	}
+}
+
+/* Splits the line in place at spaces and tabs. A double quoted argument may contain spaces, the quotes are removed.
+ * Returns the number of arguments, or -1 if there are more than SHELL_MAX_ARGUMENTS */
+static int shell_tokenize(char *line, char *argv[])
+{
+	int argc = 0;
+
+	for(;;)
+	{
+		while((*line == ' ') || (*line == '\t'))
+		{
+			line++;
+		}
+
+		if(*line == '\0')
+		{
+			break;
+		}
+
+		if(argc == (int) SHELL_MAX_ARGUMENTS)
+		{
+			return -1;
+		}
+
+		char terminator = ' ';
+
+		if(*line == '"')
+		{
+			terminator = '"';
+			line++;
+		}
+
+		argv[argc++] = line;
+
+		while((*line != '\0') && (*line != terminator) && ((terminator == '"') || (*line != '\t')))
+		{
+			line++;
+		}
+
+		if(*line == '\0')
+		{
+			break;
+		}
+
+		*line++ = '\0';
+	}
+
+	argv[argc] = 0;
+
+	return argc;
+}
+
+static const shell_command_t *shell_find(const char *name)
+{
+	for(const shell_command_t *command = __shell_commands_start; command < __shell_commands_end; command++)
+	{
+		if(strcmp(command->name, name) == 0)
+		{
+			return command;
+		}
+	}
+
+	return 0;
+}
+
+/* Output for the command handlers, printf would allocate the buffer of stdout on the heap */
+void shell_puts(const char *text)
+{
+	while(*text != '\0')
+	{
+		uart3_write(*text++);
+	}
+}
+
+void shell_put_number(int number)
+{
+	char digits[12];
+	uint32_t count = 0;
+	uint32_t value = (uint32_t) number;
+
+	if(number < 0)
+	{
+		uart3_write('-');
+		value = 0U - value;
+	}
+
+	do
+	{
+		digits[count++] = (char) ('0' + (value % 10U));
+		value /= 10U;
+	} while(value != 0);
+
+	while(count > 0)
+	{
+		uart3_write(digits[--count]);
+	}
+}
+
+/* *** BUILT-IN COMMANDS *** */
+static int shell_help_command(int argc, char *argv[])
+{
+	(void)argc;
+	(void)argv;
+
+	for(const shell_command_t *command = __shell_commands_start; command < __shell_commands_end; command++)
+	{
+		shell_puts(command->name);
+		shell_puts("\t");
+		shell_puts(command->help);
+		shell_puts("\r\n");
+	}
+
+	return 0;
+}
+
+SHELL_COMMAND("help", "list the commands", shell_help_command);
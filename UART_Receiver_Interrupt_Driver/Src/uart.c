@@ -32,6 +32,14 @@
 
 #define USART_CR1_RXNEIE (1UL<<5)
 
+#define UART3_RX_BUFFER_MASK (UART3_RX_BUFFER_SIZE - 1U)
+
+/* The ring buffer of the receiver: USART3_IRQHandler writes at the head, the main loop reads from the tail.
+ * Each side writes only its own index and a 32 bit access is atomic on the Cortex-M4, so no critical section is needed */
+static volatile char uart3RxBuffer[UART3_RX_BUFFER_SIZE];
+static volatile uint32_t uart3RxHead;
+static volatile uint32_t uart3RxTail;
+static volatile uint32_t uart3RxDropped;
 
 
 static uint16_t compute_uart_bd(uint32_t PeriphClock, uint32_t BaudRate);
@@ -179,7 +187,7 @@ void uart3_tx_init(void)
 char uart3_read(void)
 {
 	/* Make sure the receive data register is not empty */
-	while(!(USART3->SR & SR_RXNE))
+	while(!(USART3->SR & SR_RXNE));
 
 
 	/* Read data */
@@ -206,6 +214,49 @@ static uint16_t compute_uart_bd(uint32_t PeriphClock, uint32_t BaudRate)
 	return ((PeriphClock + (BaudRate/2UL))/BaudRate);
 }
 
+/* ******************************************************************************************************************************************************************
+ * Explanation: the interrupt only moves the character from the data register into the ring, the work on it (echo, parsing, commands) is done in thread mode.
+ * This way the cost of every received character inside USART3_IRQHandler is constant and small, whatever the application does with it.
+ * When the ring is full the new character is thrown away and counted, the interrupt never waits for the main loop.
+ * ******************************************************************************************************************************************************************
+ */
+void uart3_rx_ring_put(char character)
+{
+	if((uart3RxHead - uart3RxTail) >= UART3_RX_BUFFER_SIZE)
+	{
+		uart3RxDropped++;
+		return;
+	}
+
+	uart3RxBuffer[uart3RxHead & UART3_RX_BUFFER_MASK] = character;
+	uart3RxHead++;
+}
+
+/* Returns 1 if a character was taken out of the ring and 0 if the ring is empty. It never waits */
+int uart3_rx_ring_get(char *character)
+{
+	if(uart3RxHead == uart3RxTail)
+	{
+		return 0;
+	}
+
+	*character = uart3RxBuffer[uart3RxTail & UART3_RX_BUFFER_MASK];
+	uart3RxTail++;
+
+	return 1;
+}
+
+uint32_t uart3_rx_ring_available(void)
+{
+	return uart3RxHead - uart3RxTail;
+}
+
+/* Characters lost because the main loop did not empty the ring fast enough */
+uint32_t uart3_rx_ring_dropped(void)
+{
+	return uart3RxDropped;
+}
+
 int __io_putchar(int myCharacter)
 {
 	uart3_write(myCharacter);